@@ -2,12 +2,15 @@
 
 #include <algorithm>
 #include <mutex>
+#include <shared_mutex>
 #include <memory>
+#include <utility>
 #include <iostream>
 template<typename T>
 class concurrent_list {
     struct node {
-        std::mutex m_mutex;
+        // 读写锁：只读的遍历使用共享锁，修改链表结构时使用独占锁
+        std::shared_mutex m_mutex;
         std::shared_ptr<T> m_data;
         std::unique_ptr<node> m_next = nullptr;
         node() {}
@@ -33,10 +36,10 @@ public:
         // current指当前的结点
         node* current = &m_head;
         // guard也始终是锁当前的结点
-        std::unique_lock<std::mutex> guard(m_head.m_mutex);
+        std::unique_lock<std::shared_mutex> guard(m_head.m_mutex);
         // next指当前结点的下一个结点，而判断时，一直是判断下一个结点的情况
         while (node* const next = current->m_next.get()) {
-            std::unique_lock<std::mutex> next_guard(next->m_mutex);
+            std::unique_lock<std::shared_mutex> next_guard(next->m_mutex);
             if (p(*next->m_data)) {
                 // 如果谓词是满足的，则说明要删除这个谓词
                 std::unique_ptr<node> old_next = std::move(current->m_next);
@@ -53,9 +56,9 @@ public:
     template<typename Predicate>
     bool remove_first(Predicate p) {
         node* current = &m_head;
-        std::unique_lock<std::mutex> guard(m_head.m_mutex);
+        std::unique_lock<std::shared_mutex> guard(m_head.m_mutex);
         while (node* const next = current->m_next.get()) {
-            std::unique_lock<std::mutex> next_guard(next->m_mutex);
+            std::unique_lock<std::shared_mutex> next_guard(next->m_mutex);
             if (p(*next->m_data)) {
                 std::unique_ptr<node> old_next = std::move(current->m_next);
                 current->m_next = std::move(next->m_next);
@@ -69,15 +72,16 @@ public:
         return false;
     }
 
+    // 只读操作，使用共享锁逐个结点向后推进，多个读者可以同时遍历同一个链表
     template<typename Predicate>
     std::shared_ptr<T> find_first_if(Predicate p) {
         node* current = &m_head;
-        std::unique_lock<std::mutex> guard(m_head.m_mutex);
+        std::shared_lock<std::shared_mutex> guard(m_head.m_mutex);
         while (node* const next = current->m_next.get()) {
-            std::unique_lock<std::mutex> next_guard(next->m_mutex);
+            std::shared_lock<std::shared_mutex> next_guard(next->m_mutex);
             // 结束对next中变量的访问，释放锁
             guard.unlock();
-            if (p(*next->m_data)) {
+            if (p(std::as_const(*next->m_data))) {
                 return next->m_data;
             }
             current = next;
@@ -90,21 +94,22 @@ public:
     // 使用头插法，插入一个新的结点
     void push_front(const T& value) {
         std::unique_ptr<node> new_node(new node(value));
-        std::lock_guard<std::mutex> guard(m_head.m_mutex);
+        std::lock_guard<std::shared_mutex> guard(m_head.m_mutex);
         new_node->m_next = std::move(m_head.m_next);
         m_head.m_next = std::move(new_node);
     }
 
 
     // 遍历所有的结点，对每一个结点都使用f调用一下
+    // 遍历时持有的是共享锁，所以f只能读取结点中的数据，不能修改
     template<typename Function>
     void for_each(Function f) {
         node* current = &m_head;
-        std::unique_lock<std::mutex> guard(m_head.m_mutex);
+        std::shared_lock<std::shared_mutex> guard(m_head.m_mutex);
         while (node* const next = current->m_next.get()) {
-            std::unique_lock<std::mutex> next_guard(next->m_mutex);
+            std::shared_lock<std::shared_mutex> next_guard(next->m_mutex);
             guard.unlock();
-            f(*next->m_data);
+            f(std::as_const(*next->m_data));
             current = next;
             guard = std::move(next_guard);
         }
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "concurrent_list.hpp"
+
+// 选择子链表的方式
+enum class shard_policy {
+    // 按照线程选择，同一个线程总是插入到同一个子链表中
+    by_thread,
+    // 按照元素的哈希值选择，相同的元素总是在同一个子链表中
+    by_hash,
+};
+
+// 由多个独立的concurrent_list组成的分片链表
+// push_front只会锁住其中一个子链表的头结点，不同线程的插入不会争抢同一把锁
+// 遍历与删除操作会依次访问所有的子链表，所以分片链表不保证元素之间的先后顺序
+template<typename T, typename Hash = std::hash<T>>
+class concurrent_sharded_list {
+    // 每个子链表独占缓存行，防止不同子链表的头结点之间出现伪共享
+    struct alignas(64) shard {
+        concurrent_list<T> m_list;
+    };
+
+    std::size_t m_shard_count;
+    std::unique_ptr<shard[]> m_shards;
+    shard_policy m_policy;
+    Hash m_hasher;
+
+    // 为每一个线程分配一个编号，线程第一次插入时才会分配
+    static std::size_t thread_ticket() {
+        static std::atomic<std::size_t> next_ticket{0};
+        thread_local const std::size_t ticket = next_ticket.fetch_add(1, std::memory_order_relaxed);
+        return ticket;
+    }
+
+    concurrent_list<T>& select_shard(const T& value) {
+        const std::size_t index = m_policy == shard_policy::by_thread
+                                      ? thread_ticket() % m_shard_count
+                                      : m_hasher(value) % m_shard_count;
+        return m_shards[index].m_list;
+    }
+
+    // 把所有的子链表分给thread_num个线程并行处理，每个线程处理一段连续的子链表
+    template<typename Function>
+    void parallel_visit(Function visit, std::size_t thread_num) {
+        thread_num = std::clamp<std::size_t>(thread_num, 1, m_shard_count);
+        std::vector<std::jthread> workers;
+        workers.reserve(thread_num - 1);
+        const std::size_t per_thread = (m_shard_count + thread_num - 1) / thread_num;
+        for (std::size_t t = 1; t < thread_num; ++t) {
+            const std::size_t begin = t * per_thread;
+            const std::size_t end = std::min(begin + per_thread, m_shard_count);
+            workers.emplace_back([this, &visit, begin, end]() {
+                for (std::size_t i = begin; i < end; ++i) {
+                    visit(m_shards[i].m_list);
+                }
+            });
+        }
+        // 当前线程处理第一段
+        for (std::size_t i = 0; i < std::min(per_thread, m_shard_count); ++i) {
+            visit(m_shards[i].m_list);
+        }
+    }
+
+public:
+    // 子链表的数量默认与cpu的核心数相同
+    explicit concurrent_sharded_list(std::size_t shard_count = std::thread::hardware_concurrency(),
+                                     shard_policy policy = shard_policy::by_thread,
+                                     const Hash& hasher = Hash())
+        : m_shard_count(std::max<std::size_t>(shard_count, 1)),
+          m_shards(new shard[m_shard_count]),
+          m_policy(policy),
+          m_hasher(hasher) {
+    }
+
+    concurrent_sharded_list(const concurrent_sharded_list& other) = delete;
+    concurrent_sharded_list& operator=(const concurrent_sharded_list& other) = delete;
+
+    std::size_t shard_count() const {
+        return m_shard_count;
+    }
+
+    // 插入到当前线程（或元素哈希值）对应的子链表中
+    void push_front(const T& value) {
+        select_shard(value).push_front(value);
+    }
+
+    // 删除所有满足条件的结点
+    template<typename Predicate>
+    void remove_if(Predicate p) {
+        for (std::size_t i = 0; i < m_shard_count; ++i) {
+            m_shards[i].m_list.remove_if(p);
+        }
+    }
+
+    // 使用多个线程同时删除不同子链表中的结点，p需要是线程安全的
+    template<typename Predicate>
+    void parallel_remove_if(Predicate p, std::size_t thread_num = std::thread::hardware_concurrency()) {
+        parallel_visit([&p](concurrent_list<T>& list) { list.remove_if(p); }, thread_num);
+    }
+
+    // 删除第一个满足条件的结点，按子链表的顺序依次查找
+    template<typename Predicate>
+    bool remove_first(Predicate p) {
+        for (std::size_t i = 0; i < m_shard_count; ++i) {
+            if (m_shards[i].m_list.remove_first(p)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template<typename Predicate>
+    std::shared_ptr<T> find_first_if(Predicate p) {
+        for (std::size_t i = 0; i < m_shard_count; ++i) {
+            if (auto found = m_shards[i].m_list.find_first_if(p)) {
+                return found;
+            }
+        }
+        return std::shared_ptr<T>();
+    }
+
+    // 依次遍历所有的子链表
+    template<typename Function>
+    void for_each(Function f) {
+        for (std::size_t i = 0; i < m_shard_count; ++i) {
+            m_shards[i].m_list.for_each(f);
+        }
+    }
+
+    // 使用多个线程同时遍历不同的子链表，f会被并发调用，需要是线程安全的
+    template<typename Function>
+    void parallel_for_each(Function f, std::size_t thread_num = std::thread::hardware_concurrency()) {
+        parallel_visit([&f](concurrent_list<T>& list) { list.for_each(f); }, thread_num);
+    }
+};
@@ -0,0 +1,156 @@
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../concurrent_list.hpp"
+#include "../concurrent_sharded_list.hpp"
+
+// --- 参数调整区 ---
+// 链表中的元素个数
+static constexpr int LIST_SIZE = 10000;
+// 每个读者遍历链表的次数
+static constexpr int TRAVERSALS_PER_READER = 200;
+// 测试的读者数量
+static constexpr int READER_COUNTS[] = {1, 2, 4, 8, 16};
+// 插入测试中每个线程插入的元素个数
+static constexpr int PUSHES_PER_THREAD = 200000;
+// 插入测试的线程数量
+static constexpr int WRITER_COUNTS[] = {1, 2, 4, 8, 16};
+
+// 启动reader_count个读者，每个读者交替调用for_each与find_first_if
+// with_writer为true时，额外启动一个不断push_front/remove_first的写者
+double run_readers(concurrent_list<int>& list, int reader_count, bool with_writer) {
+    std::atomic<bool> start(false);
+    std::atomic<bool> readers_done(false);
+    std::atomic<long long> checksum(0);
+    std::vector<std::thread> readers;
+    readers.reserve(reader_count);
+
+    for (int r = 0; r < reader_count; ++r) {
+        readers.emplace_back([&]() {
+            while (!start.load()) {
+                std::this_thread::yield();
+            }
+            long long local_sum = 0;
+            for (int i = 0; i < TRAVERSALS_PER_READER; ++i) {
+                if (i % 2 == 0) {
+                    list.for_each([&](const int& val) { local_sum += val; });
+                } else {
+                    // 查找一个不存在的值，保证会遍历整个链表
+                    auto found = list.find_first_if([](const int& val) { return val < 0; });
+                    local_sum += found ? *found : 1;
+                }
+            }
+            checksum.fetch_add(local_sum);
+        });
+    }
+
+    std::thread writer;
+    if (with_writer) {
+        writer = std::thread([&]() {
+            while (!start.load()) {
+                std::this_thread::yield();
+            }
+            int value = LIST_SIZE;
+            while (!readers_done.load()) {
+                list.push_front(value);
+                list.remove_first([value](const int& val) { return val == value; });
+                ++value;
+            }
+        });
+    }
+
+    auto begin = std::chrono::high_resolution_clock::now();
+    start.store(true);
+    for (auto& t : readers) {
+        t.join();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    readers_done.store(true);
+    if (writer.joinable()) {
+        writer.join();
+    }
+
+    // 防止编译器把遍历优化掉
+    if (checksum.load() == 42) {
+        std::cout << "";
+    }
+    return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+// 使用thread_count个线程同时push_front，返回耗时
+template<typename List>
+double run_pushers(List& list, int thread_count) {
+    std::atomic<bool> start(false);
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count);
+    for (int t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&, t]() {
+            while (!start.load()) {
+                std::this_thread::yield();
+            }
+            for (int i = 0; i < PUSHES_PER_THREAD; ++i) {
+                list.push_front(t * PUSHES_PER_THREAD + i);
+            }
+        });
+    }
+    auto begin = std::chrono::high_resolution_clock::now();
+    start.store(true);
+    for (auto& t : threads) {
+        t.join();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+int main() {
+    std::cout << "Benchmark Configuration:" << std::endl;
+    std::cout << "------------------------" << std::endl;
+    std::cout << "List size: " << LIST_SIZE << std::endl;
+    std::cout << "Traversals per reader: " << TRAVERSALS_PER_READER << std::endl;
+    std::cout << "Hardware concurrency: " << std::thread::hardware_concurrency() << std::endl;
+    std::cout << "------------------------" << std::endl << std::endl;
+
+    concurrent_list<int> list;
+    for (int i = 0; i < LIST_SIZE; ++i) {
+        list.push_front(i);
+    }
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "readers | read only (ms) | traversals/s | with one writer (ms) | traversals/s" << std::endl;
+    for (int reader_count : READER_COUNTS) {
+        double read_only = run_readers(list, reader_count, false);
+        double with_writer = run_readers(list, reader_count, true);
+        double total = static_cast<double>(reader_count) * TRAVERSALS_PER_READER;
+        std::cout << std::setw(7) << reader_count << " | "
+                  << std::setw(14) << read_only << " | "
+                  << std::setw(12) << total / read_only * 1000.0 << " | "
+                  << std::setw(20) << with_writer << " | "
+                  << std::setw(12) << total / with_writer * 1000.0 << std::endl;
+    }
+
+    std::cout << std::endl << "Pushes per thread: " << PUSHES_PER_THREAD << std::endl;
+    std::cout << "threads | concurrent_list (ms) | pushes/s | concurrent_sharded_list (ms) | pushes/s" << std::endl;
+    for (int thread_count : WRITER_COUNTS) {
+        double total = static_cast<double>(thread_count) * PUSHES_PER_THREAD;
+        double single;
+        double sharded;
+        {
+            concurrent_list<int> plain_list;
+            single = run_pushers(plain_list, thread_count);
+        }
+        {
+            concurrent_sharded_list<int> sharded_list;
+            sharded = run_pushers(sharded_list, thread_count);
+        }
+        std::cout << std::setw(7) << thread_count << " | "
+                  << std::setw(20) << single << " | "
+                  << std::setw(8) << total / single * 1000.0 << " | "
+                  << std::setw(28) << sharded << " | "
+                  << std::setw(8) << total / sharded * 1000.0 << std::endl;
+    }
+    return 0;
+}
@@ -5,6 +5,7 @@
 
 #include "gtest/gtest.h"
 #include "../concurrent_list.hpp"
+#include "../concurrent_sharded_list.hpp"
 
 // Test fixture for concurrent list tests
 class ConcurrentListTest : public ::testing::Test {
@@ -176,4 +177,134 @@ TEST_F(ConcurrentListTest, ConcurrentPushAndCount) {
             EXPECT_TRUE(collected_items.count(val)) << "Value " << val << " missing.";
         }
     }
-}
\ No newline at end of file
+}
+
+// 只读遍历使用共享锁，两个读者应该可以同时停留在同一个结点上
+TEST_F(ConcurrentListTest, ReadersTraverseConcurrently) {
+    for (int i = 0; i < 16; ++i) {
+        list.push_front(i);
+    }
+
+    std::atomic<int> readers_inside(0);
+    std::atomic<bool> overlapped(false);
+
+    auto reader = [&]() {
+        bool first = true;
+        list.for_each([&](const int&) {
+            if (!first) {
+                return;
+            }
+            first = false;
+            readers_inside.fetch_add(1);
+            // 持有第一个结点的共享锁，等待另一个读者也进入同一个结点
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+            while (readers_inside.load() < 2 && std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::yield();
+            }
+            if (readers_inside.load() >= 2) {
+                overlapped.store(true);
+            }
+        });
+    };
+
+    std::thread t1(reader);
+    std::thread t2(reader);
+    t1.join();
+    t2.join();
+
+    EXPECT_TRUE(overlapped.load()) << "Read-only traversals should not serialize on node locks.";
+}
+
+TEST_F(ConcurrentListTest, ReadersWithConcurrentWriters) {
+    const int num_items = 1000;
+    for (int i = 0; i < num_items; ++i) {
+        list.push_front(i);
+    }
+
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; ++r) {
+        readers.emplace_back([&]() {
+            while (!stop.load()) {
+                int previous = num_items;
+                // 头插法插入的数据是递减的，删除偶数以后顺序也不会改变
+                list.for_each([&](const int& val) {
+                    if (val < num_items) {
+                        EXPECT_LT(val, previous);
+                        previous = val;
+                    }
+                });
+                list.find_first_if([](const int& val) { return val == 1; });
+            }
+        });
+    }
+
+    std::thread writer([&]() {
+        for (int i = num_items; i < num_items + 500; ++i) {
+            list.push_front(i);
+        }
+        list.remove_if([](const int& val) { return val % 2 == 0; });
+        list.remove_first([](const int& val) { return val == 1; });
+    });
+
+    writer.join();
+    stop.store(true);
+    for (auto& t : readers) {
+        t.join();
+    }
+
+    EXPECT_EQ(list.find_first_if([](const int& val) { return val == 1; }), nullptr);
+    int count = 0;
+    list.for_each([&](const int& val) {
+        EXPECT_NE(val % 2, 0);
+        ++count;
+    });
+    EXPECT_EQ(count, (num_items + 500) / 2 - 1);
+}
+
+TEST(ConcurrentShardedListTest, ConcurrentPushVisitsAllShards) {
+    concurrent_sharded_list<int> sharded(4);
+    const int num_threads = 8;
+    const int items_per_thread = 5000;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; ++i) {
+        threads.emplace_back([&, i]() {
+            for (int j = 0; j < items_per_thread; ++j) {
+                sharded.push_front(i * items_per_thread + j);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    std::set<int> collected;
+    sharded.for_each([&](const int& val) { collected.insert(val); });
+    EXPECT_EQ(collected.size(), num_threads * items_per_thread);
+
+    std::atomic<int> parallel_count(0);
+    sharded.parallel_for_each([&](const int&) { parallel_count.fetch_add(1); }, 3);
+    EXPECT_EQ(parallel_count.load(), num_threads * items_per_thread);
+
+    sharded.parallel_remove_if([](const int& val) { return val % 2 == 0; }, 4);
+    EXPECT_EQ(sharded.find_first_if([](const int& val) { return val % 2 == 0; }), nullptr);
+    EXPECT_TRUE(sharded.remove_first([](const int& val) { return val == 1; }));
+    EXPECT_FALSE(sharded.remove_first([](const int& val) { return val == 1; }));
+
+    int remaining = 0;
+    sharded.for_each([&](const int&) { ++remaining; });
+    EXPECT_EQ(remaining, num_threads * items_per_thread / 2 - 1);
+}
+
+TEST(ConcurrentShardedListTest, HashPolicyKeepsEqualValuesTogether) {
+    concurrent_sharded_list<int> sharded(5, shard_policy::by_hash);
+    for (int i = 0; i < 100; ++i) {
+        sharded.push_front(i % 10);
+    }
+    // 相同的值位于同一个子链表中，所以每个值只会被remove_first找到10次
+    for (int round = 0; round < 10; ++round) {
+        EXPECT_TRUE(sharded.remove_first([](const int& val) { return val == 7; }));
+    }
+    EXPECT_FALSE(sharded.remove_first([](const int& val) { return val == 7; }));
+    EXPECT_NE(sharded.find_first_if([](const int& val) { return val == 3; }), nullptr);
+}
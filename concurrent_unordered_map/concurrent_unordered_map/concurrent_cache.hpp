@@ -0,0 +1,277 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "hash_mix.hpp"
+
+// 容量有上限的并发缓存
+// 整个缓存被分成若干个分片，每个分片拥有自己的读写锁，并且独立地使用CLOCK算法淘汰元素：
+//   * 元素保存在一个环形的数组中，每个元素有一个引用位
+//   * 命中时只在共享锁下把引用位置1，不需要加写锁
+//   * 分片满了以后，时钟指针沿着数组转动，把引用位为1的元素清零（给它第二次机会），
+//     淘汰遇到的第一个引用位为0的元素
+//
+// get_or_compute保证同一个key同时未命中时只计算一次（single-flight），
+// 其他线程等待第一个线程的计算结果
+
+// 缓存的统计数据
+struct cache_stats {
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t evictions = 0;
+};
+
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class concurrent_cache {
+private:
+    struct entry {
+        Key key;
+        Value value;
+        // 最近被访问过
+        std::atomic<bool> referenced{false};
+
+        entry(const Key& key_, const Value& value_) : key(key_), value(value_) {}
+    };
+
+    struct alignas(64) shard_type {
+        mutable std::shared_mutex mutex;
+        // key -> 在entries中的下标
+        // 这里不使用concurrent_unordered_map：index、entries与pending必须在同一把写锁下一起修改
+        // （淘汰时要同时改下标与时钟的环），分片的锁已经保证了互斥，再用并发哈希表只会在每个桶上多加一次锁
+        std::unordered_map<Key, std::size_t, Hash> index;
+        // 时钟的环，entries的下标即时钟上的位置
+        std::vector<std::unique_ptr<entry>> entries;
+        std::size_t hand = 0;
+        std::size_t capacity = 0;
+        // 正在计算的key，其他线程未命中时等待这里的结果
+        std::unordered_map<Key, std::shared_future<Value>, Hash> pending;
+
+        // 只在写锁下修改
+        std::atomic<std::uint64_t> evictions{0};
+
+        // 写入一个元素，调用者需要持有写锁
+        void put(const Key& key, const Value& value) {
+            auto it = index.find(key);
+            if (it != index.end()) {
+                entry& e = *entries[it->second];
+                e.value = value;
+                e.referenced.store(true, std::memory_order_relaxed);
+                return;
+            }
+            if (entries.size() < capacity) {
+                index.emplace(key, entries.size());
+                entries.push_back(std::make_unique<entry>(key, value));
+                return;
+            }
+            // 转动时钟指针，直到找到一个最近没有被访问过的元素
+            while (entries[hand]->referenced.exchange(false, std::memory_order_relaxed)) {
+                hand = (hand + 1) % entries.size();
+            }
+            index.erase(entries[hand]->key);
+            entries[hand] = std::make_unique<entry>(key, value);
+            index.emplace(key, hand);
+            hand = (hand + 1) % entries.size();
+            evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // 删除一个元素，把最后一个元素移动到它的位置上，调用者需要持有写锁
+        void erase(const Key& key) {
+            auto it = index.find(key);
+            if (it == index.end()) {
+                return;
+            }
+            const std::size_t position = it->second;
+            index.erase(it);
+            if (position + 1 != entries.size()) {
+                entries[position] = std::move(entries.back());
+                index[entries[position]->key] = position;
+            }
+            entries.pop_back();
+            if (hand >= entries.size()) {
+                hand = 0;
+            }
+        }
+    };
+
+    // 每一个线程在计数器中对应的槽位，与concurrent_unordered_map相同
+    static std::size_t thread_ticket() {
+        static std::atomic<std::size_t> next_ticket{0};
+        thread_local const std::size_t ticket = next_ticket.fetch_add(1, std::memory_order_relaxed);
+        return ticket;
+    }
+
+    // 命中与未命中的计数器，每个槽位独占一个缓存行，不同的线程修改不同的槽位
+    // 放在分片中的话，热点key的每次命中都会修改同一个缓存行，抵消了lookup()不重复写引用位的效果
+    struct alignas(64) counter_slot {
+        std::atomic<std::uint64_t> hits{0};
+        std::atomic<std::uint64_t> misses{0};
+    };
+    static constexpr std::size_t counter_slot_count = 16;
+
+    std::size_t shard_count;
+    // shard_count = 2^shard_bits
+    unsigned shard_bits;
+    std::unique_ptr<shard_type[]> shards;
+    Hash hasher;
+    counter_slot counters[counter_slot_count];
+
+    void count_lookup(bool hit) {
+        counter_slot& slot = counters[thread_ticket() % counter_slot_count];
+        (hit ? slot.hits : slot.misses).fetch_add(1, std::memory_order_relaxed);
+    }
+
+    shard_type& shard_for(const Key& key) const {
+        const std::size_t index = shard_bits == 0 ? 0 : static_cast<std::size_t>(concurrent_hash_mix(hasher(key)) >> (64 - shard_bits));
+        return shards[index];
+    }
+
+    // 在共享锁下查找，命中时只设置引用位
+    std::optional<Value> lookup(shard_type& shard, const Key& key) const {
+        std::shared_lock<std::shared_mutex> guard(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it == shard.index.end()) {
+            return std::nullopt;
+        }
+        entry& e = *shard.entries[it->second];
+        // 引用位已经是1时不再写入，避免热点元素所在的缓存行在多个核心之间来回传递
+        if (!e.referenced.load(std::memory_order_relaxed)) {
+            e.referenced.store(true, std::memory_order_relaxed);
+        }
+        return e.value;
+    }
+
+public:
+    // capacity是整个缓存最多保存的元素个数，平均分给每个分片（分片的数量会向上取整为2的幂）
+    explicit concurrent_cache(std::size_t capacity, std::size_t num_shards = 16, const Hash& hasher_ = Hash())
+        : hasher(hasher_) {
+        shard_bits = 0;
+        while ((std::size_t(1) << shard_bits) < num_shards) {
+            ++shard_bits;
+        }
+        shard_count = std::size_t(1) << shard_bits;
+        shards.reset(new shard_type[shard_count]);
+        for (std::size_t i = 0; i < shard_count; ++i) {
+            // 前capacity % shard_count个分片多分一个，保证总容量正好是capacity
+            shards[i].capacity = capacity / shard_count + (i < capacity % shard_count ? 1 : 0);
+            shards[i].entries.reserve(shards[i].capacity);
+        }
+    }
+
+    concurrent_cache(const concurrent_cache& other) = delete;
+    concurrent_cache& operator=(const concurrent_cache& other) = delete;
+
+    std::optional<Value> get(const Key& key) {
+        shard_type& shard = shard_for(key);
+        std::optional<Value> result = lookup(shard, key);
+        count_lookup(result.has_value());
+        return result;
+    }
+
+    void put(const Key& key, const Value& value) {
+        shard_type& shard = shard_for(key);
+        std::unique_lock<std::shared_mutex> guard(shard.mutex);
+        if (shard.capacity == 0) {
+            return;
+        }
+        shard.put(key, value);
+    }
+
+    void erase(const Key& key) {
+        shard_type& shard = shard_for(key);
+        std::unique_lock<std::shared_mutex> guard(shard.mutex);
+        shard.erase(key);
+    }
+
+    // 命中时直接返回，否则调用compute(key)计算并写入缓存
+    // 多个线程同时未命中同一个key时，只有第一个线程调用compute，其余的线程等待它的结果
+    // compute抛出的异常会传递给所有等待的线程，并且不会写入缓存
+    // 只有真正调用了compute才算一次未命中，加写锁以后发现已经写入、或者等待其他线程的结果都算作命中
+    template<typename Compute>
+    Value get_or_compute(const Key& key, Compute compute) {
+        shard_type& shard = shard_for(key);
+        if (std::optional<Value> cached = lookup(shard, key)) {
+            count_lookup(true);
+            return *cached;
+        }
+
+        std::promise<Value> promise;
+        {
+            std::unique_lock<std::shared_mutex> guard(shard.mutex);
+            // 加锁之前可能已经有其他线程写入了
+            auto it = shard.index.find(key);
+            if (it != shard.index.end()) {
+                count_lookup(true);
+                return shard.entries[it->second]->value;
+            }
+            auto pending = shard.pending.find(key);
+            if (pending != shard.pending.end()) {
+                std::shared_future<Value> future = pending->second;
+                guard.unlock();
+                count_lookup(true);
+                return future.get();
+            }
+            shard.pending.emplace(key, promise.get_future().share());
+        }
+        count_lookup(false);
+
+        try {
+            Value value = compute(key);
+            {
+                std::unique_lock<std::shared_mutex> guard(shard.mutex);
+                if (shard.capacity != 0) {
+                    shard.put(key, value);
+                }
+                shard.pending.erase(key);
+            }
+            promise.set_value(value);
+            return value;
+        } catch (...) {
+            {
+                std::unique_lock<std::shared_mutex> guard(shard.mutex);
+                shard.pending.erase(key);
+            }
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+    }
+
+    std::size_t size() const {
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < shard_count; ++i) {
+            std::shared_lock<std::shared_mutex> guard(shards[i].mutex);
+            total += shards[i].entries.size();
+        }
+        return total;
+    }
+
+    std::size_t capacity() const {
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < shard_count; ++i) {
+            total += shards[i].capacity;
+        }
+        return total;
+    }
+
+    // 各个计数器之和，并发访问时只是一个近似值
+    cache_stats stats() const {
+        cache_stats result;
+        for (const counter_slot& slot : counters) {
+            result.hits += slot.hits.load(std::memory_order_relaxed);
+            result.misses += slot.misses.load(std::memory_order_relaxed);
+        }
+        for (std::size_t i = 0; i < shard_count; ++i) {
+            result.evictions += shards[i].evictions.load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+};
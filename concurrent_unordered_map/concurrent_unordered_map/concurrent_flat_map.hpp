@@ -0,0 +1,361 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+
+#include "hash_mix.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CONCURRENT_FLAT_MAP_SSE2 1
+#endif
+
+// 开放寻址的并发哈希表
+// 整个表被分成若干个分片（锁条带），每个分片拥有自己的读写锁和一张开放寻址表
+// 分片内部采用Swiss table的布局：
+//   * 每个槽位对应一个控制字节，空槽位为kEmpty，删除过的槽位为kDeleted，
+//     已使用的槽位保存哈希值的低7位（tag）
+//   * 查找时一次比较16个控制字节（一个group），只有tag相同的槽位才需要真正比较key
+//   * 元素直接存放在连续的数组中，不需要为每个元素单独分配结点
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class concurrent_flat_map {
+private:
+    typedef std::pair<Key, Value> slot_type;
+
+    static constexpr std::int8_t kEmpty = -128;
+    static constexpr std::int8_t kDeleted = -2;
+    static constexpr std::size_t kGroupWidth = 16;
+
+    // 一个group中匹配结果的位掩码，第i位为1表示第i个槽位匹配
+    struct group_mask {
+        std::uint32_t mask;
+
+        explicit operator bool() const {
+            return mask != 0;
+        }
+        // 取出最低位的匹配并清除它
+        unsigned pop() {
+            const unsigned index = static_cast<unsigned>(std::countr_zero(mask));
+            mask &= mask - 1;
+            return index;
+        }
+    };
+
+    // 从ctrl开始的16个控制字节
+    struct group {
+#ifdef CONCURRENT_FLAT_MAP_SSE2
+        __m128i ctrl;
+
+        explicit group(const std::int8_t* pos)
+            : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pos))) {
+        }
+        group_mask match(std::int8_t tag) const {
+            return {static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(tag), ctrl)))};
+        }
+        group_mask match_empty() const {
+            return match(kEmpty);
+        }
+        // kEmpty与kDeleted的最高位都是1，而tag的最高位为0
+        group_mask match_empty_or_deleted() const {
+            return {static_cast<std::uint32_t>(_mm_movemask_epi8(ctrl))};
+        }
+#else
+        // 不支持SSE2时逐字节比较
+        std::int8_t ctrl[kGroupWidth];
+
+        explicit group(const std::int8_t* pos) {
+            std::memcpy(ctrl, pos, kGroupWidth);
+        }
+        group_mask match(std::int8_t tag) const {
+            std::uint32_t mask = 0;
+            for (std::size_t i = 0; i < kGroupWidth; ++i) {
+                mask |= static_cast<std::uint32_t>(ctrl[i] == tag) << i;
+            }
+            return {mask};
+        }
+        group_mask match_empty() const {
+            return match(kEmpty);
+        }
+        group_mask match_empty_or_deleted() const {
+            std::uint32_t mask = 0;
+            for (std::size_t i = 0; i < kGroupWidth; ++i) {
+                mask |= static_cast<std::uint32_t>(ctrl[i] < 0) << i;
+            }
+            return {mask};
+        }
+#endif
+    };
+
+    // 一个分片，独占缓存行，避免相邻分片的锁之间出现伪共享
+    class alignas(64) shard_type {
+        friend class concurrent_flat_map;
+
+        mutable std::shared_mutex mutex;
+        // 控制字节，长度为capacity
+        std::unique_ptr<std::int8_t[]> ctrl;
+        // 元素数组，只有控制字节为tag的槽位中才构造了元素
+        slot_type* slots = nullptr;
+        // 槽位的个数，始终是kGroupWidth的2的幂倍
+        std::size_t capacity = 0;
+        // 元素的个数
+        std::size_t size = 0;
+        // 还可以使用的空槽位的个数，删除产生的kDeleted不会归还，用完以后需要重新整理
+        std::size_t growth_left = 0;
+
+        static std::size_t max_size_for(std::size_t capacity) {
+            // 最大负载因子为7/8
+            return capacity - capacity / 8;
+        }
+
+        void allocate(std::size_t new_capacity) {
+            ctrl.reset(new std::int8_t[new_capacity]);
+            std::memset(ctrl.get(), kEmpty, new_capacity);
+            slots = std::allocator<slot_type>().allocate(new_capacity);
+            capacity = new_capacity;
+            growth_left = max_size_for(new_capacity);
+        }
+
+        void release() {
+            if (slots == nullptr) {
+                return;
+            }
+            for (std::size_t i = 0; i < capacity; ++i) {
+                if (ctrl[i] >= 0) {
+                    std::destroy_at(slots + i);
+                }
+            }
+            std::allocator<slot_type>().deallocate(slots, capacity);
+            slots = nullptr;
+        }
+
+        // 按照group依次探测：第i次探测的group为 start + i*(i+1)/2
+        // group的个数是2的幂，所以这个序列一定会访问到所有的group
+        template<typename Visit>
+        std::size_t probe(std::size_t hash, Visit visit) const {
+            const std::size_t group_mask_bits = capacity / kGroupWidth - 1;
+            std::size_t g = hash & group_mask_bits;
+            for (std::size_t step = 1;; ++step) {
+                const std::size_t offset = g * kGroupWidth;
+                const std::size_t found = visit(offset, group(ctrl.get() + offset));
+                if (found != capacity) {
+                    return found;
+                }
+                g = (g + step) & group_mask_bits;
+            }
+        }
+
+        // 返回key所在的槽位，不存在时返回capacity
+        template<typename K>
+        std::size_t find(const K& key, std::size_t hash, std::int8_t tag) const {
+            if (capacity == 0) {
+                return capacity;
+            }
+            std::size_t result = capacity;
+            probe(hash, [&](std::size_t offset, const group& g) -> std::size_t {
+                for (group_mask match = g.match(tag); match;) {
+                    const std::size_t index = offset + match.pop();
+                    if (slots[index].first == key) {
+                        result = index;
+                        return index;
+                    }
+                }
+                // group中存在空槽位，说明key不可能在后面的group中
+                if (g.match_empty()) {
+                    return offset;
+                }
+                return capacity;
+            });
+            return result;
+        }
+
+        // 找到第一个可以插入的槽位（空的或者被删除过的）
+        std::size_t find_insert_slot(std::size_t hash) const {
+            return probe(hash, [&](std::size_t offset, const group& g) -> std::size_t {
+                if (group_mask available = g.match_empty_or_deleted()) {
+                    return offset + available.pop();
+                }
+                return capacity;
+            });
+        }
+
+        // 重新分配槽位，把所有的元素移动到新的数组中，同时清除所有的kDeleted
+        // hasher按值传入：只在rehash时复制一次，插入的路径上不需要传递hasher
+        void rehash(std::size_t new_capacity, Hash hasher) {
+            std::unique_ptr<std::int8_t[]> old_ctrl = std::move(ctrl);
+            slot_type* old_slots = slots;
+            const std::size_t old_capacity = capacity;
+            allocate(new_capacity);
+            for (std::size_t i = 0; i < old_capacity; ++i) {
+                if (old_ctrl[i] < 0) {
+                    continue;
+                }
+                const std::size_t hash = hasher(old_slots[i].first);
+                const std::size_t index = find_insert_slot(probe_hash(hash));
+                ctrl[index] = tag_of(hash);
+                std::construct_at(slots + index, std::move(old_slots[i]));
+                std::destroy_at(old_slots + i);
+                --growth_left;
+            }
+            if (old_slots != nullptr) {
+                std::allocator<slot_type>().deallocate(old_slots, old_capacity);
+            }
+        }
+
+        // 空槽位用完时rehash的目标容量：如果删除留下的kDeleted较多，原地整理即可，否则扩大一倍
+        std::size_t grown_capacity() const {
+            if (capacity == 0) {
+                return kGroupWidth;
+            }
+            return size * 2 > max_size_for(capacity) ? capacity * 2 : capacity;
+        }
+
+        // 插入一个新元素，调用者需要保证key不存在
+        // 没有可用的槽位时不插入并返回false，调用者以grown_capacity()调用rehash以后再插入
+        template<typename K, typename V>
+        bool try_insert_new(K&& key, V&& value, std::size_t hash) {
+            if (capacity == 0) {
+                return false;
+            }
+            const std::size_t index = find_insert_slot(probe_hash(hash));
+            if (ctrl[index] == kEmpty) {
+                if (growth_left == 0) {
+                    return false;
+                }
+                --growth_left;
+            }
+            ctrl[index] = tag_of(hash);
+            std::construct_at(slots + index, std::forward<K>(key), std::forward<V>(value));
+            ++size;
+            return true;
+        }
+
+        void erase(std::size_t index) {
+            std::destroy_at(slots + index);
+            --size;
+            // 如果这个槽位所在的group中还有空槽位，那么查找在这个group就会停下，可以直接标记为空
+            const std::size_t offset = index / kGroupWidth * kGroupWidth;
+            if (group(ctrl.get() + offset).match_empty()) {
+                ctrl[index] = kEmpty;
+                ++growth_left;
+            } else {
+                ctrl[index] = kDeleted;
+            }
+        }
+
+    public:
+        ~shard_type() {
+            release();
+        }
+    };
+
+    std::size_t shard_count;
+    // shard_count = 2^shard_bits
+    unsigned shard_bits;
+    std::unique_ptr<shard_type[]> shards;
+    Hash hasher;
+
+    // 哈希值打散以后，不同的位分给不同的用途：
+    // 最高的shard_bits位选择分片，最低的7位作为tag，剩下的位用于在分片内部探测
+    static std::int8_t tag_of(std::size_t hash) {
+        return static_cast<std::int8_t>(concurrent_hash_mix(hash) & 0x7F);
+    }
+    static std::size_t probe_hash(std::size_t hash) {
+        return concurrent_hash_mix(hash) >> 7;
+    }
+
+    shard_type& shard_for(std::size_t hash) const {
+        const std::size_t index = shard_bits == 0 ? 0 : static_cast<std::size_t>(
+                                      concurrent_hash_mix(hash) >> (64 - shard_bits));
+        return shards[index];
+    }
+
+public:
+    // 分片的数量会向上取整为2的幂，默认与cpu核心数的若干倍相当
+    explicit concurrent_flat_map(std::size_t num_shards = 64, const Hash& hasher_ = Hash()) : hasher(hasher_) {
+        shard_bits = 0;
+        while ((std::size_t(1) << shard_bits) < num_shards) {
+            ++shard_bits;
+        }
+        shard_count = std::size_t(1) << shard_bits;
+        shards.reset(new shard_type[shard_count]);
+    }
+
+    concurrent_flat_map(const concurrent_flat_map& other) = delete;
+    concurrent_flat_map& operator=(const concurrent_flat_map& other) = delete;
+
+    Value value_for(const Key& key, const Value& default_value = Value()) const {
+        const std::size_t hash = hasher(key);
+        const shard_type& shard = shard_for(hash);
+        std::shared_lock<std::shared_mutex> guard(shard.mutex);
+        const std::size_t index = shard.find(key, probe_hash(hash), tag_of(hash));
+        return index == shard.capacity ? default_value : shard.slots[index].second;
+    }
+
+    void add_or_update_mapping(const Key& key, const Value& value) {
+        const std::size_t hash = hasher(key);
+        shard_type& shard = shard_for(hash);
+        std::unique_lock<std::shared_mutex> guard(shard.mutex);
+        const std::size_t index = shard.find(key, probe_hash(hash), tag_of(hash));
+        if (index != shard.capacity) {
+            shard.slots[index].second = value;
+            return;
+        }
+        if (!shard.try_insert_new(key, value, hash)) {
+            shard.rehash(shard.grown_capacity(), hasher);
+            shard.try_insert_new(key, value, hash);
+        }
+    }
+
+    void remove_mapping(const Key& key) {
+        const std::size_t hash = hasher(key);
+        shard_type& shard = shard_for(hash);
+        std::unique_lock<std::shared_mutex> guard(shard.mutex);
+        const std::size_t index = shard.find(key, probe_hash(hash), tag_of(hash));
+        if (index != shard.capacity) {
+            shard.erase(index);
+        }
+    }
+
+    // 元素的个数，需要依次读取每个分片
+    std::size_t size() const {
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < shard_count; ++i) {
+            std::shared_lock<std::shared_mutex> guard(shards[i].mutex);
+            total += shards[i].size;
+        }
+        return total;
+    }
+
+    // 预留能容纳count个元素的空间，元素大致均匀地分布在各个分片中
+    void reserve(std::size_t count) {
+        const std::size_t per_shard = (count + shard_count - 1) / shard_count;
+        std::size_t capacity = kGroupWidth;
+        while (shard_type::max_size_for(capacity) < per_shard) {
+            capacity *= 2;
+        }
+        for (std::size_t i = 0; i < shard_count; ++i) {
+            std::unique_lock<std::shared_mutex> guard(shards[i].mutex);
+            if (shards[i].capacity < capacity) {
+                shards[i].rehash(capacity, hasher);
+            }
+        }
+    }
+
+    // 占用的内存（字节），包括分片、控制字节与元素数组
+    std::size_t memory_usage() const {
+        std::size_t total = sizeof(*this) + shard_count * sizeof(shard_type);
+        for (std::size_t i = 0; i < shard_count; ++i) {
+            std::shared_lock<std::shared_mutex> guard(shards[i].mutex);
+            total += shards[i].capacity * (sizeof(std::int8_t) + sizeof(slot_type));
+        }
+        return total;
+    }
+};
@@ -0,0 +1,257 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string_view>
+#include <vector>
+
+#include "hash_mix.hpp"
+
+// 以字符串为key的并发哈希表
+// 使用concurrent_unordered_map<std::string, Value>时，每个元素都要分配一个std::list的结点，
+// 较长的key还要再分配一次字符串，这里把key集中保存：
+//   * 整个表被分成若干个分片，每个分片拥有自己的读写锁、一块只追加的内存（arena）以及一张开放寻址表
+//   * key的字节被复制到分片的arena中，表中的每一项只保存哈希值、key的指针与长度以及value
+//   * 查找时先比较保存下来的哈希值，只有哈希值相同时才比较完整的key；扩容时也不需要重新计算哈希值
+//   * 删除的key在arena中留下的空间会在下一次重建arena时回收：扩容时，或者被删除的key占用的字节
+//     超过存活的key（以及一块arena、表本身的大小）时原地重建；重新插入刚刚删除的同一个key时直接复用原来的字节
+// 查找、插入与删除都直接使用std::string_view，不需要构造std::string
+template<typename Value>
+class concurrent_string_map {
+private:
+    // 分片内存放key的内存，按块分配，只追加不释放，整个arena一起释放
+    class key_arena {
+    public:
+        static constexpr std::size_t kChunkSize = 64 * 1024;
+
+        // 复制key，返回它在arena中的地址，地址在arena销毁之前不会改变
+        const char* store(std::string_view key) {
+            if (key.size() > remaining) {
+                const std::size_t chunk_size = std::max(kChunkSize, key.size());
+                chunks.emplace_back(new char[chunk_size]);
+                cursor = chunks.back().get();
+                remaining = chunk_size;
+                reserved += chunk_size;
+            }
+            char* result = cursor;
+            // 空的key也会得到一个合法的地址
+            if (!key.empty()) {
+                std::memcpy(result, key.data(), key.size());
+            }
+            cursor += key.size();
+            remaining -= key.size();
+            return result;
+        }
+
+        // arena申请的总字节数
+        std::size_t bytes_reserved() const {
+            return reserved;
+        }
+
+    private:
+        std::vector<std::unique_ptr<char[]>> chunks;
+        char* cursor = nullptr;
+        std::size_t remaining = 0;
+        std::size_t reserved = 0;
+    };
+
+    enum class slot_state : std::uint8_t {
+        empty,
+        used,
+        deleted
+    };
+
+    struct entry {
+        std::uint64_t hash;
+        const char* key;
+        std::uint32_t length;
+        slot_state state;
+        Value value;
+
+        std::string_view key_view() const {
+            return std::string_view(key, length);
+        }
+    };
+
+    struct alignas(64) shard_type {
+        mutable std::shared_mutex mutex;
+        key_arena arena;
+        std::vector<entry> entries;
+        std::size_t size = 0;
+        // 已经被删除的槽位的个数，探测时不能停在这些槽位上
+        std::size_t deleted = 0;
+        // arena中存活的key与已经被删除的key各自占用的字节数
+        std::size_t live_bytes = 0;
+        std::size_t dead_bytes = 0;
+
+        // 返回key所在的下标，不存在时返回entries.size()
+        std::size_t find(std::uint64_t hash, std::string_view key) const {
+            if (entries.empty()) {
+                return 0;
+            }
+            const std::size_t mask = entries.size() - 1;
+            for (std::size_t index = hash & mask;; index = (index + 1) & mask) {
+                const entry& e = entries[index];
+                if (e.state == slot_state::empty) {
+                    return entries.size();
+                }
+                // 先比较哈希值，大多数不相同的key在这里就被排除了
+                if (e.state == slot_state::used && e.hash == hash && e.key_view() == key) {
+                    return index;
+                }
+            }
+        }
+
+        // 把所有的元素放到一张容量为capacity的新表中，同时把key复制到一块新的arena中，回收被删除的key的空间
+        void rehash(std::size_t capacity) {
+            std::vector<entry> old_entries(capacity, entry{0, nullptr, 0, slot_state::empty, Value()});
+            old_entries.swap(entries);
+            key_arena old_arena;
+            std::swap(old_arena, arena);
+            const std::size_t mask = capacity - 1;
+            for (entry& e : old_entries) {
+                if (e.state != slot_state::used) {
+                    continue;
+                }
+                std::size_t index = e.hash & mask;
+                while (entries[index].state != slot_state::empty) {
+                    index = (index + 1) & mask;
+                }
+                entries[index] = entry{e.hash, arena.store(e.key_view()), e.length, slot_state::used, std::move(e.value)};
+            }
+            deleted = 0;
+            dead_bytes = 0;
+        }
+
+        // 被删除的key浪费的字节超过存活的key时需要重建arena
+        // 同时要求超过一块arena与表本身的大小，这样重建的开销（与容量和存活的字节数成正比）可以分摊到被删除的字节上
+        bool arena_wasteful() const {
+            return dead_bytes > std::max({live_bytes, key_arena::kChunkSize, entries.size() * sizeof(entry)});
+        }
+
+        void insert_new(std::uint64_t hash, std::string_view key, const Value& value) {
+            // 最大负载因子为7/8（被删除的槽位也算在内）
+            if ((size + deleted + 1) * 8 > entries.size() * 7) {
+                std::size_t capacity = 16;
+                while (capacity * 7 < (size + 1) * 2 * 8) {
+                    capacity *= 2;
+                }
+                rehash(capacity);
+            } else if (arena_wasteful()) {
+                rehash(entries.size());
+            }
+            const std::size_t mask = entries.size() - 1;
+            std::size_t index = hash & mask;
+            while (entries[index].state == slot_state::used) {
+                index = (index + 1) & mask;
+            }
+            const char* stored = nullptr;
+            if (entries[index].state == slot_state::deleted) {
+                --deleted;
+                // 删除以后马上重新插入同一个key时，原来的字节还在arena中，直接复用
+                if (entries[index].hash == hash && entries[index].key_view() == key) {
+                    stored = entries[index].key;
+                    dead_bytes -= key.size();
+                }
+            }
+            if (stored == nullptr) {
+                stored = arena.store(key);
+            }
+            entries[index] = entry{hash, stored, static_cast<std::uint32_t>(key.size()), slot_state::used, value};
+            ++size;
+            live_bytes += key.size();
+        }
+
+        void erase(std::size_t index) {
+            entries[index].state = slot_state::deleted;
+            entries[index].value = Value();
+            --size;
+            ++deleted;
+            live_bytes -= entries[index].length;
+            dead_bytes += entries[index].length;
+        }
+    };
+
+    std::size_t shard_count;
+    // shard_count = 2^shard_bits
+    unsigned shard_bits;
+    std::unique_ptr<shard_type[]> shards;
+
+    // 先用std::hash计算字符串的哈希值，再打散，最高位选择分片，低位用于分片内部的探测
+    static std::uint64_t hash_of(std::string_view key) {
+        return concurrent_hash_mix(std::hash<std::string_view>()(key));
+    }
+
+    shard_type& shard_for(std::uint64_t hash) const {
+        return shards[shard_bits == 0 ? 0 : static_cast<std::size_t>(hash >> (64 - shard_bits))];
+    }
+
+public:
+    // 分片的数量会向上取整为2的幂
+    explicit concurrent_string_map(std::size_t num_shards = 64) {
+        shard_bits = 0;
+        while ((std::size_t(1) << shard_bits) < num_shards) {
+            ++shard_bits;
+        }
+        shard_count = std::size_t(1) << shard_bits;
+        shards.reset(new shard_type[shard_count]);
+    }
+
+    concurrent_string_map(const concurrent_string_map& other) = delete;
+    concurrent_string_map& operator=(const concurrent_string_map& other) = delete;
+
+    Value value_for(std::string_view key, const Value& default_value = Value()) const {
+        const std::uint64_t hash = hash_of(key);
+        const shard_type& shard = shard_for(hash);
+        std::shared_lock<std::shared_mutex> guard(shard.mutex);
+        const std::size_t index = shard.find(hash, key);
+        return index == shard.entries.size() ? default_value : shard.entries[index].value;
+    }
+
+    void add_or_update_mapping(std::string_view key, const Value& value) {
+        const std::uint64_t hash = hash_of(key);
+        shard_type& shard = shard_for(hash);
+        std::unique_lock<std::shared_mutex> guard(shard.mutex);
+        const std::size_t index = shard.find(hash, key);
+        if (index != shard.entries.size()) {
+            shard.entries[index].value = value;
+            return;
+        }
+        shard.insert_new(hash, key, value);
+    }
+
+    void remove_mapping(std::string_view key) {
+        const std::uint64_t hash = hash_of(key);
+        shard_type& shard = shard_for(hash);
+        std::unique_lock<std::shared_mutex> guard(shard.mutex);
+        const std::size_t index = shard.find(hash, key);
+        if (index != shard.entries.size()) {
+            shard.erase(index);
+        }
+    }
+
+    // 元素的个数，需要依次读取每个分片
+    std::size_t size() const {
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < shard_count; ++i) {
+            std::shared_lock<std::shared_mutex> guard(shards[i].mutex);
+            total += shards[i].size;
+        }
+        return total;
+    }
+
+    // 表与arena占用的字节数（不包括分片本身）
+    std::size_t memory_usage() const {
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < shard_count; ++i) {
+            std::shared_lock<std::shared_mutex> guard(shards[i].mutex);
+            total += shards[i].entries.capacity() * sizeof(entry) + shards[i].arena.bytes_reserved();
+        }
+        return total;
+    }
+};
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+#include "hash_mix.hpp"
+
+// 锁条带与桶分离的并发哈希表
+// concurrent_unordered_map中每个桶都是单独分配的，并且各自带有一把std::shared_mutex，
+// 桶很多时内存占用大，查找时也要多访问一次内存。这里把两者分开：
+//   * 所有的桶只是一个连续的链表头指针数组（每个桶8个字节）
+//   * 锁是另一个独立设置大小的数组，每把锁独占一个缓存行，第i个桶由第(i % 锁的数量)把锁保护
+// 桶的下标取哈希值的低位，锁的数量与桶的数量都是2的幂，并且桶的数量不少于锁的数量，
+// 所以一个key对应的锁只取决于哈希值的低几位，桶的数量翻倍以后仍然由同一把锁保护
+// 扩容时按顺序锁住所有的锁，然后在原地把结点重新挂到新的桶数组上，不需要重新分配结点
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class concurrent_striped_map {
+private:
+    struct node {
+        node* next;
+        // 缓存哈希值，比较key之前先比较哈希值，扩容时也不需要重新计算
+        std::size_t hash;
+        Key key;
+        Value value;
+    };
+
+    struct alignas(64) stripe_type {
+        mutable std::shared_mutex mutex;
+        // 这把锁保护的所有桶中元素的个数，只在持有写锁时修改
+        std::atomic<std::size_t> size{0};
+    };
+
+    // 连续的链表头数组，只在持有所有的锁时替换
+    std::vector<node*> buckets;
+    std::size_t stripe_count;
+    std::unique_ptr<stripe_type[]> stripes;
+    Hash hasher;
+    float max_load_factor_ = 1.0f;
+
+    stripe_type& stripe_for(std::size_t hash) const {
+        return stripes[hash & (stripe_count - 1)];
+    }
+
+    // 调用者需要持有对应的锁
+    node** find_link(std::size_t hash, const Key& key) {
+        node** link = &buckets[hash & (buckets.size() - 1)];
+        while (*link != nullptr && ((*link)->hash != hash || !((*link)->key == key))) {
+            link = &(*link)->next;
+        }
+        return link;
+    }
+
+    static std::size_t round_up(std::size_t count) {
+        std::size_t result = 1;
+        while (result < count) {
+            result *= 2;
+        }
+        return result;
+    }
+
+    // 把桶的数量扩大到至少num_buckets个
+    // 按下标的顺序锁住所有的锁（所以不会死锁），然后把所有的结点挂到新的桶数组上
+    void resize(std::size_t num_buckets) {
+        std::vector<std::unique_lock<std::shared_mutex>> locks;
+        locks.reserve(stripe_count);
+        for (std::size_t i = 0; i < stripe_count; ++i) {
+            locks.emplace_back(stripes[i].mutex);
+        }
+        // 等待锁的过程中，其他线程可能已经扩容过了
+        if (buckets.size() >= num_buckets) {
+            return;
+        }
+        std::vector<node*> new_buckets(round_up(num_buckets), nullptr);
+        for (node* head : buckets) {
+            while (head != nullptr) {
+                node* const next = head->next;
+                node*& target = new_buckets[head->hash & (new_buckets.size() - 1)];
+                head->next = target;
+                target = head;
+                head = next;
+            }
+        }
+        buckets.swap(new_buckets);
+    }
+
+public:
+    // 桶与锁的数量都会向上取整为2的幂，桶的数量不少于锁的数量
+    // 元素变多以后桶的数量会自动增加，锁的数量不会改变
+    explicit concurrent_striped_map(std::size_t num_buckets = 16, std::size_t num_stripes = 256,
+                                    const Hash& hasher_ = Hash())
+        : stripe_count(round_up(std::max<std::size_t>(num_stripes, 1))), hasher(hasher_) {
+        buckets.assign(std::max(round_up(num_buckets), stripe_count), nullptr);
+        stripes.reset(new stripe_type[stripe_count]);
+    }
+
+    concurrent_striped_map(const concurrent_striped_map& other) = delete;
+    concurrent_striped_map& operator=(const concurrent_striped_map& other) = delete;
+
+    // 析构时不能有其他线程还在使用这个哈希表
+    ~concurrent_striped_map() {
+        for (node* head : buckets) {
+            while (head != nullptr) {
+                node* const next = head->next;
+                delete head;
+                head = next;
+            }
+        }
+    }
+
+    Value value_for(const Key& key, const Value& default_value = Value()) const {
+        const std::size_t hash = concurrent_hash_mix(hasher(key));
+        std::shared_lock<std::shared_mutex> guard(stripe_for(hash).mutex);
+        for (const node* current = buckets[hash & (buckets.size() - 1)]; current != nullptr; current = current->next) {
+            if (current->hash == hash && current->key == key) {
+                return current->value;
+            }
+        }
+        return default_value;
+    }
+
+    void add_or_update_mapping(const Key& key, const Value& value) {
+        const std::size_t hash = concurrent_hash_mix(hasher(key));
+        stripe_type& stripe = stripe_for(hash);
+        std::size_t bucket_count;
+        {
+            std::unique_lock<std::shared_mutex> guard(stripe.mutex);
+            node** link = find_link(hash, key);
+            if (*link != nullptr) {
+                (*link)->value = value;
+                return;
+            }
+            *link = new node{nullptr, hash, key, value};
+            stripe.size.store(stripe.size.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            bucket_count = buckets.size();
+        }
+        // 只有当前这把锁保护的元素超过了它平均分到的桶的负载时，才去累加所有的计数器
+        const std::size_t buckets_per_stripe = bucket_count / stripe_count;
+        if (static_cast<float>(stripe.size.load(std::memory_order_relaxed)) > max_load_factor_ * static_cast<float>(buckets_per_stripe) &&
+            static_cast<float>(size()) > max_load_factor_ * static_cast<float>(bucket_count)) {
+            resize(bucket_count * 2);
+        }
+    }
+
+    void remove_mapping(const Key& key) {
+        const std::size_t hash = concurrent_hash_mix(hasher(key));
+        stripe_type& stripe = stripe_for(hash);
+        std::unique_lock<std::shared_mutex> guard(stripe.mutex);
+        node** link = find_link(hash, key);
+        if (*link == nullptr) {
+            return;
+        }
+        node* const removed = *link;
+        *link = removed->next;
+        stripe.size.store(stripe.size.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+        guard.unlock();
+        delete removed;
+    }
+
+    // 元素的个数，并发修改时只是一个近似值
+    std::size_t size() const {
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < stripe_count; ++i) {
+            total += stripes[i].size.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    std::size_t bucket_count() const {
+        std::shared_lock<std::shared_mutex> guard(stripes[0].mutex);
+        return buckets.size();
+    }
+
+    std::size_t lock_count() const {
+        return stripe_count;
+    }
+
+    // 占用的内存（字节），包括桶数组、锁数组与所有的结点
+    std::size_t memory_usage() const {
+        std::size_t total = sizeof(*this) + stripe_count * sizeof(stripe_type) + size() * sizeof(node);
+        // 替换桶数组时持有所有的锁，所以持有任意一把锁就可以读取
+        std::shared_lock<std::shared_mutex> guard(stripes[0].mutex);
+        return total + buckets.capacity() * sizeof(node*);
+    }
+
+    // 预留至少能容纳count个元素的桶
+    void reserve(std::size_t count) {
+        const auto needed = static_cast<std::size_t>(static_cast<float>(count) / max_load_factor_) + 1;
+        if (bucket_count() < needed) {
+            resize(needed);
+        }
+    }
+
+    float max_load_factor() const {
+        return max_load_factor_;
+    }
+
+    // 只应该在没有其他线程访问时修改
+    void max_load_factor(float ml) {
+        max_load_factor_ = ml > 0 ? ml : 1.0f;
+    }
+};
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#include "concurrent_unordered_map_v1.hpp"
+
+// 分层时间轮，记录每个key的过期时间（以tick为单位）
+// 共有kLevels层，每层kSlots个槽，第l层的一个槽覆盖kSlots^l个tick：
+//   * 插入时根据距离过期还有多少个tick选择层，放到对应的槽中，时间复杂度O(1)
+//   * 时间每前进一个tick，处理第0层的一个槽；每当第l层的一个槽所覆盖的时间段开始时，
+//     把这个槽中的所有元素重新放到更低的层中（级联）
+// 超出最大范围的元素先放在最高层最远的槽中，到期时再重新放入
+// 不是线程安全的，由调用者加锁
+template<typename Key>
+class timing_wheel {
+public:
+    struct timer {
+        Key key;
+        std::int64_t expires_tick;
+    };
+
+    static constexpr int kLevelBits = 6;
+    static constexpr std::size_t kSlots = std::size_t(1) << kLevelBits;
+    static constexpr int kLevels = 4;
+    // 时间轮能直接表示的最大距离
+    static constexpr std::int64_t kRange = std::int64_t(1) << (kLevelBits * kLevels);
+
+    // 添加一个定时器，已经到期的定时器在下一个tick到期
+    void add(timer t) {
+        place(std::move(t), current_tick + 1);
+        ++count;
+    }
+
+    // 把时间前进到tick，所有到期的定时器追加到due中
+    void advance(std::int64_t tick, std::vector<timer>& due) {
+        while (current_tick < tick) {
+            ++current_tick;
+            // 先级联较高的层，再处理第0层
+            for (int level = kLevels - 1; level > 0; --level) {
+                const int shift = kLevelBits * level;
+                if ((current_tick & ((std::int64_t(1) << shift) - 1)) == 0) {
+                    cascade(level, static_cast<std::size_t>(current_tick >> shift) & (kSlots - 1));
+                }
+            }
+            std::vector<timer>& slot = slots[0][static_cast<std::size_t>(current_tick) & (kSlots - 1)];
+            std::vector<timer> fired;
+            fired.swap(slot);
+            for (timer& t : fired) {
+                if (t.expires_tick > current_tick) {
+                    // 超出范围而被提前放入的定时器
+                    place(std::move(t), current_tick + 1);
+                } else {
+                    due.push_back(std::move(t));
+                    --count;
+                }
+            }
+        }
+    }
+
+    std::int64_t now() const {
+        return current_tick;
+    }
+
+    // 还没有到期的定时器的个数
+    std::size_t size() const {
+        return count;
+    }
+
+private:
+    std::array<std::array<std::vector<timer>, kSlots>, kLevels> slots;
+    std::int64_t current_tick = 0;
+    std::size_t count = 0;
+
+    // 把定时器放到合适的槽中，它最早在floor这个tick到期
+    void place(timer t, std::int64_t floor) {
+        std::int64_t expires = std::clamp(t.expires_tick, floor, current_tick + kRange - 1);
+        const std::int64_t delta = expires - current_tick;
+        int level = 0;
+        while (level + 1 < kLevels && delta >= (std::int64_t(1) << (kLevelBits * (level + 1)))) {
+            ++level;
+        }
+        slots[level][static_cast<std::size_t>(expires >> (kLevelBits * level)) & (kSlots - 1)].push_back(std::move(t));
+    }
+
+    void cascade(int level, std::size_t index) {
+        std::vector<timer> moved;
+        moved.swap(slots[level][index]);
+        for (timer& t : moved) {
+            place(std::move(t), current_tick);
+        }
+    }
+};
+
+// 每个元素都有过期时间的并发哈希表，适合保存会话等数据
+// 数据保存在concurrent_unordered_map中，每个value旁边记录它的过期时间：
+//   * 查找时，已经过期的元素被当作不存在，不需要等待它被删除
+//   * 每个元素在分层时间轮中只有一个定时器，元素记录这个定时器到期的tick。时间轮被分成若干个分片，各自有一把锁
+//   * 重新写入把过期时间推后时不添加新的定时器，也不需要时间轮的锁；旧的定时器提前到期时，
+//     清理线程按元素当前的过期时间把它重新放入时间轮。只有过期时间提前时才需要一个新的定时器
+//   * 后台的清理线程每个tick把时间轮前进到当前时间，最多删除max_expirations_per_tick个到期的元素，
+//     剩下的留到下一个tick，所以每次清理的时间是有上限的，也不需要扫描整个哈希表
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class concurrent_ttl_map {
+public:
+    using clock = std::chrono::steady_clock;
+
+private:
+    struct entry {
+        Value value;
+        // 相对于start的纳秒数，0表示不存在
+        std::int64_t expires_ns;
+        // 这个元素在时间轮中的定时器到期的tick，与它不同的定时器都已经作废
+        std::int64_t timer_tick;
+    };
+
+    using wheel_type = timing_wheel<Key>;
+    using timer = typename wheel_type::timer;
+
+    struct alignas(64) wheel_shard {
+        std::mutex mutex;
+        wheel_type wheel;
+        // 已经到期，但是还没有被处理的定时器
+        std::vector<timer> due;
+    };
+
+    static constexpr std::size_t kWheelShards = 16;
+
+    concurrent_unordered_map<Key, entry, Hash> map;
+    Hash hasher;
+    const clock::time_point start;
+    const clock::duration default_ttl;
+    const clock::duration tick;
+    const std::size_t max_expirations_per_tick;
+    std::array<wheel_shard, kWheelShards> shards;
+    // 每次清理从不同的分片开始，保证到期的元素很多时每个分片都能被处理
+    std::size_t next_shard = 0;
+    std::mutex sweep_mutex;
+
+    std::mutex sweeper_mutex;
+    std::condition_variable_any sweeper_cv;
+    // 最后声明，析构时最先停止并等待清理线程退出
+    std::jthread sweeper;
+
+    std::int64_t now_ns() const {
+        // 加1保证不会与表示不存在的0相同
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count() + 1;
+    }
+
+    std::int64_t tick_of(std::int64_t ns) const {
+        const std::int64_t tick_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(tick).count();
+        return (ns + tick_ns - 1) / tick_ns;
+    }
+
+    wheel_shard& shard_for(const Key& key) {
+        return shards[(static_cast<std::uint64_t>(hasher(key)) * 0x9E3779B97F4A7C15ull) >> 60];
+    }
+
+public:
+    // default_ttl：不指定时使用的存活时间；tick：时间轮的精度，也是后台清理的间隔
+    // max_expirations_per_tick：每次清理最多删除的元素个数；background为false时不启动清理线程，需要自己调用sweep()
+    explicit concurrent_ttl_map(clock::duration default_ttl_, clock::duration tick_ = std::chrono::milliseconds(100),
+                                std::size_t max_expirations_per_tick_ = 4096, bool background = true)
+        : start(clock::now()), default_ttl(default_ttl_), tick(std::max<clock::duration>(tick_, std::chrono::microseconds(1))),
+          max_expirations_per_tick(std::max<std::size_t>(max_expirations_per_tick_, 1)) {
+        if (background) {
+            sweeper = std::jthread([this](std::stop_token token) {
+                while (!token.stop_requested()) {
+                    sweep();
+                    std::unique_lock<std::mutex> guard(sweeper_mutex);
+                    sweeper_cv.wait_for(guard, token, tick, [] { return false; });
+                }
+            });
+        }
+    }
+
+    concurrent_ttl_map(const concurrent_ttl_map& other) = delete;
+    concurrent_ttl_map& operator=(const concurrent_ttl_map& other) = delete;
+
+    // 不存在或者已经过期时返回default_value
+    Value value_for(const Key& key, const Value& default_value = Value()) {
+        const entry e = map.value_for(key, entry{default_value, 0, 0});
+        return e.expires_ns > now_ns() ? e.value : default_value;
+    }
+
+    std::optional<Value> get(const Key& key) {
+        const entry e = map.value_for(key, entry{Value(), 0, 0});
+        if (e.expires_ns > now_ns()) {
+            return e.value;
+        }
+        return std::nullopt;
+    }
+
+    void add_or_update_mapping(const Key& key, const Value& value) {
+        add_or_update_mapping(key, value, default_ttl);
+    }
+
+    // 写入key，ttl以后过期，已经存在的key会被覆盖，过期时间重新计算
+    void add_or_update_mapping(const Key& key, const Value& value, clock::duration ttl) {
+        const std::int64_t expires = now_ns() + std::max<std::int64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(ttl).count(), 0);
+        const std::int64_t expires_tick = tick_of(expires);
+        bool arm = false;
+        map.compute(key, [&](const std::optional<entry>& old) -> std::optional<entry> {
+            // 已有的定时器不晚于新的过期时间：它到期时会被重新放入，不需要新的定时器
+            if (old && old->timer_tick <= expires_tick) {
+                return entry{value, expires, old->timer_tick};
+            }
+            arm = true;
+            return entry{value, expires, expires_tick};
+        });
+        if (arm) {
+            add_timer(timer{key, expires_tick});
+        }
+    }
+
+    // 对应的定时器留在时间轮中，到期时发现元素已经不存在，直接丢弃
+    void remove_mapping(const Key& key) {
+        map.remove_mapping(key);
+    }
+
+    // 包括已经过期但是还没有被清理的元素，并发修改时只是一个近似值
+    std::size_t size() const {
+        return map.size();
+    }
+
+    // 时间轮中还没有处理的定时器的个数，通常每个元素一个
+    // （过期时间被提前，或者删除以后重新写入时，旧的定时器到期之前会多一个）
+    std::size_t pending_expirations() {
+        std::size_t total = 0;
+        for (wheel_shard& shard : shards) {
+            std::lock_guard<std::mutex> guard(shard.mutex);
+            total += shard.wheel.size() + shard.due.size();
+        }
+        return total;
+    }
+
+    // 把时间轮前进到当前时间，删除最多max_expirations_per_tick个到期的元素，返回删除的个数
+    // 由后台线程定期调用，也可以手动调用
+    std::size_t sweep() {
+        std::lock_guard<std::mutex> sweep_guard(sweep_mutex);
+        const std::int64_t now = now_ns();
+        const std::int64_t current_tick = now / std::chrono::duration_cast<std::chrono::nanoseconds>(tick).count();
+        std::vector<timer> batch;
+        std::size_t budget = max_expirations_per_tick;
+        for (std::size_t i = 0; i < kWheelShards; ++i) {
+            wheel_shard& shard = shards[(next_shard + i) % kWheelShards];
+            std::lock_guard<std::mutex> guard(shard.mutex);
+            shard.wheel.advance(current_tick, shard.due);
+            const std::size_t taken = std::min(budget, shard.due.size());
+            batch.insert(batch.end(), std::make_move_iterator(shard.due.end() - static_cast<std::ptrdiff_t>(taken)),
+                         std::make_move_iterator(shard.due.end()));
+            shard.due.resize(shard.due.size() - taken);
+            budget -= taken;
+        }
+        next_shard = (next_shard + 1) % kWheelShards;
+
+        std::size_t removed = 0;
+        std::vector<timer> rearmed;
+        for (const timer& t : batch) {
+            map.compute(t.key, [&](std::optional<entry> e) -> std::optional<entry> {
+                // 元素已经被删除，或者过期时间提前以后有了新的定时器
+                if (!e || e->timer_tick != t.expires_tick) {
+                    return e;
+                }
+                if (e->expires_ns <= now) {
+                    ++removed;
+                    return std::nullopt;
+                }
+                // 元素被重新写入，过期时间推后了
+                e->timer_tick = tick_of(e->expires_ns);
+                rearmed.push_back(timer{t.key, e->timer_tick});
+                return e;
+            });
+        }
+        for (timer& t : rearmed) {
+            add_timer(std::move(t));
+        }
+        return removed;
+    }
+
+private:
+    void add_timer(timer t) {
+        wheel_shard& shard = shard_for(t.key);
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        shard.wheel.add(std::move(t));
+    }
+};
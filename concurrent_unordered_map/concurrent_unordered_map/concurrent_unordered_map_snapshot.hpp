@@ -0,0 +1,201 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CONCURRENT_UNORDERED_MAP_MMAP 1
+#endif
+
+#include "concurrent_unordered_map_v1.hpp"
+
+// concurrent_unordered_map的二进制快照，用于服务重启时快速恢复数据
+// 只支持key与value都可以按字节复制的类型，文件的格式为：
+//   snapshot_header + count条记录，每条记录为key的字节紧接着value的字节（没有填充）
+// 文件使用本机的字节序，只能在相同的平台上读取
+
+struct snapshot_header {
+    char magic[8];
+    std::uint32_t key_size;
+    std::uint32_t value_size;
+    std::uint64_t count;
+};
+
+inline constexpr char snapshot_magic[8] = {'C', 'U', 'M', 'A', 'P', 'S', 'N', '1'};
+
+// 只读地映射整个文件，不支持mmap的平台上退化为一次性读入内存
+class mapped_file {
+public:
+    explicit mapped_file(const std::string& path) {
+#ifdef CONCURRENT_UNORDERED_MAP_MMAP
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st{};
+        if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* address = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address != MAP_FAILED) {
+                // 按顺序读取，让内核提前把后面的页读进来
+                ::madvise(address, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+                m_data = static_cast<const char*>(address);
+                m_size = static_cast<std::size_t>(st.st_size);
+                m_mapped = true;
+            }
+        }
+        ::close(fd);
+        if (m_mapped) {
+            return;
+        }
+#endif
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            return;
+        }
+        m_buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        m_data = m_buffer.data();
+        m_size = m_buffer.size();
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    ~mapped_file() {
+#ifdef CONCURRENT_UNORDERED_MAP_MMAP
+        if (m_mapped) {
+            ::munmap(const_cast<char*>(m_data), m_size);
+        }
+#endif
+    }
+
+    const char* data() const {
+        return m_data;
+    }
+
+    std::size_t size() const {
+        return m_size;
+    }
+
+private:
+    const char* m_data = nullptr;
+    std::size_t m_size = 0;
+    bool m_mapped = false;
+    std::vector<char> m_buffer;
+};
+
+// 把map中的所有元素写入path，返回是否成功
+// 写入的过程中其他线程可以继续读写，结果与for_each一样是弱一致的
+// 先写入path + ".tmp"，全部写完以后才重命名为path：中途失败或者崩溃时path仍然是上一次完整的快照，
+// 不会留下一个头部的元素个数还是0、看起来合法的空快照
+template<typename Key, typename Value, typename Hash>
+    requires std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<Value>
+bool save_snapshot(const concurrent_unordered_map<Key, Value, Hash>& map, const std::string& path) {
+    const std::string temp_path = path + ".tmp";
+    std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+    snapshot_header header{};
+    std::memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+    header.key_size = sizeof(Key);
+    header.value_size = sizeof(Value);
+    // 元素的个数在写完以后才知道，先占位
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    constexpr std::size_t record_size = sizeof(Key) + sizeof(Value);
+    char record[record_size];
+    map.for_each([&](const Key& key, const Value& value) {
+        std::memcpy(record, &key, sizeof(Key));
+        std::memcpy(record + sizeof(Key), &value, sizeof(Value));
+        out.write(record, record_size);
+        ++header.count;
+    });
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+    std::error_code error;
+    if (!out) {
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+    // 同一个目录中的重命名是原子的，并且会替换已经存在的path
+    std::filesystem::rename(temp_path, path, error);
+    if (error) {
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+    return true;
+}
+
+// 把save_snapshot写入的文件读入map（已经存在的key会被覆盖），返回是否成功
+// 文件被映射到内存中，先根据元素的个数一次性扩容，然后把记录平均分给thread_num个线程，
+// 每个线程每次用multi_put插入一批，每个桶只加一次锁
+template<typename Key, typename Value, typename Hash>
+    requires std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<Value>
+bool load_snapshot(concurrent_unordered_map<Key, Value, Hash>& map, const std::string& path,
+                   std::size_t thread_num = std::thread::hardware_concurrency()) {
+    const mapped_file file(path);
+    snapshot_header header{};
+    if (file.size() < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    constexpr std::size_t record_size = sizeof(Key) + sizeof(Value);
+    if (std::memcmp(header.magic, snapshot_magic, sizeof(header.magic)) != 0 || header.key_size != sizeof(Key) ||
+        header.value_size != sizeof(Value) || (file.size() - sizeof(header)) / record_size < header.count) {
+        return false;
+    }
+    const std::size_t count = static_cast<std::size_t>(header.count);
+    map.reserve(map.size() + count);
+
+    const char* records = file.data() + sizeof(header);
+    auto load_range = [records](concurrent_unordered_map<Key, Value, Hash>& target, std::size_t begin, std::size_t end) {
+        constexpr std::size_t batch_size = 1024;
+        std::vector<std::pair<Key, Value>> batch;
+        batch.reserve(batch_size);
+        for (std::size_t i = begin; i < end; ++i) {
+            const char* record = records + i * record_size;
+            // 记录之间没有填充，可能没有对齐，所以先memcpy到字节数组中，再用bit_cast构造，
+            // 不要求Key与Value可以默认构造
+            std::array<char, sizeof(Key)> key_bytes;
+            std::array<char, sizeof(Value)> value_bytes;
+            std::memcpy(key_bytes.data(), record, sizeof(Key));
+            std::memcpy(value_bytes.data(), record + sizeof(Key), sizeof(Value));
+            batch.emplace_back(std::bit_cast<Key>(key_bytes), std::bit_cast<Value>(value_bytes));
+            if (batch.size() == batch_size) {
+                target.multi_put(batch);
+                batch.clear();
+            }
+        }
+        if (!batch.empty()) {
+            target.multi_put(batch);
+        }
+    };
+
+    thread_num = std::clamp<std::size_t>(thread_num, 1, std::max<std::size_t>(count, 1));
+    const std::size_t per_thread = (count + thread_num - 1) / thread_num;
+    std::vector<std::jthread> workers;
+    workers.reserve(thread_num - 1);
+    for (std::size_t t = 1; t < thread_num; ++t) {
+        const std::size_t begin = std::min(t * per_thread, count);
+        const std::size_t end = std::min(begin + per_thread, count);
+        workers.emplace_back(load_range, std::ref(map), begin, end);
+    }
+    // 当前线程处理第一段
+    load_range(map, 0, std::min(per_thread, count));
+    return true;
+}
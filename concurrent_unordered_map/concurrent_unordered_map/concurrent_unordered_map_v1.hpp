@@ -8,10 +8,167 @@
 #include <shared_mutex>
 #include <iterator>
 #include <map>
+#include <atomic>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <thread>
+#include <type_traits>
+#include <optional>
+#include <utility>
+#include <future>
+#include <functional>
+#include <stdexcept>
+
+// 在包含这个头文件之前定义CONCURRENT_UNORDERED_MAP_STATS，可以开启统计功能（stats()/reset_stats()）
+// 没有定义时，所有统计相关的成员与代码都不会被编译，不会有任何额外的开销
+#ifdef CONCURRENT_UNORDERED_MAP_STATS
+#include <chrono>
+
+// concurrent_unordered_map::stats()的结果，只统计当前的表（以及正在迁移的目标表），扩容完成以后重新开始统计
+struct concurrent_unordered_map_stats {
+    // 一个桶的统计数据
+    struct bucket_stats {
+        // 所在的表的桶的数量，以及在这张表中的下标
+        std::size_t table_buckets = 0;
+        std::size_t index = 0;
+        std::size_t chain_length = 0;
+        std::uint64_t lock_count = 0;
+        std::uint64_t contended_count = 0;
+        std::chrono::nanoseconds lock_wait{0};
+    };
+
+    // 元素的个数（分散计数器之和）
+    std::size_t size = 0;
+    std::size_t bucket_count = 0;
+    // chain_length_histogram[i]为链表长度为i的桶的个数，最后一项统计长度大于等于它的所有桶
+    std::vector<std::size_t> chain_length_histogram;
+    std::size_t max_chain_length = 0;
+    // 所有桶加锁的总次数，其中需要等待的次数，以及等待的总时间
+    std::uint64_t lock_count = 0;
+    std::uint64_t contended_count = 0;
+    std::chrono::nanoseconds lock_wait{0};
+    // 等待时间最长的几个桶（等待时间相同时按加锁次数排序），从大到小
+    std::vector<bucket_stats> hot_buckets;
+};
+#endif
+
+// 哈希函数中定义了is_transparent时，查找可以直接使用与Key可比较的其他类型（比如用std::string_view查找std::string），
+// 不需要先构造一个临时的Key。同一个key的两种表示必须得到相同的哈希值
+template<typename Hash, typename K, typename Key>
+concept heterogeneous_lookup = !std::is_same_v<std::remove_cvref_t<K>, Key> &&
+                               requires { typename Hash::is_transparent; } &&
+                               std::is_invocable_v<const Hash&, const K&>;
+
+// concurrent_unordered_map::freeze()的结果：不可修改的哈希表，可以被任意多个线程同时读取，不需要任何同步
+// 所有的元素按桶的下标排好序，连续地放在一个数组中，offsets[i]到offsets[i + 1]为第i个桶的元素：
+//   * 没有锁，也没有链表的指针，每个元素只多占用一个offsets的位置（4个字节）
+//   * 桶的数量是不小于元素个数的2的幂，查找时先读offsets中相邻的两项（通常在同一个缓存行中），
+//     再在连续的内存中比较平均不到一个元素
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class frozen_unordered_map {
+private:
+    std::vector<std::pair<Key, Value>> items;
+    std::vector<std::uint32_t> offsets;
+    unsigned bits = 0;
+    Hash hasher;
+
+    std::size_t index_for(std::size_t hash) const {
+        const std::uint64_t mixed = static_cast<std::uint64_t>(hash) * 0x9E3779B97F4A7C15ull;
+        return bits == 0 ? 0 : static_cast<std::size_t>(mixed >> (64 - bits));
+    }
+
+    template<typename K>
+    const Value* find_impl(const K& key) const {
+        const std::size_t index = index_for(hasher(key));
+        const std::pair<Key, Value>* const end = items.data() + offsets[index + 1];
+        for (const std::pair<Key, Value>* it = items.data() + offsets[index]; it != end; ++it) {
+            if (it->first == key) {
+                return &it->second;
+            }
+        }
+        return nullptr;
+    }
+
+public:
+    // 用一组key互不相同的元素构造，用计数排序把元素按桶的下标排好，时间复杂度O(n)
+    explicit frozen_unordered_map(std::vector<std::pair<Key, Value>> source, const Hash& hasher_ = Hash())
+        : hasher(hasher_) {
+        while ((std::size_t(1) << bits) < source.size()) {
+            ++bits;
+        }
+        const std::size_t bucket_count = std::size_t(1) << bits;
+        std::vector<std::uint32_t> indexes(source.size());
+        offsets.assign(bucket_count + 1, 0);
+        for (std::size_t i = 0; i < source.size(); ++i) {
+            indexes[i] = static_cast<std::uint32_t>(index_for(hasher(source[i].first)));
+            ++offsets[indexes[i] + 1];
+        }
+        for (std::size_t i = 0; i < bucket_count; ++i) {
+            offsets[i + 1] += offsets[i];
+        }
+        // 每个桶下一个元素要放的位置
+        std::vector<std::uint32_t> positions(offsets.begin(), offsets.end() - 1);
+        std::vector<std::optional<std::pair<Key, Value>>> placed(source.size());
+        for (std::size_t i = 0; i < source.size(); ++i) {
+            placed[positions[indexes[i]]++].emplace(std::move(source[i]));
+        }
+        items.reserve(source.size());
+        for (auto& item : placed) {
+            items.push_back(std::move(*item));
+        }
+    }
+
+    // 返回key对应的value的地址，不存在时返回nullptr，地址在这个对象销毁之前一直有效
+    const Value* find(const Key& key) const {
+        return find_impl(key);
+    }
+
+    template<typename K> requires heterogeneous_lookup<Hash, K, Key>
+    const Value* find(const K& key) const {
+        return find_impl(key);
+    }
+
+    Value value_for(const Key& key, const Value& default_value = Value()) const {
+        const Value* value = find_impl(key);
+        return value == nullptr ? default_value : *value;
+    }
+
+    template<typename K> requires heterogeneous_lookup<Hash, K, Key>
+    Value value_for(const K& key, const Value& default_value = Value()) const {
+        const Value* value = find_impl(key);
+        return value == nullptr ? default_value : *value;
+    }
+
+    bool contains(const Key& key) const {
+        return find_impl(key) != nullptr;
+    }
+
+    std::size_t size() const {
+        return items.size();
+    }
+
+    std::size_t bucket_count() const {
+        return offsets.size() - 1;
+    }
+
+    // 按桶的顺序对每个元素调用f(const Key&, const Value&)
+    template<typename Function>
+    void for_each(Function f) const {
+        for (const auto& item : items) {
+            f(item.first, item.second);
+        }
+    }
+};
 
 template<typename Key, typename Value, typename Hash = std::hash<Key>>
 class concurrent_unordered_map {
 private:
+    // key与value都可以按字节复制时，value_for会先尝试不加锁的乐观读
+    static constexpr bool optimistic_reads = std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<Value>;
+    // 乐观读失败这么多次以后，退回到加共享锁的读
+    static constexpr int optimistic_retries = 8;
+
     class bucket_type {
         friend class concurrent_unordered_map;
 
@@ -28,89 +185,1418 @@ private:
         bucket_data data;
         //改用共享锁
         mutable std::shared_mutex mutex;
+        // 扩容时，桶中的数据已经全部迁移到了下一张表中，之后要去下一张表中查找
+        // 只在持有mutex时修改，乐观读时会在不加锁的情况下读取
+        std::atomic<bool> moved{false};
+        // 版本号，写者在修改前后各加一次，所以修改的过程中版本号为奇数
+        // 乐观读的读者在读之前与读之后各读一次版本号，两次相同且为偶数时，读到的数据才是有效的
+        std::atomic<std::uint64_t> version{0};
+        // 开启乐观读时，删除的结点不会马上释放，而是放到这里等待下一次插入时复用
+        // 这样读者即使拿着一个已经被删除的结点，访问的也始终是一个合法的结点，版本号的检查会丢弃读到的数据
+        // 最多保留与链表长度相同的个数，多出来的交给哈希表，等到没有读者可能还拿着它们时再释放（见retire_nodes）
+        bucket_data free_nodes;
+#ifdef CONCURRENT_UNORDERED_MAP_STATS
+        // 加锁的次数，其中需要等待的次数，以及等待的总时间（纳秒）
+        mutable std::atomic<std::uint64_t> lock_count{0};
+        mutable std::atomic<std::uint64_t> contended_count{0};
+        mutable std::atomic<std::uint64_t> wait_ns{0};
+#endif
 
-        bucket_iterator find_entry_for(const Key& key) {
+        // 在修改桶中的数据时创建，析构时结束修改
+        class write_section {
+            bucket_type& bucket;
+        public:
+            explicit write_section(bucket_type& bucket_) : bucket(bucket_) {
+                if constexpr (optimistic_reads) {
+                    bucket.version.store(bucket.version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_release);
+                }
+            }
+            ~write_section() {
+                if constexpr (optimistic_reads) {
+                    bucket.version.store(bucket.version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+                }
+            }
+            write_section(const write_section&) = delete;
+            write_section& operator=(const write_section&) = delete;
+        };
+
+        template<typename K>
+        bucket_iterator find_entry_for(const K& key) {
             return std::find_if(data.begin(), data.end(), [&](const bucket_value& item) {
                 return item.first == key;
             });
         }
+
+        void insert_entry(const Key& key, const Value& value) {
+            if constexpr (optimistic_reads) {
+                if (!free_nodes.empty()) {
+                    data.splice(data.end(), free_nodes, free_nodes.begin());
+                    data.back() = bucket_value(key, value);
+                    return;
+                }
+            }
+            data.push_back(bucket_value(key,value));
+        }
+
+        void erase_entry(bucket_iterator entry) {
+            if constexpr (optimistic_reads) {
+                free_nodes.splice(free_nodes.end(), data, entry);
+            } else {
+                data.erase(entry);
+            }
+        }
     public:
+        // 以下的函数都要求调用者已经持有了mutex
+
         // 查找key值，找到则返回value,否则返回默认值
-        Value value_for(const Key& key, const Value& default_value) {
-            std::shared_lock<std::shared_mutex> guard(mutex);
+        template<typename K>
+        Value value_for(const K& key, const Value& default_value) {
             const bucket_iterator found_entry = find_entry_for(key);
             return (found_entry == data.end()) ? default_value : found_entry->second;
         }
 
+        // 不加锁的查找，只有在optimistic_reads为true时才会使用
+        // 返回false表示读的过程中有写者修改了这个桶（或者正在修改），读到的结果无效
+        // 桶已经迁移走时也返回false，调用者需要重新检查moved
+        template<typename K>
+        bool try_value_for(const K& key, bool& found, Value& result) const {
+            const std::uint64_t before = version.load(std::memory_order_acquire);
+            if ((before & 1) != 0 || moved.load(std::memory_order_acquire)) {
+                return false;
+            }
+            auto validate = [&]() {
+                std::atomic_thread_fence(std::memory_order_acquire);
+                return version.load(std::memory_order_relaxed) == before;
+            };
+            // 每向后走一步之前都要检查版本号，保证拿到的迭代器在那一刻确实是这个链表中的结点
+            // 因为删除的结点不会被释放，所以之后即使结点被删除或者复用，读取它也不会访问到非法的内存
+            const auto end = data.end();
+            auto it = data.begin();
+            if (!validate()) {
+                return false;
+            }
+            while (it != end) {
+                const bucket_value item = *it;
+                const auto next = std::next(it);
+                if (!validate()) {
+                    return false;
+                }
+                if (item.first == key) {
+                    found = true;
+                    result = item.second;
+                    return true;
+                }
+                it = next;
+            }
+            found = false;
+            return true;
+        }
+
         // 添加一个key与value，找到则更新，没找到则添加
-        void add_or_update_mapping(const Key & key, const Value& value) {
-            std::unique_lock<std::shared_mutex> guard(mutex);
+        // 返回是否新增了一个元素
+        bool add_or_update_mapping(const Key & key, const Value& value) {
             const bucket_iterator found_entry = find_entry_for(key);
+            write_section section(*this);
             if (found_entry == data.end()) {
-                data.push_back(bucket_value(key,value));
-            } else {
-                found_entry->second = value;
+                insert_entry(key, value);
+                return true;
             }
+            found_entry->second = value;
+            return false;
         }
 
-        // 删除对应的key
-        void remove_mapping(const Key& key) {
-            std::unique_lock<std::shared_mutex> guard(mutex);
+        // 在原地修改key对应的value，key不存在时先用Value()初始化一个新的value再修改
+        // 返回是否新增了一个元素
+        template<typename Function>
+        bool upsert(const Key& key, Function& f) {
             const bucket_iterator found_entry = find_entry_for(key);
+            if (found_entry == data.end()) {
+                // 先在局部变量上修改，f抛出异常时桶中的数据不会改变
+                Value value{};
+                f(value);
+                write_section section(*this);
+                insert_entry(key, value);
+                return true;
+            }
+            write_section section(*this);
+            f(found_entry->second);
+            return false;
+        }
+
+        // f接收当前的值（key不存在时为std::nullopt），返回新的值（std::nullopt表示删除）
+        // 返回元素个数的变化：1为新增，-1为删除，0为不变
+        template<typename Function>
+        int compute(const Key& key, Function& f, std::optional<Value>& result) {
+            const bucket_iterator found_entry = find_entry_for(key);
+            std::optional<Value> current;
             if (found_entry != data.end()) {
-                data.erase(found_entry);
+                current = found_entry->second;
+            }
+            const bool existed = current.has_value();
+            result = f(std::move(current));
+            if (result) {
+                write_section section(*this);
+                if (existed) {
+                    found_entry->second = *result;
+                    return 0;
+                }
+                insert_entry(key, *result);
+                return 1;
+            }
+            if (existed) {
+                write_section section(*this);
+                erase_entry(found_entry);
+                return -1;
+            }
+            return 0;
+        }
+
+        // 删除对应的key，返回是否真的删除了元素
+        template<typename K>
+        bool remove_mapping(const K& key) {
+            const bucket_iterator found_entry = find_entry_for(key);
+            if (found_entry != data.end()) {
+                write_section section(*this);
+                erase_entry(found_entry);
+                return true;
+            }
+            return false;
+        }
+    };
+
+    // 一张哈希表，桶的数量始终是2的幂
+    // 扩容时会创建一张新的表，旧表通过next指向它，然后一个桶一个桶地把数据迁移过去
+    struct table_type {
+        // 使用vector存储桶的类型
+        std::vector<std::unique_ptr<bucket_type>> buckets;
+        // 桶的数量为 2^bits
+        unsigned bits;
+        // 迁移的目标表，不为空时说明当前表正在被迁移
+        std::atomic<table_type*> next{nullptr};
+        // 下一个要迁移的桶的下标，由各个线程领取
+        std::atomic<std::size_t> migrate_cursor{0};
+        // 已经完成迁移的桶的数量
+        std::atomic<std::size_t> migrated_count{0};
+
+        explicit table_type(unsigned bits_) : buckets(std::size_t(1) << bits_), bits(bits_) {
+            for (auto& bucket : buckets) {
+                bucket.reset(new bucket_type);
             }
         }
+
+        // 斐波那契散列：把哈希值乘以2^64/φ后取最高的bits位作为下标
+        // 这样即使哈希值本身分布不均匀（比如std::hash<int>直接返回原值），也能打散到所有的桶中
+        // 同时，旧表中的第i个桶，在2倍大的新表中只会对应第2i与2i+1个桶
+        std::size_t index_for(std::size_t hash) const {
+            const std::uint64_t mixed = static_cast<std::uint64_t>(hash) * 0x9E3779B97F4A7C15ull;
+            return static_cast<std::size_t>(mixed >> (64 - bits));
+        }
+
+        bucket_type& bucket_for(std::size_t hash) const {
+            return *buckets[index_for(hash)];
+        }
+    };
+
+    // 每一个线程在计数器中对应的槽位，线程第一次修改元素个数时分配
+    static std::size_t thread_ticket() {
+        static std::atomic<std::size_t> next_ticket{0};
+        thread_local const std::size_t ticket = next_ticket.fetch_add(1, std::memory_order_relaxed);
+        return ticket;
+    }
+
+    // 分散的计数器，每个槽位独占一个缓存行，不同的线程修改不同的槽位
+    struct alignas(64) counter_slot {
+        std::atomic<long long> value{0};
+    };
+    static constexpr std::size_t counter_slot_count = 16;
+
+    // 乐观读的读者登记在自己线程对应的槽位中，与元素个数的计数器一样，不同的线程写不同的缓存行
+    // 读者在开始前把自己计入当前epoch（按奇偶分成两个计数器），结束后减掉
+    struct alignas(64) reader_slot {
+        std::atomic<long long> active[2] = {0, 0};
     };
 
-    // 使用vector存储桶的类型
-    std::vector<std::unique_ptr<bucket_type>> buckets;
+    // 等待释放的结点，按线程分成多个分片，每个分片按结点被放入时的epoch分批
+    // 使用std::list，每一批的头结点的地址在释放之前不会改变
+    struct alignas(64) retire_shard {
+        std::mutex mutex;
+        std::list<std::pair<std::uint64_t, typename bucket_type::bucket_data>> batches;
+        std::size_t since_reclaim = 0;
+    };
+
+    // 每次操作最多帮忙迁移的桶的个数
+    static constexpr std::size_t migrate_batch = 4;
+    // 每个分片每放入这么多个等待释放的结点，尝试前进一次epoch并释放已经安全的结点
+    static constexpr std::size_t reclaim_interval = 64;
+
+    // 所有创建过的表，旧表在迁移完成以后仍然保留，因为其他线程可能还持有旧表的指针
+    // 旧表的桶已经是空的，所有旧表的桶的总数不会超过当前表的桶的数量
+    std::vector<std::unique_ptr<table_type>> tables;
+    // 查找时的起点：如果正在扩容，则为旧表，否则为最新的表
+    std::atomic<table_type*> root;
+    // 创建新表时使用的锁，只有在扩容开始时才会用到
+    mutable std::mutex resize_mutex;
     // hash<key> 哈希表，用于根据key生成哈希值
     Hash hasher;
+    // 元素的个数
+    counter_slot element_count[counter_slot_count];
+    // 平均每个桶中的元素个数超过这个值时扩容
+    std::atomic<float> max_load_factor_{1.0f};
+    // 乐观读的读者，以及等待释放的结点（见retire_nodes）
+    mutable reader_slot readers[counter_slot_count];
+    std::atomic<std::uint64_t> reclaim_epoch{0};
+    mutable retire_shard retired[counter_slot_count];
 
-    bucket_type& get_bucket(const Key& key) const {
-        // 计算一个散列值
-        const std::size_t bucket_index = hasher(key) % buckets.size();
-        return *(buckets[bucket_index]);
+    static unsigned bits_for(std::size_t num_buckets) {
+        unsigned bits = 1;
+        while ((std::size_t(1) << bits) < num_buckets) {
+            ++bits;
+        }
+        return bits;
     }
-public:
-    // 桶的大小尽量要使用一个质数。如果不是质数，可能会导致更大概率的哈希冲突
-    concurrent_unordered_map(unsigned num_buckets = 19, const Hash & hasher_ = Hash()):buckets(num_buckets), hasher(hasher_) {
-        // 表示大小最好用unsigned
-        for (unsigned i = 0; i < num_buckets; i ++) {
-            buckets[i].reset(new bucket_type);
+
+    // 修改当前线程对应的计数器，返回这个槽位修改后的值
+    long long add_to_size(long long delta) {
+        return element_count[thread_ticket() % counter_slot_count].value.fetch_add(delta, std::memory_order_relaxed) + delta;
+    }
+
+    // 给桶加锁，Lock为std::unique_lock或std::shared_lock
+    // 开启统计时，先尝试不等待地加锁，失败以后才计时并等待
+    template<typename Lock>
+    static Lock lock_of(const bucket_type& bucket) {
+#ifdef CONCURRENT_UNORDERED_MAP_STATS
+        Lock guard(bucket.mutex, std::try_to_lock);
+        bucket.lock_count.fetch_add(1, std::memory_order_relaxed);
+        if (!guard.owns_lock()) {
+            const auto start = std::chrono::steady_clock::now();
+            guard.lock();
+            const auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+            bucket.contended_count.fetch_add(1, std::memory_order_relaxed);
+            bucket.wait_ns.fetch_add(static_cast<std::uint64_t>(waited.count()), std::memory_order_relaxed);
+        }
+        return guard;
+#else
+        return Lock(bucket.mutex);
+#endif
+    }
+
+    // 找到key所在的桶并加锁，Lock为std::unique_lock或std::shared_lock
+    // 如果桶已经迁移走了，则去下一张表中查找
+    template<typename Lock>
+    bucket_type& lock_bucket(std::size_t hash, Lock& guard) {
+        table_type* table = root.load(std::memory_order_acquire);
+        while (true) {
+            bucket_type& bucket = table->bucket_for(hash);
+            guard = lock_of<Lock>(bucket);
+            if (!bucket.moved.load(std::memory_order_relaxed)) {
+                return bucket;
+            }
+            guard.unlock();
+            table = table->next.load(std::memory_order_acquire);
+        }
+    }
+
+    class read_guard {
+        std::atomic<long long>* counter;
+    public:
+        explicit read_guard(const concurrent_unordered_map& map) {
+            reader_slot& slot = map.readers[thread_ticket() % counter_slot_count];
+            while (true) {
+                const std::uint64_t epoch = map.reclaim_epoch.load();
+                counter = &slot.active[epoch & 1];
+                counter->fetch_add(1);
+                // 计入以后epoch没有变化，回收的一方才一定能看到这个读者
+                if (map.reclaim_epoch.load() == epoch) {
+                    return;
+                }
+                counter->fetch_sub(1, std::memory_order_release);
+            }
+        }
+        ~read_guard() {
+            counter->fetch_sub(1, std::memory_order_release);
+        }
+        read_guard(const read_guard&) = delete;
+        read_guard& operator=(const read_guard&) = delete;
+    };
+
+    // 上一个epoch的读者都已经结束时，把epoch加一，返回当前的epoch
+    std::uint64_t try_advance_epoch() {
+        std::uint64_t epoch = reclaim_epoch.load();
+        const std::size_t previous = static_cast<std::size_t>((epoch + 1) & 1);
+        for (const reader_slot& slot : readers) {
+            if (slot.active[previous].load() != 0) {
+                return epoch;
+            }
         }
+        // 失败时其他线程已经前进了epoch，epoch被更新为新的值
+        if (reclaim_epoch.compare_exchange_strong(epoch, epoch + 1)) {
+            ++epoch;
+        }
+        return epoch;
+    }
+
+    // 把from中的前count个空闲结点放入等待释放的列表，调用者持有from所在的桶的锁
+    // 结点在epoch为e时放入，只有上一个epoch的读者都结束以后epoch才能前进，
+    // 所以epoch到达e+2时，可能拿着这些结点的读者都已经结束，这时才释放它们
+    void retire_nodes(typename bucket_type::bucket_data& from, std::size_t count) {
+        retire_shard& shard = retired[thread_ticket() % counter_slot_count];
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        const std::uint64_t epoch = reclaim_epoch.load();
+        if (shard.batches.empty() || shard.batches.back().first != epoch) {
+            shard.batches.emplace_back(epoch, typename bucket_type::bucket_data());
+        }
+        // 直接移动到批次中，不经过临时的链表：读者可能会沿着已删除的结点走到链表的头结点
+        auto& nodes = shard.batches.back().second;
+        nodes.splice(nodes.end(), from, from.begin(), std::next(from.begin(), static_cast<std::ptrdiff_t>(count)));
+        shard.since_reclaim += count;
+        if (shard.since_reclaim < reclaim_interval) {
+            return;
+        }
+        shard.since_reclaim = 0;
+        const std::uint64_t current = try_advance_epoch();
+        while (!shard.batches.empty() && shard.batches.front().first + 2 <= current) {
+            shard.batches.pop_front();
+        }
+    }
+
+    // 删除结点以后调用，调用者持有bucket的锁：空闲的结点最多保留与链表中的结点相同的个数
+    void trim_free_nodes(bucket_type& bucket) {
+        if constexpr (optimistic_reads) {
+            if (bucket.free_nodes.size() > bucket.data.size()) {
+                retire_nodes(bucket.free_nodes, bucket.free_nodes.size() - bucket.data.size());
+            }
+        }
+    }
+
+    // 把from中下标为index的桶中的数据迁移到下一张表中
+    void migrate_bucket(table_type* from, std::size_t index) {
+        table_type* to = from->next.load(std::memory_order_acquire);
+        bucket_type& source = *from->buckets[index];
+        std::unique_lock<std::shared_mutex> guard = lock_of<std::unique_lock<std::shared_mutex>>(source);
+        typename bucket_type::write_section section(source);
+        // 在source被标记为moved之前，其他线程不会访问它在新表中对应的桶，所以这里不用给新表中的桶加锁
+        // 使用splice直接移动链表结点，不会重新分配内存
+        while (!source.data.empty()) {
+            bucket_type& target = to->bucket_for(hasher(source.data.front().first));
+            target.data.splice(target.data.end(), source.data, source.data.begin());
+        }
+        // 等待复用的结点不交给新表（都放到一个桶中也很难再被复用），而是等待释放
+        if (!source.free_nodes.empty()) {
+            retire_nodes(source.free_nodes, source.free_nodes.size());
+        }
+        source.moved.store(true, std::memory_order_release);
+    }
+
+    // 领取并迁移若干个桶，全部迁移完成以后，把查找的起点移动到新表
+    void migrate_some(table_type* table, std::size_t max_count) {
+        const std::size_t bucket_count = table->buckets.size();
+        for (std::size_t i = 0; i < max_count; ++i) {
+            if (table->migrate_cursor.load(std::memory_order_relaxed) >= bucket_count) {
+                return;
+            }
+            const std::size_t index = table->migrate_cursor.fetch_add(1, std::memory_order_relaxed);
+            if (index >= bucket_count) {
+                return;
+            }
+            migrate_bucket(table, index);
+            if (table->migrated_count.fetch_add(1, std::memory_order_acq_rel) + 1 == bucket_count) {
+                root.store(table->next.load(std::memory_order_acquire), std::memory_order_release);
+            }
+        }
+    }
+
+    // 每一次操作都顺便帮忙迁移几个桶，这样扩容不需要暂停其他线程
+    void help_resize() {
+        table_type* table = root.load(std::memory_order_acquire);
+        if (table->next.load(std::memory_order_acquire) != nullptr) {
+            migrate_some(table, migrate_batch);
+        }
+    }
+
+    // 开始一次扩容，把桶的数量扩大到至少num_buckets个
+    // 如果已经有扩容正在进行，或者桶的数量已经足够，则什么都不做
+    void start_resize(std::size_t num_buckets) {
+        std::lock_guard<std::mutex> guard(resize_mutex);
+        table_type* table = root.load(std::memory_order_acquire);
+        if (table->next.load(std::memory_order_acquire) != nullptr || table->buckets.size() >= num_buckets) {
+            return;
+        }
+        tables.emplace_back(new table_type(bits_for(num_buckets)));
+        table->next.store(tables.back().get(), std::memory_order_release);
+    }
+
+    // 插入新元素以后检查负载因子
+    // 为了不在每次插入时都去累加所有的计数器，只有当前桶的链表较长或者计数器的槽位每走过32步时才检查
+    void check_load(std::size_t chain_length, long long slot_value) {
+        const float max_lf = max_load_factor_.load(std::memory_order_relaxed);
+        if (static_cast<float>(chain_length) <= 2 * max_lf && slot_value % 32 != 0) {
+            return;
+        }
+        table_type* table = root.load(std::memory_order_acquire);
+        if (table->next.load(std::memory_order_acquire) != nullptr) {
+            return;
+        }
+        if (static_cast<float>(size()) > max_lf * static_cast<float>(table->buckets.size())) {
+            start_resize(table->buckets.size() * 2);
+        }
+    }
+    // 不加锁地查找，成功时返回true
+    // 不会写任何共享的缓存行，所以很多线程同时读同一个桶时不会互相影响
+    template<typename K>
+    bool optimistic_value_for(std::size_t hash, const K& key, const Value& default_value, Value& result) const {
+        table_type* table = root.load(std::memory_order_acquire);
+        for (int attempt = 0; attempt < optimistic_retries; ++attempt) {
+            const bucket_type& bucket = table->bucket_for(hash);
+            bool found = false;
+            if (bucket.try_value_for(key, found, result)) {
+                if (!found) {
+                    result = default_value;
+                }
+                return true;
+            }
+            // 桶已经迁移走了，去下一张表中查找，这不算作一次失败
+            if (bucket.moved.load(std::memory_order_acquire)) {
+                table = table->next.load(std::memory_order_acquire);
+                --attempt;
+            }
+        }
+        return false;
+    }
+
+    template<typename K>
+    Value value_for_impl(const K& key, const Value& default_value) {
+        help_resize();
+        const std::size_t hash = hasher(key);
+        if constexpr (optimistic_reads) {
+            Value result = default_value;
+            read_guard reader(*this);
+            if (optimistic_value_for(hash, key, default_value, result)) {
+                return result;
+            }
+        }
+        std::shared_lock<std::shared_mutex> guard;
+        return lock_bucket(hash, guard).value_for(key, default_value);
+    }
+
+    template<typename K, typename Function>
+    bool visit_impl(const K& key, Function& f) {
+        help_resize();
+        std::shared_lock<std::shared_mutex> guard;
+        bucket_type& bucket = lock_bucket(hasher(key), guard);
+        const auto found_entry = bucket.find_entry_for(key);
+        if (found_entry == bucket.data.end()) {
+            return false;
+        }
+        f(std::as_const(found_entry->second));
+        return true;
+    }
+
+    // 把一批key按照它们在table中的桶分组
+    struct batch_plan {
+        static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+        // 每个key的桶的下标
+        std::vector<std::size_t> index;
+        // 每一组的第一个key的位置，按第一次出现的顺序排列
+        std::vector<std::size_t> heads;
+        // 同一组中下一个key的位置（位置从小到大），npos表示结束
+        std::vector<std::size_t> next;
+    };
+
+    // 不排序，而是用一张临时的开放寻址表把桶的下标相同的key串在一起，只需要O(n)的时间
+    // 一批中大多数key都落在不同的桶中时，排序的开销比加锁本身还大
+    batch_plan plan_batch(table_type* table, const std::vector<std::size_t>& hashes) const {
+        const std::size_t count = hashes.size();
+        batch_plan plan;
+        plan.index.resize(count);
+        plan.next.assign(count, batch_plan::npos);
+        // 每个槽位保存一组的(第一个key的位置 + 1, 最后一个key的位置)，0表示空槽位
+        const std::size_t slot_count = std::bit_ceil(count * 2 + 1);
+        std::vector<std::pair<std::size_t, std::size_t>> slots(slot_count, {0, 0});
+        for (std::size_t i = 0; i < count; ++i) {
+            const std::size_t index = table->index_for(hashes[i]);
+            plan.index[i] = index;
+            std::size_t slot = (index * 0x9E3779B97F4A7C15ull) & (slot_count - 1);
+            while (slots[slot].first != 0 && plan.index[slots[slot].first - 1] != index) {
+                slot = (slot + 1) & (slot_count - 1);
+            }
+            if (slots[slot].first == 0) {
+                slots[slot] = {i + 1, i};
+                plan.heads.push_back(i);
+            } else {
+                plan.next[slots[slot].second] = i;
+                slots[slot].second = i;
+            }
+        }
+        return plan;
+    }
+
+    // 处理第i个桶之前，预取后面的桶要用到的内存
+    // 一个桶要依次访问桶的指针、桶本身（锁与链表头）与第一个结点，每一步都依赖上一步的结果，
+    // 所以分成三级流水：预取第i+3d个桶的指针，第i+2d个桶本身，第i+d个桶的第一个结点
+    // 这样同时有多个桶的内存访问在进行，而不是每个key都要依次等待几次内存
+    template<typename Indexes>
+    void prefetch_batch(table_type* table, const Indexes& indexes, std::size_t i) const {
+#if defined(__GNUC__)
+        constexpr std::size_t distance = 4;
+        if (i + 3 * distance < indexes.size()) {
+            __builtin_prefetch(&table->buckets[indexes[i + 3 * distance]]);
+        }
+        if (i + 2 * distance < indexes.size()) {
+            __builtin_prefetch(table->buckets[indexes[i + 2 * distance]].get());
+        }
+        if constexpr (optimistic_reads) {
+            // 乐观读本来就会不加锁地读取链表，所以这里也可以不加锁地预取第一个结点
+            if (i + distance < indexes.size()) {
+                const bucket_type& bucket = *table->buckets[indexes[i + distance]];
+                if (!bucket.data.empty()) {
+                    __builtin_prefetch(&bucket.data.front());
+                }
+            }
+        }
+#endif
+    }
+
+    // 依次处理每一组，每个桶只加一次锁，在持有锁时依次调用locked(bucket, position)处理这个桶中的所有key
+    // 同一时刻只持有一把锁，所以不会死锁；同一个桶中的key按它们在批次中的顺序处理
+    // 桶已经迁移走时，这个桶中的key交给moved(position)逐个处理
+    template<typename Lock, typename Locked, typename Moved>
+    void lock_batch(table_type* table, const batch_plan& plan, Locked locked, Moved moved) {
+        std::vector<std::size_t> group_indexes(plan.heads.size());
+        for (std::size_t g = 0; g < plan.heads.size(); ++g) {
+            group_indexes[g] = plan.index[plan.heads[g]];
+        }
+        for (std::size_t g = 0; g < plan.heads.size(); ++g) {
+            prefetch_batch(table, group_indexes, g);
+            bucket_type& bucket = *table->buckets[group_indexes[g]];
+            Lock guard = lock_of<Lock>(bucket);
+            if (bucket.moved.load(std::memory_order_relaxed)) {
+                guard.unlock();
+                for (std::size_t i = plan.heads[g]; i != batch_plan::npos; i = plan.next[i]) {
+                    moved(i);
+                }
+                continue;
+            }
+            for (std::size_t i = plan.heads[g]; i != batch_plan::npos; i = plan.next[i]) {
+                locked(bucket, i);
+            }
+        }
+    }
+
+    // 遍历table中下标为index的桶，每次只持有一个桶的共享锁
+    // 如果桶已经迁移走了，就去遍历它在下一张表中对应的那几个桶（下一张表也可能正在被迁移，所以是递归的）
+    // 旧表中的第i个桶只会被迁移到新表中的[i << d, (i + 1) << d)，所以每个元素只会被访问一次
+    template<typename Function>
+    void visit_bucket(table_type* table, std::size_t index, Function& f) const {
+        const bucket_type& bucket = *table->buckets[index];
+        {
+            std::shared_lock<std::shared_mutex> guard = lock_of<std::shared_lock<std::shared_mutex>>(bucket);
+            if (!bucket.moved.load(std::memory_order_relaxed)) {
+                for (const auto& item : bucket.data) {
+                    f(item.first, item.second);
+                }
+                return;
+            }
+        }
+        table_type* next = table->next.load(std::memory_order_acquire);
+        const unsigned shift = next->bits - table->bits;
+        for (std::size_t i = index << shift; i < ((index + 1) << shift); ++i) {
+            visit_bucket(next, i, f);
+        }
+    }
+
+    // 与visit_bucket相同的顺序，累加链表与空闲链表中的结点数
+    void count_nodes(table_type* table, std::size_t index, std::size_t& nodes) const {
+        const bucket_type& bucket = *table->buckets[index];
+        {
+            std::shared_lock<std::shared_mutex> guard(bucket.mutex);
+            if (!bucket.moved.load(std::memory_order_relaxed)) {
+                nodes += bucket.data.size() + bucket.free_nodes.size();
+                return;
+            }
+        }
+        table_type* next = table->next.load(std::memory_order_acquire);
+        const unsigned shift = next->bits - table->bits;
+        for (std::size_t i = index << shift; i < ((index + 1) << shift); ++i) {
+            count_nodes(next, i, nodes);
+        }
+    }
+
+    // 没有指定执行器时使用：每个任务一个新的线程
+    struct async_executor {
+        template<typename Function>
+        std::future<void> commit(Function f) {
+            return std::async(std::launch::async, std::move(f));
+        }
+    };
+
+    // 把task_count个任务task(i)交给执行器，第0个任务由当前线程执行，然后等待所有的任务完成
+    // 执行器只需要提供commit(f)并返回一个future，比如thread_pool_v1::thread_pool
+    // 如果执行器是一个线程池，不要在它的工作线程中调用，否则所有的工作线程都在等待时会死锁
+    template<typename Executor, typename Task>
+    static void run_tasks(Executor& executor, std::size_t task_count, Task& task) {
+        using future_type = decltype(executor.commit(std::function<void()>()));
+        std::vector<future_type> futures;
+        futures.reserve(task_count);
+        // 已经提交的任务引用着task以及调用者栈上的状态，所以不论是commit、task(0)还是某个future.get()抛出异常，
+        // 都要先等待所有已经提交的任务结束才能离开（线程池的future析构时不会等待）
+        struct wait_all_guard {
+            std::vector<future_type>& futures;
+            ~wait_all_guard() {
+                for (auto& future : futures) {
+                    if (future.valid()) {
+                        future.wait();
+                    }
+                }
+            }
+        } guard{futures};
+        for (std::size_t i = 1; i < task_count; ++i) {
+            futures.push_back(executor.commit(std::function<void()>([&task, i]() { task(i); })));
+        }
+        task(0);
+        for (auto& future : futures) {
+            future.get();
+        }
+    }
+
+    // 把当前表中的桶平均分成task_count段，并行地对第i段中的每个元素调用f(i, key, value)
+    template<typename Executor, typename Function>
+    void for_each_range(Executor& executor, std::size_t task_count, Function& f) const {
+        table_type* table = root.load(std::memory_order_acquire);
+        const std::size_t bucket_count = table->buckets.size();
+        task_count = std::clamp<std::size_t>(task_count, 1, bucket_count);
+        const std::size_t per_task = (bucket_count + task_count - 1) / task_count;
+        auto task = [&](std::size_t i) {
+            auto visit = [&f, i](const Key& key, const Value& value) {
+                f(i, key, value);
+            };
+            for (std::size_t index = i * per_task; index < std::min((i + 1) * per_task, bucket_count); ++index) {
+                visit_bucket(table, index, visit);
+            }
+        };
+        run_tasks(executor, task_count, task);
+    }
+
+    template<typename K>
+    void remove_mapping_impl(const K& key) {
+        help_resize();
+        std::unique_lock<std::shared_mutex> guard;
+        bucket_type& bucket = lock_bucket(hasher(key), guard);
+        if (bucket.remove_mapping(key)) {
+            trim_free_nodes(bucket);
+            guard.unlock();
+            add_to_size(-1);
+        }
+    }
+public:
+    // 桶的数量会向上取整为2的幂，配合斐波那契散列，不需要再使用质数作为桶的数量
+    // 元素变多以后会自动扩容，num_buckets只是初始的桶的数量
+    concurrent_unordered_map(unsigned num_buckets = 19, const Hash & hasher_ = Hash()): hasher(hasher_) {
+        tables.emplace_back(new table_type(bits_for(num_buckets)));
+        root.store(tables.back().get(), std::memory_order_release);
     }
 
     concurrent_unordered_map(const concurrent_unordered_map& other) = delete;
     concurrent_unordered_map& operator=(const concurrent_unordered_map& other) = delete;
 
     Value value_for(const Key& key, const Value& default_value = Value()) {
-        return get_bucket(key).value_for(key, default_value);
+        return value_for_impl(key, default_value);
+    }
+
+    template<typename K> requires heterogeneous_lookup<Hash, K, Key>
+    Value value_for(const K& key, const Value& default_value = Value()) {
+        return value_for_impl(key, default_value);
+    }
+
+    // 在共享锁下对key对应的value调用f(const Value&)，不需要把value复制出来
+    // 返回key是否存在。f中不能再访问这个哈希表
+    template<typename Function>
+    bool visit(const Key& key, Function f) {
+        return visit_impl(key, f);
+    }
+
+    template<typename K, typename Function> requires heterogeneous_lookup<Hash, K, Key>
+    bool visit(const K& key, Function f) {
+        return visit_impl(key, f);
     }
 
     void add_or_update_mapping(const Key&key, const Value& value) {
-        return get_bucket(key).add_or_update_mapping(key, value);
+        help_resize();
+        std::unique_lock<std::shared_mutex> guard;
+        bucket_type& bucket = lock_bucket(hasher(key), guard);
+        if (bucket.add_or_update_mapping(key, value)) {
+            const std::size_t chain_length = bucket.data.size();
+            guard.unlock();
+            check_load(chain_length, add_to_size(1));
+        }
+    }
+
+    // 只加一次写锁，在原地修改key对应的value：f(Value&)
+    // key不存在时，先用Value()初始化，再调用f，然后插入。返回是否新增了元素
+    // 例如统计单词出现的次数：map.upsert(word, [](int& count) { ++count; });
+    template<typename Function>
+    bool upsert(const Key& key, Function f) {
+        help_resize();
+        std::unique_lock<std::shared_mutex> guard;
+        bucket_type& bucket = lock_bucket(hasher(key), guard);
+        if (bucket.upsert(key, f)) {
+            const std::size_t chain_length = bucket.data.size();
+            guard.unlock();
+            check_load(chain_length, add_to_size(1));
+            return true;
+        }
+        return false;
+    }
+
+    // 只加一次写锁，根据当前的值计算新的值：f(std::optional<Value>) -> std::optional<Value>
+    // key不存在时f收到std::nullopt；f返回std::nullopt时删除这个key。返回计算后的值
+    template<typename Function>
+    std::optional<Value> compute(const Key& key, Function f) {
+        help_resize();
+        std::unique_lock<std::shared_mutex> guard;
+        bucket_type& bucket = lock_bucket(hasher(key), guard);
+        std::optional<Value> result;
+        const int delta = bucket.compute(key, f, result);
+        if (delta < 0) {
+            trim_free_nodes(bucket);
+        }
+        const std::size_t chain_length = bucket.data.size();
+        guard.unlock();
+        if (delta > 0) {
+            check_load(chain_length, add_to_size(1));
+        } else if (delta < 0) {
+            add_to_size(-1);
+        }
+        return result;
     }
 
     void remove_mapping(const Key& key) {
-        return get_bucket(key).remove_mapping(key);
+        remove_mapping_impl(key);
+    }
+
+    template<typename K> requires heterogeneous_lookup<Hash, K, Key>
+    void remove_mapping(const K& key) {
+        remove_mapping_impl(key);
+    }
+
+    // transact传给f的视图，只能访问调用transact时声明过的key
+    // 修改先记录在视图中，f正常返回以后才一起写入哈希表；f抛出异常时不会有任何修改
+    class transaction {
+        friend class concurrent_unordered_map;
+
+    private:
+        struct slot {
+            Key key;
+            std::size_t hash;
+            bool writable;
+            // 加锁以后key所在的桶
+            bucket_type* bucket = nullptr;
+            // 当前的值（包括视图中的修改），std::nullopt表示不存在
+            std::optional<Value> value;
+            bool dirty = false;
+        };
+        std::vector<slot> slots;
+
+        std::size_t index_of(const Key& key) const {
+            for (std::size_t i = 0; i < slots.size(); ++i) {
+                if (slots[i].key == key) {
+                    return i;
+                }
+            }
+            throw std::out_of_range("transact: key没有在调用时声明");
+        }
+
+        const slot& slot_for(const Key& key) const {
+            return slots[index_of(key)];
+        }
+
+        slot& writable_slot_for(const Key& key) {
+            slot& s = slots[index_of(key)];
+            if (!s.writable) {
+                throw std::logic_error("transact: 不能修改只读的key");
+            }
+            return s;
+        }
+
+    public:
+        std::optional<Value> get(const Key& key) const {
+            return slot_for(key).value;
+        }
+
+        Value value_for(const Key& key, const Value& default_value = Value()) const {
+            const slot& s = slot_for(key);
+            return s.value ? *s.value : default_value;
+        }
+
+        bool contains(const Key& key) const {
+            return slot_for(key).value.has_value();
+        }
+
+        void set(const Key& key, const Value& value) {
+            slot& s = writable_slot_for(key);
+            s.value = value;
+            s.dirty = true;
+        }
+
+        void erase(const Key& key) {
+            slot& s = writable_slot_for(key);
+            s.value.reset();
+            s.dirty = true;
+        }
+    };
+
+    // 原子地读写多个key：对write_keys所在的桶加独占锁，只出现在read_keys中的桶加共享锁，然后调用f(transaction&)
+    // 所有的桶按照(所在的表的大小, 下标)的顺序加锁，旧表在新表之前，与get_map的顺序一致，所以多个事务之间不会死锁
+    // 涉及的桶不同的事务可以同时进行。加锁以后如果发现某个桶已经被迁移走了，就全部解锁并重新查找
+    // 按值返回f的返回值（f返回引用时也会复制一份，锁释放以后引用可能已经失效）。f中不能再访问这个哈希表
+    template<typename Function>
+    auto transact(const std::vector<Key>& write_keys, const std::vector<Key>& read_keys, Function f) {
+        help_resize();
+        transaction view;
+        auto declare = [&view, this](const Key& key, bool writable) {
+            for (auto& s : view.slots) {
+                if (s.key == key) {
+                    s.writable = s.writable || writable;
+                    return;
+                }
+            }
+            view.slots.push_back(typename transaction::slot{key, hasher(key), writable, nullptr, std::nullopt, false});
+        };
+        for (const Key& key : write_keys) {
+            declare(key, true);
+        }
+        for (const Key& key : read_keys) {
+            declare(key, false);
+        }
+
+        struct lock_target {
+            bucket_type* bucket;
+            unsigned bits;
+            std::size_t index;
+            bool exclusive;
+        };
+        std::vector<lock_target> targets;
+        std::vector<std::unique_lock<std::shared_mutex>> exclusive_locks;
+        std::vector<std::shared_lock<std::shared_mutex>> shared_locks;
+        while (true) {
+            // 不加锁地找到每个key当前所在的桶：沿着已经迁移走的桶一直找到还没有迁移的桶
+            targets.clear();
+            table_type* const start = root.load(std::memory_order_acquire);
+            for (auto& s : view.slots) {
+                table_type* table = start;
+                std::size_t index = table->index_for(s.hash);
+                while (table->buckets[index]->moved.load(std::memory_order_acquire)) {
+                    table = table->next.load(std::memory_order_acquire);
+                    index = table->index_for(s.hash);
+                }
+                s.bucket = table->buckets[index].get();
+                targets.push_back({s.bucket, table->bits, index, s.writable});
+            }
+            std::sort(targets.begin(), targets.end(), [](const lock_target& a, const lock_target& b) {
+                return a.bits != b.bits ? a.bits < b.bits : a.index < b.index;
+            });
+            // 同一个桶只加一次锁，其中有一个key需要修改时加独占锁
+            std::size_t unique_count = 0;
+            for (const lock_target& target : targets) {
+                if (unique_count != 0 && targets[unique_count - 1].bucket == target.bucket) {
+                    targets[unique_count - 1].exclusive = targets[unique_count - 1].exclusive || target.exclusive;
+                } else {
+                    targets[unique_count++] = target;
+                }
+            }
+            targets.resize(unique_count);
+
+            bool valid = true;
+            for (const lock_target& target : targets) {
+                if (target.exclusive) {
+                    exclusive_locks.push_back(lock_of<std::unique_lock<std::shared_mutex>>(*target.bucket));
+                } else {
+                    shared_locks.push_back(lock_of<std::shared_lock<std::shared_mutex>>(*target.bucket));
+                }
+                // 桶只在持有它的独占锁时被标记为迁移走，所以加锁以后没有迁移走的桶在解锁之前都不会被迁移
+                if (target.bucket->moved.load(std::memory_order_relaxed)) {
+                    valid = false;
+                    break;
+                }
+            }
+            if (valid) {
+                break;
+            }
+            exclusive_locks.clear();
+            shared_locks.clear();
+            std::this_thread::yield();
+        }
+
+        for (auto& s : view.slots) {
+            const auto found = s.bucket->find_entry_for(s.key);
+            if (found != s.bucket->data.end()) {
+                s.value = found->second;
+            }
+        }
+
+        // f正常返回以后，把视图中的修改写入对应的桶，然后解锁，最后更新元素的个数
+        auto commit = [&]() {
+            std::vector<std::pair<std::size_t, int>> changes;
+            for (auto& s : view.slots) {
+                if (!s.dirty) {
+                    continue;
+                }
+                bucket_type& bucket = *s.bucket;
+                const auto found = bucket.find_entry_for(s.key);
+                typename bucket_type::write_section section(bucket);
+                if (s.value) {
+                    if (found != bucket.data.end()) {
+                        found->second = *s.value;
+                    } else {
+                        bucket.insert_entry(s.key, *s.value);
+                        changes.emplace_back(bucket.data.size(), 1);
+                    }
+                } else if (found != bucket.data.end()) {
+                    bucket.erase_entry(found);
+                    trim_free_nodes(bucket);
+                    changes.emplace_back(0, -1);
+                }
+            }
+            exclusive_locks.clear();
+            shared_locks.clear();
+            for (const auto& [chain_length, delta] : changes) {
+                if (delta > 0) {
+                    check_load(chain_length, add_to_size(1));
+                } else {
+                    add_to_size(-1);
+                }
+            }
+        };
+
+        if constexpr (std::is_void_v<std::invoke_result_t<Function&, transaction&>>) {
+            f(view);
+            commit();
+        } else {
+            auto result = f(view);
+            commit();
+            return result;
+        }
+    }
+
+    // 所有的key都可以修改
+    template<typename Function>
+    auto transact(const std::vector<Key>& keys, Function f) {
+        return transact(keys, std::vector<Key>(), std::move(f));
+    }
+
+    // 批量查找，返回的结果与keys一一对应，不存在的key对应default_value
+    // 一次性计算所有的哈希值并按桶分组，每个桶只加一次共享锁，同时预取后面要访问的桶
+    std::vector<Value> multi_get(const std::vector<Key>& keys, const Value& default_value = Value()) {
+        help_resize();
+        std::vector<std::size_t> hashes(keys.size());
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            hashes[i] = hasher(keys[i]);
+        }
+        std::vector<Value> result(keys.size(), default_value);
+        table_type* table = root.load(std::memory_order_acquire);
+        const batch_plan plan = plan_batch(table, hashes);
+        auto lookup_locked = [&](std::size_t position) {
+            result[position] = value_for_impl(keys[position], default_value);
+        };
+        if constexpr (optimistic_reads) {
+            // 不需要加锁，直接按原来的顺序乐观地读，只有读失败的key才加锁
+            read_guard reader(*this);
+            for (std::size_t i = 0; i < keys.size(); ++i) {
+                prefetch_batch(table, plan.index, i);
+                bool found = false;
+                if (table->buckets[plan.index[i]]->try_value_for(keys[i], found, result[i])) {
+                    if (!found) {
+                        result[i] = default_value;
+                    }
+                } else {
+                    lookup_locked(i);
+                }
+            }
+        } else {
+            lock_batch<std::shared_lock<std::shared_mutex>>(table, plan,
+                [&](bucket_type& bucket, std::size_t position) {
+                    result[position] = bucket.value_for(keys[position], default_value);
+                },
+                lookup_locked);
+        }
+        return result;
+    }
+
+    // 批量插入或更新，每个桶只加一次独占锁
+    // 同一个key在items中出现多次时，与依次调用add_or_update_mapping的结果相同（后面的覆盖前面的）
+    void multi_put(const std::vector<std::pair<Key, Value>>& items) {
+        help_resize();
+        std::vector<std::size_t> hashes(items.size());
+        for (std::size_t i = 0; i < items.size(); ++i) {
+            hashes[i] = hasher(items[i].first);
+        }
+        long long inserted = 0;
+        std::size_t max_chain_length = 0;
+        table_type* table = root.load(std::memory_order_acquire);
+        lock_batch<std::unique_lock<std::shared_mutex>>(table, plan_batch(table, hashes),
+            [&](bucket_type& bucket, std::size_t position) {
+                if (bucket.add_or_update_mapping(items[position].first, items[position].second)) {
+                    ++inserted;
+                    max_chain_length = std::max(max_chain_length, bucket.data.size());
+                }
+            },
+            [&](std::size_t position) {
+                add_or_update_mapping(items[position].first, items[position].second);
+            });
+        if (inserted > 0) {
+            const long long slot_value = add_to_size(inserted);
+            // 一次加了多个元素，只要跨过了32的倍数就检查负载因子
+            check_load(max_chain_length, slot_value / 32 != (slot_value - inserted) / 32 ? 0 : slot_value);
+        }
+    }
+
+    // 元素的个数，并发修改时只是一个近似值
+    std::size_t size() const {
+        long long total = 0;
+        for (const auto& slot : element_count) {
+            total += slot.value.load(std::memory_order_relaxed);
+        }
+        return total < 0 ? 0 : static_cast<std::size_t>(total);
+    }
+
+    // 当前（最新的表）的桶的数量
+    std::size_t bucket_count() const {
+        table_type* table = root.load(std::memory_order_acquire);
+        while (table_type* next = table->next.load(std::memory_order_acquire)) {
+            table = next;
+        }
+        return table->buckets.size();
+    }
+
+    // 占用的内存（字节）的近似值：所有的表中的桶，以及链表的结点（包括等待复用与等待释放的结点）
+    // 结点的大小按一个元素加两个指针估算，不包括内存分配器自身的开销
+    std::size_t memory_usage() const {
+        std::size_t buckets = 0;
+        {
+            std::lock_guard<std::mutex> guard(resize_mutex);
+            for (const auto& table : tables) {
+                buckets += table->buckets.size();
+            }
+        }
+        std::size_t nodes = 0;
+        table_type* table = root.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < table->buckets.size(); ++i) {
+            count_nodes(table, i, nodes);
+        }
+        for (retire_shard& shard : retired) {
+            std::lock_guard<std::mutex> guard(shard.mutex);
+            for (const auto& batch : shard.batches) {
+                nodes += batch.second.size();
+            }
+        }
+        return sizeof(*this) + buckets * (sizeof(std::unique_ptr<bucket_type>) + sizeof(bucket_type)) +
+               nodes * (sizeof(std::pair<Key, Value>) + 2 * sizeof(void*));
+    }
+
+    float load_factor() const {
+        return static_cast<float>(size()) / static_cast<float>(bucket_count());
+    }
+
+    float max_load_factor() const {
+        return max_load_factor_.load(std::memory_order_relaxed);
+    }
+
+    void max_load_factor(float ml) {
+        max_load_factor_.store(ml > 0 ? ml : 1.0f, std::memory_order_relaxed);
+    }
+
+    // 预留至少能容纳count个元素的桶，调用者会自己完成整个迁移过程（其他线程也会帮忙）
+    void reserve(std::size_t count) {
+        const auto needed = static_cast<std::size_t>(static_cast<float>(count) / max_load_factor()) + 1;
+        while (true) {
+            table_type* table = root.load(std::memory_order_acquire);
+            if (table->next.load(std::memory_order_acquire) == nullptr) {
+                if (table->buckets.size() >= needed) {
+                    return;
+                }
+                start_resize(needed);
+                continue;
+            }
+            migrate_some(table, table->buckets.size());
+            // 其他线程领取的桶可能还没有迁移完，等待它们完成
+            while (root.load(std::memory_order_acquire) == table) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // 依次对每个元素调用f(const Key&, const Value&)，一个桶一个桶地遍历，同一时刻只持有一个桶的共享锁，
+    // 所以不会阻塞其他桶的读写，也不会阻止扩容
+    // 结果是弱一致的：遍历开始前插入、并且遍历期间没有被删除的元素一定会被访问到，并且只访问一次；
+    // 遍历期间插入或删除的元素可能访问到，也可能访问不到。f中不能再修改这个哈希表
+    template<typename Function>
+    void for_each(Function f) const {
+        table_type* table = root.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < table->buckets.size(); ++i) {
+            visit_bucket(table, i, f);
+        }
+    }
+
+    // 把所有的元素追加到out中，与for_each一样是弱一致的
+    // 与get_map相比不会锁住整个哈希表，也不需要为每个元素分配一个std::map的结点
+    void snapshot_to(std::vector<std::pair<Key, Value>>& out) const {
+        out.reserve(out.size() + size());
+        for_each([&out](const Key& key, const Value& value) {
+            out.emplace_back(key, value);
+        });
+    }
+
+    // 与snapshot_to相同，但是把桶平均分给thread_num个线程（包括当前线程）同时复制，最后再合并
+    std::vector<std::pair<Key, Value>> parallel_snapshot(std::size_t thread_num = std::thread::hardware_concurrency()) const {
+        table_type* table = root.load(std::memory_order_acquire);
+        const std::size_t bucket_count = table->buckets.size();
+        thread_num = std::clamp<std::size_t>(thread_num, 1, bucket_count);
+        const std::size_t per_thread = (bucket_count + thread_num - 1) / thread_num;
+        std::vector<std::vector<std::pair<Key, Value>>> parts(thread_num);
+        auto copy_range = [this, table, per_thread, bucket_count, &parts](std::size_t t) {
+            auto collect = [&parts, t](const Key& key, const Value& value) {
+                parts[t].emplace_back(key, value);
+            };
+            parts[t].reserve(size() / parts.size() + 1);
+            for (std::size_t i = t * per_thread; i < std::min((t + 1) * per_thread, bucket_count); ++i) {
+                visit_bucket(table, i, collect);
+            }
+        };
+        {
+            std::vector<std::jthread> workers;
+            workers.reserve(thread_num - 1);
+            for (std::size_t t = 1; t < thread_num; ++t) {
+                workers.emplace_back(copy_range, t);
+            }
+            // 当前线程处理第一段
+            copy_range(0);
+        }
+        std::vector<std::pair<Key, Value>> result = std::move(parts[0]);
+        std::size_t total = result.size();
+        for (std::size_t t = 1; t < thread_num; ++t) {
+            total += parts[t].size();
+        }
+        result.reserve(total);
+        for (std::size_t t = 1; t < thread_num; ++t) {
+            std::move(parts[t].begin(), parts[t].end(), std::back_inserter(result));
+        }
+        return result;
+    }
+
+    // 并行地插入[first, last)中的所有元素（每个元素有first与second两个成员），与依次调用add_or_update_mapping的结果相同
+    // 先根据元素的个数一次性扩容，然后分两步：
+    //   1. 输入被平均分给各个任务，每个任务计算自己那一段的哈希值，按目标桶所在的区间分到各个分区中
+    //   2. 每个任务负责一个分区，也就是一段连续的桶，所以各个任务插入时不会争抢同一把锁
+    // 同一个分区中的元素按照它们在输入中的顺序插入，所以重复的key以最后一个为准
+    template<std::random_access_iterator Iterator, typename Executor>
+    void bulk_insert(Iterator first, Iterator last, Executor& executor, std::size_t task_count) {
+        const std::size_t count = static_cast<std::size_t>(last - first);
+        if (count == 0) {
+            return;
+        }
+        reserve(size() + count);
+        table_type* table = root.load(std::memory_order_acquire);
+        // 分区的数量取2的幂，这样桶的下标右移就可以得到分区的下标
+        unsigned partition_bits = 0;
+        while ((std::size_t(2) << partition_bits) <= std::min(task_count, table->buckets.size())) {
+            ++partition_bits;
+        }
+        const std::size_t partitions = std::size_t(1) << partition_bits;
+        const unsigned shift = table->bits - partition_bits;
+        const std::size_t per_task = (count + partitions - 1) / partitions;
+
+        // scattered[t][p]：第t段输入中，落在第p个分区的元素的(下标, 哈希值)
+        typedef std::vector<std::pair<std::size_t, std::size_t>> partition_items;
+        std::vector<std::vector<partition_items>> scattered(partitions, std::vector<partition_items>(partitions));
+        auto scatter = [&](std::size_t t) {
+            for (std::size_t i = t * per_task; i < std::min((t + 1) * per_task, count); ++i) {
+                const std::size_t hash = hasher(first[i].first);
+                scattered[t][table->index_for(hash) >> shift].emplace_back(i, hash);
+            }
+        };
+        run_tasks(executor, partitions, scatter);
+
+        std::atomic<long long> inserted{0};
+        auto insert = [&](std::size_t p) {
+            long long local_inserted = 0;
+            for (std::size_t t = 0; t < partitions; ++t) {
+                for (const auto& [i, hash] : scattered[t][p]) {
+                    const auto& item = first[i];
+                    // 一般只会锁住table中的桶；如果这期间其他线程又开始了扩容，会跟着去新表中插入
+                    std::unique_lock<std::shared_mutex> guard;
+                    if (lock_bucket(hash, guard).add_or_update_mapping(item.first, item.second)) {
+                        ++local_inserted;
+                    }
+                }
+            }
+            inserted.fetch_add(local_inserted, std::memory_order_relaxed);
+        };
+        run_tasks(executor, partitions, insert);
+        if (inserted.load() > 0) {
+            add_to_size(inserted.load());
+        }
+    }
+
+    template<std::random_access_iterator Iterator>
+    void bulk_insert(Iterator first, Iterator last, std::size_t thread_num = std::thread::hardware_concurrency()) {
+        async_executor executor;
+        bulk_insert(first, last, executor, thread_num);
+    }
+
+    // 把桶平均分成task_count段，交给执行器并行地对每个元素调用f(const Key&, const Value&)
+    // 每次只持有一个桶的共享锁，与for_each一样是弱一致的；f会被多个线程同时调用
+    template<typename Function, typename Executor>
+    void parallel_for_each(Function f, Executor& executor, std::size_t task_count) const {
+        auto visit = [&f](std::size_t, const Key& key, const Value& value) {
+            f(key, value);
+        };
+        for_each_range(executor, task_count, visit);
+    }
+
+    template<typename Function>
+    void parallel_for_each(Function f, std::size_t thread_num = std::thread::hardware_concurrency()) const {
+        async_executor executor;
+        parallel_for_each(f, executor, thread_num);
+    }
+
+    // 并行的map-reduce：每一段从init开始，对每个元素计算result = reduce(result, transform(key, value))，
+    // 最后再按顺序把各段的结果用reduce合并。init必须是reduce的单位元（比如求和时为0）
+    template<typename T, typename Transform, typename Reduce, typename Executor>
+    T parallel_reduce(T init, Transform transform, Reduce reduce, Executor& executor, std::size_t task_count) const {
+        task_count = std::clamp<std::size_t>(task_count, 1, root.load(std::memory_order_acquire)->buckets.size());
+        std::vector<T> partial(task_count, init);
+        auto accumulate = [&](std::size_t i, const Key& key, const Value& value) {
+            partial[i] = reduce(std::move(partial[i]), transform(key, value));
+        };
+        for_each_range(executor, task_count, accumulate);
+        T result = std::move(partial[0]);
+        for (std::size_t i = 1; i < partial.size(); ++i) {
+            result = reduce(std::move(result), std::move(partial[i]));
+        }
+        return result;
+    }
+
+    template<typename T, typename Transform, typename Reduce>
+    T parallel_reduce(T init, Transform transform, Reduce reduce,
+                      std::size_t thread_num = std::thread::hardware_concurrency()) const {
+        async_executor executor;
+        return parallel_reduce(std::move(init), transform, reduce, executor, thread_num);
+    }
+
+#ifdef CONCURRENT_UNORDERED_MAP_STATS
+    // 收集统计数据：链表长度的分布、加锁的次数与等待的时间，以及等待时间最长的top_k个桶
+    // histogram_size为链表长度分布的项数，读取每个桶的链表长度时会短暂地加共享锁（不计入统计）
+    concurrent_unordered_map_stats stats(std::size_t top_k = 8, std::size_t histogram_size = 16) const {
+        concurrent_unordered_map_stats result;
+        result.size = size();
+        result.bucket_count = bucket_count();
+        result.chain_length_histogram.assign(std::max<std::size_t>(histogram_size, 1), 0);
+        std::vector<concurrent_unordered_map_stats::bucket_stats> buckets;
+        table_type* previous = nullptr;
+        for (table_type* table = root.load(std::memory_order_acquire); table != nullptr;
+             previous = table, table = table->next.load(std::memory_order_acquire)) {
+            for (std::size_t i = 0; i < table->buckets.size(); ++i) {
+                const bucket_type& bucket = *table->buckets[i];
+                concurrent_unordered_map_stats::bucket_stats item;
+                item.table_buckets = table->buckets.size();
+                item.index = i;
+                // 新表中的桶在旧表中对应的桶迁移完成之前，会被迁移的线程不加锁地修改（见migrate_bucket），
+                // 这时不能读它的链表，它的元素已经在旧表的桶中统计过了
+                const bool readable = previous == nullptr ||
+                    previous->buckets[i >> (table->bits - previous->bits)]->moved.load(std::memory_order_acquire);
+                if (readable) {
+                    std::shared_lock<std::shared_mutex> guard(bucket.mutex);
+                    // 已经迁移走的桶是空的，不计入链表长度的分布
+                    if (!bucket.moved.load(std::memory_order_relaxed)) {
+                        item.chain_length = bucket.data.size();
+                        ++result.chain_length_histogram[std::min(item.chain_length, result.chain_length_histogram.size() - 1)];
+                        result.max_chain_length = std::max(result.max_chain_length, item.chain_length);
+                    }
+                }
+                item.lock_count = bucket.lock_count.load(std::memory_order_relaxed);
+                item.contended_count = bucket.contended_count.load(std::memory_order_relaxed);
+                item.lock_wait = std::chrono::nanoseconds(bucket.wait_ns.load(std::memory_order_relaxed));
+                result.lock_count += item.lock_count;
+                result.contended_count += item.contended_count;
+                result.lock_wait += item.lock_wait;
+                if (item.lock_count != 0) {
+                    buckets.push_back(item);
+                }
+            }
+        }
+        const auto hotter = [](const auto& a, const auto& b) {
+            return a.lock_wait != b.lock_wait ? a.lock_wait > b.lock_wait : a.lock_count > b.lock_count;
+        };
+        top_k = std::min(top_k, buckets.size());
+        std::partial_sort(buckets.begin(), buckets.begin() + static_cast<std::ptrdiff_t>(top_k), buckets.end(), hotter);
+        buckets.resize(top_k);
+        result.hot_buckets = std::move(buckets);
+        return result;
+    }
+
+    // 清空所有桶的加锁统计
+    void reset_stats() {
+        for (table_type* table = root.load(std::memory_order_acquire); table != nullptr;
+             table = table->next.load(std::memory_order_acquire)) {
+            for (const auto& bucket : table->buckets) {
+                bucket->lock_count.store(0, std::memory_order_relaxed);
+                bucket->contended_count.store(0, std::memory_order_relaxed);
+                bucket->wait_ns.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+#endif
+
+    // 把当前的内容复制到一个不可修改的frozen_unordered_map中，适合长时间只读的阶段：
+    // 之后的查找不需要加锁，也不需要沿着链表访问分散的结点，返回的对象可以直接被多个线程共享
+    // 与snapshot_to一样是弱一致的，所以应该在没有其他线程修改时调用；之后对这个哈希表的修改不会影响返回的结果
+    std::shared_ptr<const frozen_unordered_map<Key, Value, Hash>> freeze() const {
+        std::vector<std::pair<Key, Value>> items;
+        snapshot_to(items);
+        return std::make_shared<const frozen_unordered_map<Key, Value, Hash>>(std::move(items), hasher);
     }
 
     // 返回当前保存的东西
+    // 为了得到一个一致的结果，会同时锁住所有的桶，期间所有的读写都会被阻塞，定期导出数据时应该使用snapshot_to
     // 一般不推荐，因为通常在读完以后，会马上就发生更改，所以返回的值在很短的时候内就会变成旧值
     std::map<Key, Value> get_map() {
-        std::vector<std::unique_lock<std::shared_mutex>> locks;
-        for (unsigned i = 0; i < buckets.size(); i ++) {
-            locks.push_back(std::unique_lock<std::shared_mutex>(buckets[i]->mutex));
-        }
+        while (true) {
+            table_type* table = root.load(std::memory_order_acquire);
+            std::vector<std::unique_lock<std::shared_mutex>> locks;
+            bool all_moved = true;
+            for (unsigned i = 0; i < table->buckets.size(); i ++) {
+                locks.push_back(lock_of<std::unique_lock<std::shared_mutex>>(*table->buckets[i]));
+                all_moved = all_moved && table->buckets[i]->moved.load(std::memory_order_relaxed);
+            }
+            // 拿到的是已经迁移完成的旧表，重新从新的起点开始
+            if (all_moved) {
+                continue;
+            }
+            // 持有旧表所有的锁时迁移不能继续进行，再锁住新表，就可以得到一个一致的结果
+            table_type* next = table->next.load(std::memory_order_acquire);
+            if (next != nullptr) {
+                for (unsigned i = 0; i < next->buckets.size(); i ++) {
+                    locks.push_back(lock_of<std::unique_lock<std::shared_mutex>>(*next->buckets[i]));
+                }
+            }
 
-        std::map<Key, Value> result;
-        for (unsigned i = 0; i < buckets.size(); i ++) {
-            for (auto it = buckets[i]->data.begin(); it != buckets[i]->data.end(); ++it) {
-                result.insert(*it);
+            std::map<Key, Value> result;
+            for (unsigned i = 0; i < table->buckets.size(); i ++) {
+                if (table->buckets[i]->moved.load(std::memory_order_relaxed)) {
+                    continue;
+                }
+                for (auto it = table->buckets[i]->data.begin(); it != table->buckets[i]->data.end(); ++it) {
+                    result.insert(*it);
+                }
             }
+            if (next != nullptr) {
+                for (unsigned i = 0; i < next->buckets.size(); i ++) {
+                    for (auto it = next->buckets[i]->data.begin(); it != next->buckets[i]->data.end(); ++it) {
+                        result.insert(*it);
+                    }
+                }
+            }
+            return result;
         }
-        return result;
     }
 };
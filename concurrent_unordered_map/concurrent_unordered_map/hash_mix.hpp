@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 把哈希值打散（splitmix64的最后一步），让每一位都充分混合
+// std::hash对整数通常就是恒等函数，只做一次乘法的话，低位只取决于原哈希值的低位；
+// 这里的几个哈希表有的用低位选择桶，有的用高位选择分片、低位作为tag，所以都需要先经过这一步
+inline std::uint64_t concurrent_hash_mix(std::size_t hash) {
+    std::uint64_t x = static_cast<std::uint64_t>(hash);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
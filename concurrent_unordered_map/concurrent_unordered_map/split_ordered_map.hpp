@@ -0,0 +1,467 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "hash_mix.hpp"
+
+// 无锁的哈希表（Shalev–Shavit 的 split-ordered list）
+//
+// 所有的元素都保存在同一个按“位反转后的哈希值”排序的无锁有序链表中
+// 每个桶只是指向链表中一个哨兵结点的指针，桶的数量翻倍时，只需要插入新的哨兵结点，已有的结点不需要移动：
+//   桶b的哨兵结点的排序键为reverse(b)，元素的排序键为reverse(hash)再把最低位置1，
+//   所以桶b中的元素正好排在哨兵结点reverse(b)与下一个哨兵结点之间，
+//   桶的数量从n变成2n时，桶b+n的哨兵结点正好把桶b中的元素一分为二
+//
+// 链表的删除使用Harris-Michael算法（先在next指针上做删除标记，再摘除），
+// 结点的释放使用风险指针（与concurrent_stack_v3的思路相同），所以查找、插入与删除都不会阻塞
+
+// 最多同时使用split_ordered_map的线程数
+const unsigned max_split_ordered_threads = 128;
+// 每个线程需要的风险指针的个数：前一个结点、当前结点、当前结点的值
+const unsigned split_ordered_hazards_per_thread = 3;
+
+struct split_ordered_hazard_record {
+    std::atomic<std::thread::id> m_id;
+    std::atomic<void*> m_pointers[split_ordered_hazards_per_thread];
+};
+
+// 一个全局的风险指针数组，所有的split_ordered_map共用
+inline split_ordered_hazard_record split_ordered_hazard_records[max_split_ordered_threads];
+
+// 线程第一次使用时申请一条记录，线程退出时归还
+class split_ordered_hp_owner {
+public:
+    split_ordered_hp_owner(const split_ordered_hp_owner&) = delete;
+    split_ordered_hp_owner& operator=(const split_ordered_hp_owner&) = delete;
+
+    split_ordered_hp_owner() : m_record(nullptr) {
+        for (unsigned i = 0; i < max_split_ordered_threads; i ++) {
+            std::thread::id old_id;
+            if (split_ordered_hazard_records[i].m_id.compare_exchange_strong(old_id, std::this_thread::get_id())) {
+                m_record = &split_ordered_hazard_records[i];
+                break;
+            }
+        }
+        if (!m_record) {
+            throw std::runtime_error("没有找到空闲的风险指针");
+        }
+    }
+
+    ~split_ordered_hp_owner() {
+        for (auto& pointer : m_record->m_pointers) {
+            pointer.store(nullptr);
+        }
+        m_record->m_id.store(std::thread::id());
+    }
+
+    std::atomic<void*>& get_pointer(unsigned index) {
+        return m_record->m_pointers[index];
+    }
+
+private:
+    split_ordered_hazard_record* m_record;
+};
+
+inline split_ordered_hp_owner& get_split_ordered_hazards_for_current_thread() {
+    thread_local static split_ordered_hp_owner hazards;
+    return hazards;
+}
+
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class split_ordered_map {
+private:
+    // 值单独存放，更新时整体替换，旧的值通过风险指针延迟释放
+    struct value_box {
+        Value m_value;
+        explicit value_box(const Value& value) : m_value(value) {}
+    };
+
+    struct node {
+        // 位反转后的哈希值，哨兵结点的最低位为0，元素结点的最低位为1
+        const std::uint64_t m_so_key;
+        // 最低位是删除标记
+        std::atomic<std::uintptr_t> m_next{0};
+        // 哨兵结点中不使用以下两个成员
+        Key m_key;
+        std::atomic<value_box*> m_value{nullptr};
+
+        explicit node(std::uint64_t so_key) : m_so_key(so_key), m_key() {}
+        node(std::uint64_t so_key, const Key& key, const Value& value)
+            : m_so_key(so_key), m_key(key), m_value(new value_box(value)) {}
+        ~node() {
+            delete m_value.load(std::memory_order_relaxed);
+        }
+        bool is_dummy() const {
+            return (m_so_key & 1) == 0;
+        }
+    };
+
+    // 等待释放的对象，与concurrent_stack_v3一样使用一个无锁的栈来维护
+    struct data_to_reclaim {
+        void* m_data;
+        void (*m_deleter)(void*);
+        data_to_reclaim* m_next;
+    };
+
+    static constexpr std::uintptr_t kMark = 1;
+    // 最多2^kMaxSegments个桶
+    static constexpr unsigned kMaxSegments = 48;
+    // 等待释放的对象超过这个数量时，扫描一次风险指针
+    static constexpr std::size_t kReclaimThreshold = 2 * max_split_ordered_threads * split_ordered_hazards_per_thread;
+
+    static node* pointer_of(std::uintptr_t link) {
+        return reinterpret_cast<node*>(link & ~kMark);
+    }
+    static bool is_marked(std::uintptr_t link) {
+        return (link & kMark) != 0;
+    }
+    static std::uintptr_t link_of(node* p) {
+        return reinterpret_cast<std::uintptr_t>(p);
+    }
+
+    // 桶目录：第0段包含桶[0, 2)，第k段（k>=1）包含桶[2^k, 2^(k+1))
+    // 每一段第一次用到时才分配，之后不会再移动，所以桶的数量翻倍时不需要复制目录
+    std::atomic<std::atomic<node*>*> m_segments[kMaxSegments];
+    // 当前的桶的数量，始终是2的幂
+    std::atomic<std::size_t> m_bucket_count;
+    std::atomic<std::size_t> m_size{0};
+    // 桶0的哨兵结点，也就是整个链表的头
+    node* m_head;
+    Hash m_hasher;
+    float m_max_load_factor = 2.0f;
+
+    std::atomic<data_to_reclaim*> m_nodes_to_reclaim{nullptr};
+    std::atomic<std::size_t> m_reclaim_count{0};
+
+    static std::uint64_t reverse_bits(std::uint64_t x) {
+        x = ((x >> 1) & 0x5555555555555555ull) | ((x & 0x5555555555555555ull) << 1);
+        x = ((x >> 2) & 0x3333333333333333ull) | ((x & 0x3333333333333333ull) << 2);
+        x = ((x >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((x & 0x0F0F0F0F0F0F0F0Full) << 4);
+        x = ((x >> 8) & 0x00FF00FF00FF00FFull) | ((x & 0x00FF00FF00FF00FFull) << 8);
+        x = ((x >> 16) & 0x0000FFFF0000FFFFull) | ((x & 0x0000FFFF0000FFFFull) << 16);
+        return (x >> 32) | (x << 32);
+    }
+
+    static std::uint64_t regular_key(std::uint64_t hash) {
+        return reverse_bits(hash) | 1;
+    }
+    static std::uint64_t dummy_key(std::size_t bucket) {
+        return reverse_bits(bucket);
+    }
+
+    std::atomic<node*>& bucket_slot(std::size_t bucket) {
+        const unsigned segment = bucket < 2 ? 0 : static_cast<unsigned>(std::bit_width(bucket)) - 1;
+        const std::size_t offset = bucket < 2 ? bucket : bucket - (std::size_t(1) << segment);
+        std::atomic<node*>* slots = m_segments[segment].load(std::memory_order_acquire);
+        if (slots == nullptr) {
+            const std::size_t segment_size = segment == 0 ? 2 : (std::size_t(1) << segment);
+            auto* fresh = new std::atomic<node*>[segment_size];
+            for (std::size_t i = 0; i < segment_size; ++i) {
+                fresh[i].store(nullptr, std::memory_order_relaxed);
+            }
+            if (m_segments[segment].compare_exchange_strong(slots, fresh, std::memory_order_acq_rel)) {
+                slots = fresh;
+            } else {
+                delete[] fresh;
+            }
+        }
+        return slots[offset];
+    }
+
+    // 在从start开始的链表中查找，结果通过prev/cur返回：
+    // prev是指向cur的那个next指针，cur是第一个排序键大于等于so_key的结点（或者就是要找的结点）
+    // 返回时prev所在的结点与cur都受到风险指针的保护
+    // 查找的过程中会顺便摘除所有带有删除标记的结点
+    bool find(node* start, std::uint64_t so_key, const Key* key, std::atomic<std::uintptr_t>*& prev, node*& cur) {
+        split_ordered_hp_owner& hazards = get_split_ordered_hazards_for_current_thread();
+        std::atomic<void*>& hp_prev = hazards.get_pointer(0);
+        std::atomic<void*>& hp_cur = hazards.get_pointer(1);
+    try_again:
+        // 哨兵结点永远不会被删除，不需要保护
+        prev = &start->m_next;
+        hp_prev.store(nullptr);
+        cur = pointer_of(prev->load(std::memory_order_acquire));
+        while (true) {
+            if (cur == nullptr) {
+                return false;
+            }
+            hp_cur.store(cur);
+            // 声明以后再检查一次，保证声明时cur还在链表中
+            if (prev->load() != link_of(cur)) {
+                goto try_again;
+            }
+            const std::uintptr_t next = cur->m_next.load(std::memory_order_acquire);
+            if (is_marked(next)) {
+                // cur已经被逻辑删除了，帮忙把它从链表中摘除
+                std::uintptr_t expected = link_of(cur);
+                if (!prev->compare_exchange_strong(expected, next & ~kMark, std::memory_order_acq_rel)) {
+                    goto try_again;
+                }
+                retire(cur, [](void* p) { delete static_cast<node*>(p); });
+                cur = pointer_of(next);
+                continue;
+            }
+            if (cur->m_so_key > so_key) {
+                return false;
+            }
+            if (cur->m_so_key == so_key && (key == nullptr || (!cur->is_dummy() && cur->m_key == *key))) {
+                return true;
+            }
+            // 向后移动一个结点，cur变成新的prev所在的结点
+            prev = &cur->m_next;
+            hp_prev.store(cur);
+            cur = pointer_of(next);
+        }
+    }
+
+    void clear_hazards() {
+        split_ordered_hp_owner& hazards = get_split_ordered_hazards_for_current_thread();
+        for (unsigned i = 0; i < split_ordered_hazards_per_thread; ++i) {
+            hazards.get_pointer(i).store(nullptr, std::memory_order_release);
+        }
+    }
+
+    // 把一个新的结点插入到从start开始的链表中
+    // 如果已经存在排序键（以及key）相同的结点，则不插入，返回已经存在的结点
+    node* list_insert(node* start, node* new_node, const Key* key) {
+        std::atomic<std::uintptr_t>* prev;
+        node* cur;
+        while (true) {
+            if (find(start, new_node->m_so_key, key, prev, cur)) {
+                return cur;
+            }
+            new_node->m_next.store(link_of(cur), std::memory_order_relaxed);
+            std::uintptr_t expected = link_of(cur);
+            if (prev->compare_exchange_weak(expected, link_of(new_node), std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+                return new_node;
+            }
+        }
+    }
+
+    static std::size_t parent_of(std::size_t bucket) {
+        // 去掉最高位的1
+        return bucket & ~(std::size_t(1) << (std::bit_width(bucket) - 1));
+    }
+
+    // 返回桶的哨兵结点，桶还没有初始化时先初始化它（以及它的父桶）
+    node* get_bucket(std::size_t bucket) {
+        std::atomic<node*>& slot = bucket_slot(bucket);
+        node* dummy = slot.load(std::memory_order_acquire);
+        if (dummy != nullptr) {
+            return dummy;
+        }
+        node* parent = get_bucket(parent_of(bucket));
+        node* fresh = new node(dummy_key(bucket));
+        node* inserted = list_insert(parent, fresh, nullptr);
+        clear_hazards();
+        if (inserted != fresh) {
+            // 其他线程已经插入了这个哨兵结点
+            delete fresh;
+        }
+        slot.store(inserted, std::memory_order_release);
+        return inserted;
+    }
+
+    node* bucket_for(std::uint64_t hash) {
+        return get_bucket(hash & (m_bucket_count.load(std::memory_order_acquire) - 1));
+    }
+
+    template<typename Deleter>
+    void retire(void* p, Deleter deleter) {
+        data_to_reclaim* reclaim_node = new data_to_reclaim{p, deleter, nullptr};
+        reclaim_node->m_next = m_nodes_to_reclaim.load();
+        while (!m_nodes_to_reclaim.compare_exchange_weak(reclaim_node->m_next, reclaim_node));
+        if (m_reclaim_count.fetch_add(1, std::memory_order_relaxed) + 1 >= kReclaimThreshold) {
+            delete_nodes_with_no_hazards();
+        }
+    }
+
+    // 取出所有等待释放的对象，释放没有被任何风险指针声明的对象，其余的放回去
+    void delete_nodes_with_no_hazards() {
+        data_to_reclaim* current = m_nodes_to_reclaim.exchange(nullptr);
+        if (current == nullptr) {
+            return;
+        }
+        std::vector<void*> hazards;
+        hazards.reserve(max_split_ordered_threads * split_ordered_hazards_per_thread);
+        for (auto& record : split_ordered_hazard_records) {
+            for (auto& pointer : record.m_pointers) {
+                if (void* p = pointer.load()) {
+                    hazards.push_back(p);
+                }
+            }
+        }
+        std::sort(hazards.begin(), hazards.end());
+        std::size_t kept = 0;
+        std::size_t freed = 0;
+        data_to_reclaim* keep_list = nullptr;
+        data_to_reclaim* keep_tail = nullptr;
+        while (current) {
+            data_to_reclaim* const next = current->m_next;
+            if (std::binary_search(hazards.begin(), hazards.end(), current->m_data)) {
+                current->m_next = keep_list;
+                if (!keep_list) {
+                    keep_tail = current;
+                }
+                keep_list = current;
+                ++kept;
+            } else {
+                current->m_deleter(current->m_data);
+                delete current;
+                ++freed;
+            }
+            current = next;
+        }
+        m_reclaim_count.fetch_sub(freed, std::memory_order_relaxed);
+        if (keep_list) {
+            keep_tail->m_next = m_nodes_to_reclaim.load();
+            while (!m_nodes_to_reclaim.compare_exchange_weak(keep_tail->m_next, keep_list));
+        }
+    }
+
+public:
+    explicit split_ordered_map(std::size_t num_buckets = 2, const Hash& hasher = Hash()) : m_hasher(hasher) {
+        for (auto& segment : m_segments) {
+            segment.store(nullptr, std::memory_order_relaxed);
+        }
+        m_bucket_count.store(std::bit_ceil(std::max<std::size_t>(num_buckets, 2)), std::memory_order_relaxed);
+        m_head = new node(dummy_key(0));
+        bucket_slot(0).store(m_head, std::memory_order_release);
+    }
+
+    split_ordered_map(const split_ordered_map& other) = delete;
+    split_ordered_map& operator=(const split_ordered_map& other) = delete;
+
+    // 析构时不能有其他线程还在使用这个哈希表
+    ~split_ordered_map() {
+        node* current = m_head;
+        while (current) {
+            node* const next = pointer_of(current->m_next.load(std::memory_order_relaxed));
+            delete current;
+            current = next;
+        }
+        data_to_reclaim* reclaim = m_nodes_to_reclaim.load();
+        while (reclaim) {
+            data_to_reclaim* const next = reclaim->m_next;
+            reclaim->m_deleter(reclaim->m_data);
+            delete reclaim;
+            reclaim = next;
+        }
+        for (auto& segment : m_segments) {
+            delete[] segment.load(std::memory_order_relaxed);
+        }
+    }
+
+    Value value_for(const Key& key, const Value& default_value = Value()) {
+        const std::uint64_t hash = concurrent_hash_mix(m_hasher(key));
+        std::atomic<std::uintptr_t>* prev;
+        node* cur;
+        Value result = default_value;
+        if (find(bucket_for(hash), regular_key(hash), &key, prev, cur)) {
+            // cur受到风险指针的保护，但它的值可能同时被替换，所以值也要单独声明
+            std::atomic<void*>& hp_value = get_split_ordered_hazards_for_current_thread().get_pointer(2);
+            value_box* box = cur->m_value.load(std::memory_order_acquire);
+            value_box* temp;
+            do {
+                temp = box;
+                hp_value.store(box);
+                box = cur->m_value.load();
+            } while (box != temp);
+            result = box->m_value;
+        }
+        clear_hazards();
+        return result;
+    }
+
+    void add_or_update_mapping(const Key& key, const Value& value) {
+        const std::uint64_t hash = concurrent_hash_mix(m_hasher(key));
+        node* start = bucket_for(hash);
+        node* fresh = new node(regular_key(hash), key, value);
+        node* inserted = list_insert(start, fresh, &key);
+        if (inserted != fresh) {
+            // key已经存在，替换它的值
+            value_box* old_box = inserted->m_value.exchange(fresh->m_value.exchange(nullptr), std::memory_order_acq_rel);
+            clear_hazards();
+            delete fresh;
+            retire(old_box, [](void* p) { delete static_cast<value_box*>(p); });
+            return;
+        }
+        clear_hazards();
+        const std::size_t size = m_size.fetch_add(1, std::memory_order_relaxed) + 1;
+        std::size_t bucket_count = m_bucket_count.load(std::memory_order_relaxed);
+        // 负载过高时只需要把桶的数量翻倍，新的桶在第一次用到时才会初始化
+        if (static_cast<float>(size) > m_max_load_factor * static_cast<float>(bucket_count) &&
+            bucket_count < (std::size_t(1) << (kMaxSegments - 1))) {
+            m_bucket_count.compare_exchange_strong(bucket_count, bucket_count * 2, std::memory_order_acq_rel);
+        }
+    }
+
+    void remove_mapping(const Key& key) {
+        const std::uint64_t hash = concurrent_hash_mix(m_hasher(key));
+        node* start = bucket_for(hash);
+        std::atomic<std::uintptr_t>* prev;
+        node* cur;
+        while (find(start, regular_key(hash), &key, prev, cur)) {
+            std::uintptr_t next = cur->m_next.load(std::memory_order_acquire);
+            if (is_marked(next)) {
+                continue;
+            }
+            // 先做删除标记（逻辑删除），成功标记的线程才算删除了这个元素
+            if (!cur->m_next.compare_exchange_weak(next, next | kMark, std::memory_order_acq_rel)) {
+                continue;
+            }
+            m_size.fetch_sub(1, std::memory_order_relaxed);
+            // 再尝试摘除，失败的话由下一次find负责摘除
+            std::uintptr_t expected = link_of(cur);
+            if (prev->compare_exchange_strong(expected, next, std::memory_order_acq_rel)) {
+                clear_hazards();
+                retire(cur, [](void* p) { delete static_cast<node*>(p); });
+            } else {
+                find(start, regular_key(hash), &key, prev, cur);
+                clear_hazards();
+            }
+            return;
+        }
+        clear_hazards();
+    }
+
+    std::size_t size() const {
+        return m_size.load(std::memory_order_relaxed);
+    }
+
+    std::size_t bucket_count() const {
+        return m_bucket_count.load(std::memory_order_relaxed);
+    }
+
+    // 占用的内存（字节），包括桶目录的各段、哨兵结点、元素结点与它们的值
+    // 等待释放的对象不知道具体类型，按一个元素结点的大小估计；并发修改时只是一个近似值
+    std::size_t memory_usage() const {
+        constexpr std::size_t element_bytes = sizeof(node) + sizeof(value_box);
+        std::size_t total = sizeof(*this);
+        for (unsigned segment = 0; segment < kMaxSegments; ++segment) {
+            const std::atomic<node*>* slots = m_segments[segment].load(std::memory_order_acquire);
+            if (slots == nullptr) {
+                continue;
+            }
+            const std::size_t segment_size = segment == 0 ? 2 : (std::size_t(1) << segment);
+            total += segment_size * sizeof(std::atomic<node*>);
+            // 每个已经初始化的桶都有一个自己的哨兵结点
+            for (std::size_t i = 0; i < segment_size; ++i) {
+                if (slots[i].load(std::memory_order_relaxed) != nullptr) {
+                    total += sizeof(node);
+                }
+            }
+        }
+        total += m_size.load(std::memory_order_relaxed) * element_bytes;
+        total += m_reclaim_count.load(std::memory_order_relaxed) * (sizeof(data_to_reclaim) + element_bytes);
+        return total;
+    }
+};
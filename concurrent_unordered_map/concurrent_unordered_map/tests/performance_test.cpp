@@ -0,0 +1,319 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../concurrent_unordered_map_v1.hpp"
+#include "../concurrent_flat_map.hpp"
+#include "../split_ordered_map.hpp"
+#include "../concurrent_striped_map.hpp"
+#include "../concurrent_unordered_map_snapshot.hpp"
+#include "../concurrent_string_map.hpp"
+
+// --- 参数调整区 ---
+// 插入的元素个数
+static constexpr int NUM_KEYS = 1000000;
+// 每个线程查找的次数
+static constexpr int LOOKUPS_PER_THREAD = 2000000;
+// 热点查找测试中key的个数，所有的线程都反复读这几个key
+static constexpr int HOT_KEYS = 8;
+// 批量查找时每一批的key的个数
+static constexpr int BATCH_SIZE = 256;
+// 字符串key的测试中key的个数与长度
+static constexpr int STRING_KEYS = 200000;
+static constexpr int STRING_KEY_LENGTH = 64;
+
+// 使用thread_count个线程执行work(thread_index)，返回耗时（毫秒）
+template<typename Work>
+double run_threads(int thread_count, Work work) {
+    std::atomic<bool> start(false);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&, t]() {
+            while (!start.load()) {
+                std::this_thread::yield();
+            }
+            work(t);
+        });
+    }
+    auto begin = std::chrono::high_resolution_clock::now();
+    start.store(true);
+    for (auto& t : threads) {
+        t.join();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+template<typename Map>
+void benchmark_map(const std::string& name, int thread_count) {
+    Map map;
+    const double insert_ms = run_threads(thread_count, [&](int t) {
+        for (int i = t; i < NUM_KEYS; i += thread_count) {
+            map.add_or_update_mapping(i, i);
+        }
+    });
+    // 每个哈希表自己统计占用的内存，不包括内存分配器的开销
+    const std::size_t bytes = map.memory_usage();
+
+    std::atomic<long long> checksum(0);
+    const double lookup_ms = run_threads(thread_count, [&](int t) {
+        long long sum = 0;
+        unsigned key = static_cast<unsigned>(t) * 7919u;
+        for (int i = 0; i < LOOKUPS_PER_THREAD; ++i) {
+            key = key * 1664525u + 1013904223u;
+            sum += map.value_for(static_cast<int>(key % NUM_KEYS), -1);
+        }
+        checksum.fetch_add(sum);
+    });
+
+    const double total_lookups = static_cast<double>(thread_count) * LOOKUPS_PER_THREAD;
+    std::cout << std::setw(26) << name << " | "
+              << std::setw(7) << thread_count << " | "
+              << std::setw(12) << NUM_KEYS / insert_ms / 1000.0 << " | "
+              << std::setw(12) << total_lookups / lookup_ms / 1000.0 << " | "
+              << std::setw(11) << static_cast<double>(bytes) / NUM_KEYS
+              << (checksum.load() == 42 ? " " : "") << std::endl;
+}
+
+// 不能按字节复制的int，concurrent_unordered_map对它只能使用加共享锁的读
+struct locked_int {
+    int value = 0;
+    locked_int() = default;
+    locked_int(int v) : value(v) {}
+    locked_int(const locked_int& other) : value(other.value) {}
+    locked_int& operator=(const locked_int& other) {
+        value = other.value;
+        return *this;
+    }
+    operator int() const {
+        return value;
+    }
+};
+
+// 所有的线程都反复读取少数几个key，返回每秒的查找次数（百万）
+template<typename Map>
+double benchmark_hot_keys(int thread_count) {
+    Map map;
+    for (int i = 0; i < HOT_KEYS; ++i) {
+        map.add_or_update_mapping(i, i);
+    }
+    std::atomic<long long> checksum(0);
+    const double ms = run_threads(thread_count, [&](int t) {
+        long long sum = 0;
+        for (int i = 0; i < LOOKUPS_PER_THREAD; ++i) {
+            sum += static_cast<int>(map.value_for((i + t) % HOT_KEYS));
+        }
+        checksum.fetch_add(sum);
+    });
+    return static_cast<double>(thread_count) * LOOKUPS_PER_THREAD / ms / 1000.0 + (checksum.load() == 42 ? 1e-9 : 0);
+}
+
+// 每一批BATCH_SIZE个随机的key，对比逐个调用value_for与调用一次multi_get，返回每秒查找的key的个数（百万）
+template<typename Map>
+std::pair<double, double> benchmark_batches() {
+    Map map;
+    for (int i = 0; i < NUM_KEYS; ++i) {
+        map.add_or_update_mapping(i, i);
+    }
+    const int batches = LOOKUPS_PER_THREAD / BATCH_SIZE;
+    std::vector<std::vector<int>> keys(batches, std::vector<int>(BATCH_SIZE));
+    unsigned seed = 12345;
+    for (auto& batch : keys) {
+        for (int& key : batch) {
+            seed = seed * 1664525u + 1013904223u;
+            key = static_cast<int>(seed % NUM_KEYS);
+        }
+    }
+    long long sum = 0;
+    const double single_ms = run_threads(1, [&](int) {
+        for (const auto& batch : keys) {
+            for (int key : batch) {
+                sum += static_cast<int>(map.value_for(key));
+            }
+        }
+    });
+    const double batch_ms = run_threads(1, [&](int) {
+        for (const auto& batch : keys) {
+            for (const auto& value : map.multi_get(batch)) {
+                sum += static_cast<int>(value);
+            }
+        }
+    });
+    const double total = static_cast<double>(batches) * BATCH_SIZE / 1000.0;
+    return {total / single_ms + (sum == 42 ? 1e-9 : 0), total / batch_ms};
+}
+
+// 只读阶段的随机查找：concurrent_unordered_map与freeze()得到的frozen_unordered_map，返回每次查找的平均时间（纳秒）
+template<typename Value>
+std::pair<double, double> benchmark_frozen(int thread_count) {
+    concurrent_unordered_map<int, Value> map;
+    for (int i = 0; i < NUM_KEYS; ++i) {
+        map.add_or_update_mapping(i, i);
+    }
+    const auto frozen = map.freeze();
+    std::atomic<long long> checksum(0);
+    auto lookups = [&](auto& target) {
+        return run_threads(thread_count, [&](int t) {
+            long long sum = 0;
+            unsigned key = static_cast<unsigned>(t) * 7919u;
+            for (int i = 0; i < LOOKUPS_PER_THREAD; ++i) {
+                key = key * 1664525u + 1013904223u;
+                sum += static_cast<int>(target.value_for(static_cast<int>(key % NUM_KEYS)));
+            }
+            checksum.fetch_add(sum);
+        });
+    };
+    const double live_ms = lookups(map);
+    const double frozen_ms = lookups(*frozen);
+    // 每个线程做LOOKUPS_PER_THREAD次查找，用单个线程的平均时间表示延迟
+    const double scale = 1e6 / LOOKUPS_PER_THREAD;
+    return {live_ms * scale + (checksum.load() == 42 ? 1e-9 : 0), frozen_ms * scale};
+}
+
+// 较长的字符串key，对比concurrent_unordered_map<std::string, int>与concurrent_string_map<int>
+// key_heap_bytes是每个key在哈希表之外另外分配的字节数（std::string的字符数组），memory_usage()不包括这部分
+template<typename Map>
+void benchmark_string_keys(const std::string& name, std::size_t key_heap_bytes) {
+    std::vector<std::string> keys;
+    keys.reserve(STRING_KEYS);
+    for (int i = 0; i < STRING_KEYS; ++i) {
+        std::string key = "user:session:" + std::to_string(i) + ":";
+        key.resize(STRING_KEY_LENGTH, 'x');
+        keys.push_back(std::move(key));
+    }
+    Map map;
+    const double insert_ms = run_threads(1, [&](int) {
+        for (int i = 0; i < STRING_KEYS; ++i) {
+            map.add_or_update_mapping(keys[i], i);
+        }
+    });
+    const std::size_t bytes = map.memory_usage() + key_heap_bytes * STRING_KEYS;
+    long long sum = 0;
+    const double lookup_ms = run_threads(1, [&](int) {
+        unsigned key = 7919u;
+        for (int i = 0; i < LOOKUPS_PER_THREAD; ++i) {
+            key = key * 1664525u + 1013904223u;
+            sum += map.value_for(keys[key % STRING_KEYS], -1);
+        }
+    });
+    std::cout << std::setw(26) << name << " | "
+              << std::setw(12) << STRING_KEYS / insert_ms / 1000.0 << " | "
+              << std::setw(12) << LOOKUPS_PER_THREAD / lookup_ms / 1000.0 << " | "
+              << std::setw(11) << static_cast<double>(bytes) / STRING_KEYS
+              << (sum == 42 ? " " : "") << std::endl;
+}
+
+int main() {
+    std::cout << "Benchmark Configuration:" << std::endl;
+    std::cout << "------------------------" << std::endl;
+    std::cout << "Number of keys: " << NUM_KEYS << " (int -> int)" << std::endl;
+    std::cout << "Lookups per thread: " << LOOKUPS_PER_THREAD << std::endl;
+    std::cout << "Hardware concurrency: " << std::thread::hardware_concurrency() << std::endl;
+    std::cout << "------------------------" << std::endl << std::endl;
+
+    std::vector<int> thread_counts = {1};
+    const int hardware = static_cast<int>(std::thread::hardware_concurrency());
+    if (hardware > 1) {
+        thread_counts.push_back(hardware);
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "                       map | threads | insert Mops/s | lookup Mops/s | bytes/entry" << std::endl;
+    for (int thread_count : thread_counts) {
+        benchmark_map<concurrent_unordered_map<int, int>>("concurrent_unordered_map", thread_count);
+        benchmark_map<concurrent_flat_map<int, int>>("concurrent_flat_map", thread_count);
+        benchmark_map<split_ordered_map<int, int>>("split_ordered_map", thread_count);
+        benchmark_map<concurrent_striped_map<int, int>>("concurrent_striped_map", thread_count);
+    }
+
+    std::cout << std::endl << "Hot keys: " << HOT_KEYS << std::endl;
+    std::cout << "threads | optimistic lookup Mops/s | shared_lock lookup Mops/s" << std::endl;
+    for (int thread_count = 1; thread_count <= std::max(hardware, 1); thread_count *= 2) {
+        std::cout << std::setw(7) << thread_count << " | "
+                  << std::setw(24) << benchmark_hot_keys<concurrent_unordered_map<int, int>>(thread_count) << " | "
+                  << std::setw(25) << benchmark_hot_keys<concurrent_unordered_map<int, locked_int>>(thread_count)
+                  << std::endl;
+    }
+
+    {
+        // 导出所有元素：get_map锁住整个表并构造std::map，snapshot_to一次只锁一个桶
+        concurrent_unordered_map<int, int> map;
+        for (int i = 0; i < NUM_KEYS; ++i) {
+            map.add_or_update_mapping(i, i);
+        }
+        std::size_t exported = 0;
+        // 先导出一次，避免第一次分配大块内存时的缺页影响结果
+        exported += map.parallel_snapshot().size();
+        const double snapshot_ms = run_threads(1, [&](int) {
+            std::vector<std::pair<int, int>> snapshot;
+            map.snapshot_to(snapshot);
+            exported += snapshot.size();
+        });
+        const double parallel_ms = run_threads(1, [&](int) { exported += map.parallel_snapshot().size(); });
+        const double get_map_ms = run_threads(1, [&](int) { exported += map.get_map().size(); });
+        std::cout << std::endl << "Export " << exported / 4 << " entries" << std::endl;
+        std::cout << "get_map: " << get_map_ms << " ms | snapshot_to: " << snapshot_ms
+                  << " ms | parallel_snapshot: " << parallel_ms << " ms" << std::endl;
+    }
+
+    {
+        // 重启时恢复数据：逐个插入与读取二进制快照
+        concurrent_unordered_map<int, int> source;
+        const double insert_ms = run_threads(1, [&](int) {
+            for (int i = 0; i < NUM_KEYS; ++i) {
+                source.add_or_update_mapping(i, i);
+            }
+        });
+        const std::string path = (std::filesystem::temp_directory_path() / "cumap_performance_snapshot.bin").string();
+        bool ok = false;
+        const double save_ms = run_threads(1, [&](int) { ok = save_snapshot(source, path); });
+        concurrent_unordered_map<int, int> target;
+        const double load_ms = run_threads(1, [&](int) { ok = ok && load_snapshot(target, path); });
+        std::remove(path.c_str());
+        std::vector<std::pair<int, int>> items;
+        items.reserve(NUM_KEYS);
+        for (int i = 0; i < NUM_KEYS; ++i) {
+            items.emplace_back(i, i);
+        }
+        concurrent_unordered_map<int, int> bulk;
+        const double bulk_ms = run_threads(1, [&](int) { bulk.bulk_insert(items.begin(), items.end()); });
+        std::cout << std::endl << "Warm start " << target.size() << " entries" << (ok ? "" : " (failed)") << std::endl;
+        std::cout << "insert one by one: " << insert_ms << " ms | save_snapshot: " << save_ms
+                  << " ms | load_snapshot: " << load_ms << " ms | bulk_insert: " << bulk_ms << " ms" << std::endl;
+    }
+
+    std::cout << std::endl << "Batch size: " << BATCH_SIZE << " (single thread)" << std::endl;
+    std::cout << "               value | value_for Mops/s | multi_get Mops/s" << std::endl;
+    const auto optimistic = benchmark_batches<concurrent_unordered_map<int, int>>();
+    std::cout << std::setw(20) << "int" << " | " << std::setw(16) << optimistic.first << " | "
+              << std::setw(16) << optimistic.second << std::endl;
+    const auto locked = benchmark_batches<concurrent_unordered_map<int, locked_int>>();
+    std::cout << std::setw(20) << "locked_int" << " | " << std::setw(16) << locked.first << " | "
+              << std::setw(16) << locked.second << std::endl;
+
+    std::cout << std::endl << "Read-only lookups: " << NUM_KEYS << " keys" << std::endl;
+    std::cout << "     value | threads | live map ns/lookup | frozen ns/lookup" << std::endl;
+    for (int thread_count : thread_counts) {
+        const auto live_int = benchmark_frozen<int>(thread_count);
+        std::cout << std::setw(10) << "int" << " | " << std::setw(7) << thread_count << " | "
+                  << std::setw(18) << live_int.first << " | " << std::setw(16) << live_int.second << std::endl;
+        const auto live_locked = benchmark_frozen<locked_int>(thread_count);
+        std::cout << std::setw(10) << "locked_int" << " | " << std::setw(7) << thread_count << " | "
+                  << std::setw(18) << live_locked.first << " | " << std::setw(16) << live_locked.second << std::endl;
+    }
+
+    std::cout << std::endl << "String keys: " << STRING_KEYS << " x " << STRING_KEY_LENGTH << " bytes (single thread)" << std::endl;
+    std::cout << "                       map | insert Mops/s | lookup Mops/s | bytes/entry" << std::endl;
+    benchmark_string_keys<concurrent_unordered_map<std::string, int>>("concurrent_unordered_map", STRING_KEY_LENGTH + 1);
+    // key保存在分片的arena中，已经包含在memory_usage()里
+    benchmark_string_keys<concurrent_string_map<int>>("concurrent_string_map", 0);
+    return 0;
+}
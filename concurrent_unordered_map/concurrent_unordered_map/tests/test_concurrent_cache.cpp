@@ -0,0 +1,109 @@
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "../concurrent_cache.hpp"
+
+TEST(ConcurrentCacheTest, BasicOperations) {
+    concurrent_cache<int, std::string> cache(100, 4);
+    EXPECT_EQ(cache.capacity(), 100u);
+    EXPECT_FALSE(cache.get(1).has_value());
+
+    cache.put(1, "one");
+    cache.put(2, "two");
+    EXPECT_EQ(cache.get(1).value(), "one");
+    cache.put(1, "uno");
+    EXPECT_EQ(cache.get(1).value(), "uno");
+    EXPECT_EQ(cache.size(), 2u);
+
+    cache.erase(1);
+    EXPECT_FALSE(cache.get(1).has_value());
+    EXPECT_EQ(cache.size(), 1u);
+
+    const cache_stats stats = cache.stats();
+    EXPECT_EQ(stats.hits, 2u);
+    EXPECT_EQ(stats.misses, 2u);
+    EXPECT_EQ(stats.evictions, 0u);
+}
+
+// 缓存满了以后，最近被访问过的元素会得到第二次机会，先淘汰没有被访问过的元素
+TEST(ConcurrentCacheTest, ClockEvictsUnreferencedEntries) {
+    concurrent_cache<int, int> cache(4, 1);
+    for (int i = 0; i < 4; ++i) {
+        cache.put(i, i);
+    }
+    ASSERT_TRUE(cache.get(0).has_value());
+    ASSERT_TRUE(cache.get(2).has_value());
+
+    cache.put(4, 4);
+    cache.put(5, 5);
+    EXPECT_EQ(cache.size(), 4u);
+    EXPECT_TRUE(cache.get(0).has_value());
+    EXPECT_TRUE(cache.get(2).has_value());
+    EXPECT_FALSE(cache.get(1).has_value());
+    EXPECT_FALSE(cache.get(3).has_value());
+    EXPECT_EQ(cache.stats().evictions, 2u);
+}
+
+TEST(ConcurrentCacheTest, SizeNeverExceedsCapacity) {
+    concurrent_cache<int, int> cache(1000, 8);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < 20000; ++i) {
+                const int key = (i * 7 + t) % 5000;
+                if (auto value = cache.get(key)) {
+                    ASSERT_EQ(*value, key * 2);
+                } else {
+                    cache.put(key, key * 2);
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_LE(cache.size(), 1000u);
+    const cache_stats stats = cache.stats();
+    EXPECT_EQ(stats.hits + stats.misses, 80000u);
+    EXPECT_GT(stats.evictions, 0u);
+}
+
+// 多个线程同时未命中同一个key时只计算一次
+TEST(ConcurrentCacheTest, GetOrComputeIsSingleFlight) {
+    concurrent_cache<int, int> cache(100);
+    std::atomic<int> computations(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&]() {
+            const int value = cache.get_or_compute(42, [&](int key) {
+                computations.fetch_add(1);
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                return key + 1;
+            });
+            EXPECT_EQ(value, 43);
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(computations.load(), 1);
+    EXPECT_EQ(cache.get(42).value(), 43);
+    // 只有调用compute的线程算作未命中，等待结果的线程算作命中
+    const cache_stats stats = cache.stats();
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_EQ(stats.hits, 8u);
+}
+
+TEST(ConcurrentCacheTest, GetOrComputePropagatesExceptions) {
+    concurrent_cache<int, int> cache(100);
+    EXPECT_THROW(cache.get_or_compute(1, [](int) -> int { throw std::runtime_error("failed"); }),
+                 std::runtime_error);
+    EXPECT_FALSE(cache.get(1).has_value());
+    // 失败以后可以重新计算
+    EXPECT_EQ(cache.get_or_compute(1, [](int key) { return key * 10; }), 10);
+}
@@ -0,0 +1,83 @@
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "../concurrent_flat_map.hpp"
+
+TEST(ConcurrentFlatMapTest, BasicOperations) {
+    concurrent_flat_map<std::string, int> map(4);
+    EXPECT_EQ(map.value_for("missing", -1), -1);
+    map.add_or_update_mapping("a", 1);
+    map.add_or_update_mapping("b", 2);
+    map.add_or_update_mapping("a", 3);
+    EXPECT_EQ(map.value_for("a"), 3);
+    EXPECT_EQ(map.value_for("b"), 2);
+    EXPECT_EQ(map.size(), 2u);
+    map.remove_mapping("a");
+    map.remove_mapping("a");
+    EXPECT_EQ(map.value_for("a", -1), -1);
+    EXPECT_EQ(map.size(), 1u);
+}
+
+// 随机的插入与删除，结果与std::unordered_map对比
+// 大量的删除会留下kDeleted，用来检查原地整理与扩容的逻辑
+TEST(ConcurrentFlatMapTest, MatchesStdUnorderedMap) {
+    concurrent_flat_map<int, int> map(2);
+    std::unordered_map<int, int> reference;
+    std::mt19937 gen(12345);
+    std::uniform_int_distribution<int> key_dist(0, 5000);
+    for (int i = 0; i < 200000; ++i) {
+        const int key = key_dist(gen);
+        if (gen() % 3 == 0) {
+            map.remove_mapping(key);
+            reference.erase(key);
+        } else {
+            map.add_or_update_mapping(key, i);
+            reference[key] = i;
+        }
+    }
+    EXPECT_EQ(map.size(), reference.size());
+    for (int key = 0; key <= 5000; ++key) {
+        auto it = reference.find(key);
+        ASSERT_EQ(map.value_for(key, -1), it == reference.end() ? -1 : it->second) << "key " << key;
+    }
+}
+
+// 高位不同、低位相同的key也要能均匀分布
+TEST(ConcurrentFlatMapTest, KeysDifferingInHighBits) {
+    concurrent_flat_map<std::size_t, std::size_t> map(8);
+    for (std::size_t i = 0; i < 10000; ++i) {
+        map.add_or_update_mapping(i << 32, i);
+    }
+    for (std::size_t i = 0; i < 10000; ++i) {
+        ASSERT_EQ(map.value_for(i << 32, 0), i);
+    }
+}
+
+TEST(ConcurrentFlatMapTest, ConcurrentReadersAndWriters) {
+    concurrent_flat_map<int, int> map;
+    map.reserve(40000);
+    const int num_threads = 4;
+    const int items_per_thread = 10000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < items_per_thread; ++i) {
+                const int key = t * items_per_thread + i;
+                map.add_or_update_mapping(key, key + 1);
+                ASSERT_EQ(map.value_for(key), key + 1);
+                if (i % 4 == 0) {
+                    map.remove_mapping(key);
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(map.size(), static_cast<std::size_t>(num_threads * items_per_thread * 3 / 4));
+    EXPECT_GT(map.memory_usage(), map.size() * sizeof(std::pair<int, int>));
+}
@@ -0,0 +1,113 @@
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "../concurrent_string_map.hpp"
+
+TEST(ConcurrentStringMapTest, BasicOperations) {
+    concurrent_string_map<int> map;
+    EXPECT_EQ(map.value_for("missing", -1), -1);
+
+    map.add_or_update_mapping("one", 1);
+    map.add_or_update_mapping(std::string("two"), 2);
+    map.add_or_update_mapping("", 0);
+    EXPECT_EQ(map.value_for("one"), 1);
+    EXPECT_EQ(map.value_for(std::string_view("two")), 2);
+    EXPECT_EQ(map.value_for("", -1), 0);
+    EXPECT_EQ(map.size(), 3u);
+
+    map.add_or_update_mapping("one", 11);
+    EXPECT_EQ(map.value_for("one"), 11);
+    EXPECT_EQ(map.size(), 3u);
+
+    map.remove_mapping("one");
+    map.remove_mapping("not there");
+    EXPECT_EQ(map.value_for("one", -1), -1);
+    EXPECT_EQ(map.size(), 2u);
+}
+
+// key被复制到arena中，调用者的字符串可以立即销毁；扩容与删除以后key仍然正确
+TEST(ConcurrentStringMapTest, KeysOutliveCallerAndSurviveRehash) {
+    concurrent_string_map<int> map(4);
+    const std::string prefix(100, 'k');
+    for (int i = 0; i < 50000; ++i) {
+        std::string key = prefix + std::to_string(i);
+        map.add_or_update_mapping(key, i);
+    }
+    for (int i = 0; i < 50000; i += 2) {
+        map.remove_mapping(prefix + std::to_string(i));
+    }
+    // 再插入一批，触发扩容并回收被删除的key的空间
+    for (int i = 50000; i < 100000; ++i) {
+        map.add_or_update_mapping(prefix + std::to_string(i), i);
+    }
+    for (int i = 0; i < 100000; ++i) {
+        const int expected = (i < 50000 && i % 2 == 0) ? -1 : i;
+        ASSERT_EQ(map.value_for(prefix + std::to_string(i), -1), expected);
+    }
+    EXPECT_EQ(map.size(), 75000u);
+    EXPECT_GT(map.memory_usage(), 75000u * prefix.size());
+}
+
+// 反复删除与插入时arena不会无限增长
+TEST(ConcurrentStringMapTest, ChurnKeepsMemoryBounded) {
+    concurrent_string_map<int> map(4);
+    const std::string live(200, 'x');
+    map.add_or_update_mapping(live, 0);
+    const std::size_t baseline = map.memory_usage();
+    // 删除以后重新插入同一个key：复用原来的字节
+    for (int i = 0; i < 100000; ++i) {
+        map.remove_mapping(live);
+        map.add_or_update_mapping(live, i);
+    }
+    EXPECT_EQ(map.value_for(live, -1), 99999);
+    EXPECT_EQ(map.memory_usage(), baseline);
+
+    // 每次都是不同的key：被删除的字节多了以后原地重建arena
+    const std::string prefix(200, 'k');
+    for (int i = 0; i < 100000; ++i) {
+        const std::string key = prefix + std::to_string(i);
+        map.add_or_update_mapping(key, i);
+        map.remove_mapping(key);
+    }
+    EXPECT_EQ(map.size(), 1u);
+    EXPECT_EQ(map.value_for(live, -1), 99999);
+    EXPECT_EQ(map.value_for(prefix + "99999", -1), -1);
+    // 每个分片最多浪费一块多一点的arena，远小于100000个key的20MB
+    EXPECT_LT(map.memory_usage(), 4 * 3 * 64 * 1024u);
+}
+
+TEST(ConcurrentStringMapTest, ConcurrentAccess) {
+    concurrent_string_map<int> map(8);
+    const int num_threads = 4;
+    const int items_per_thread = 20000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < items_per_thread; ++i) {
+                const int value = t * items_per_thread + i;
+                const std::string key = "session:" + std::to_string(value);
+                map.add_or_update_mapping(key, value);
+                ASSERT_EQ(map.value_for(key, -1), value);
+                if (i % 4 == 0) {
+                    map.remove_mapping(key);
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    std::size_t expected = 0;
+    for (int value = 0; value < num_threads * items_per_thread; ++value) {
+        const std::string key = "session:" + std::to_string(value);
+        if (value % items_per_thread % 4 == 0) {
+            ASSERT_EQ(map.value_for(key, -1), -1);
+        } else {
+            ASSERT_EQ(map.value_for(key, -1), value);
+            ++expected;
+        }
+    }
+    EXPECT_EQ(map.size(), expected);
+}
@@ -0,0 +1,77 @@
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "../concurrent_striped_map.hpp"
+
+TEST(ConcurrentStripedMapTest, BasicOperations) {
+    concurrent_striped_map<int, std::string> map;
+    EXPECT_EQ(map.value_for(1, "none"), "none");
+
+    map.add_or_update_mapping(1, "one");
+    map.add_or_update_mapping(2, "two");
+    EXPECT_EQ(map.value_for(1), "one");
+    EXPECT_EQ(map.value_for(2), "two");
+    EXPECT_EQ(map.size(), 2u);
+
+    map.add_or_update_mapping(1, "uno");
+    EXPECT_EQ(map.value_for(1), "uno");
+    EXPECT_EQ(map.size(), 2u);
+
+    map.remove_mapping(1);
+    map.remove_mapping(42);
+    EXPECT_EQ(map.value_for(1, "none"), "none");
+    EXPECT_EQ(map.size(), 1u);
+}
+
+// 桶的数量增加，锁的数量不变
+TEST(ConcurrentStripedMapTest, BucketsGrowIndependentlyOfLocks) {
+    concurrent_striped_map<int, int> map(16, 8);
+    EXPECT_EQ(map.lock_count(), 8u);
+    EXPECT_EQ(map.bucket_count(), 16u);
+    for (int i = 0; i < 100000; ++i) {
+        map.add_or_update_mapping(i, i * 2);
+    }
+    EXPECT_GE(map.bucket_count(), 65536u);
+    EXPECT_EQ(map.lock_count(), 8u);
+    for (int i = 0; i < 100000; ++i) {
+        ASSERT_EQ(map.value_for(i, -1), i * 2);
+    }
+    map.reserve(1 << 20);
+    EXPECT_GE(map.bucket_count(), static_cast<std::size_t>(1 << 20));
+    EXPECT_EQ(map.value_for(99999, -1), 99999 * 2);
+}
+
+TEST(ConcurrentStripedMapTest, ConcurrentInsertAndLookupDuringResize) {
+    concurrent_striped_map<int, int> map(2, 4);
+    const int num_writers = 4;
+    const int items_per_writer = 20000;
+    std::vector<std::thread> threads;
+    for (int w = 0; w < num_writers; ++w) {
+        threads.emplace_back([&, w]() {
+            for (int i = 0; i < items_per_writer; ++i) {
+                const int key = w * items_per_writer + i;
+                map.add_or_update_mapping(key, key);
+                ASSERT_EQ(map.value_for(key, -1), key);
+                if (i % 3 == 0) {
+                    map.remove_mapping(key);
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    std::size_t expected = 0;
+    for (int key = 0; key < num_writers * items_per_writer; ++key) {
+        if (key % items_per_writer % 3 == 0) {
+            ASSERT_EQ(map.value_for(key, -1), -1);
+        } else {
+            ASSERT_EQ(map.value_for(key, -1), key);
+            ++expected;
+        }
+    }
+    EXPECT_EQ(map.size(), expected);
+}
@@ -0,0 +1,155 @@
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "../concurrent_ttl_map.hpp"
+
+using namespace std::chrono_literals;
+
+// 每个定时器都正好在它的tick到期，包括需要级联以及超出时间轮范围的定时器
+TEST(TimingWheelTest, TimersFireAtTheirTick) {
+    timing_wheel<int> wheel;
+    const std::vector<std::int64_t> ticks = {1, 5, 63, 64, 65, 100, 4095, 4096, 4097, 70000, 300000,
+                                              timing_wheel<int>::kRange + 12345};
+    for (std::size_t i = 0; i < ticks.size(); ++i) {
+        wheel.add({static_cast<int>(i), ticks[i]});
+    }
+    // 已经过期的定时器在下一个tick到期
+    wheel.add({-1, -10});
+    EXPECT_EQ(wheel.size(), ticks.size() + 1);
+
+    std::vector<timing_wheel<int>::timer> due;
+    wheel.advance(1, due);
+    ASSERT_EQ(due.size(), 2u);
+    std::size_t fired = 2;
+    // 每个定时器到期的前一个tick还没有到期，到了它的tick正好到期
+    for (std::size_t i = 1; i < ticks.size(); ++i) {
+        due.clear();
+        wheel.advance(ticks[i] - 1, due);
+        EXPECT_TRUE(due.empty()) << ticks[i];
+        wheel.advance(ticks[i], due);
+        ASSERT_EQ(due.size(), 1u) << ticks[i];
+        EXPECT_EQ(due[0].key, static_cast<int>(i));
+        ++fired;
+    }
+    EXPECT_EQ(fired, ticks.size() + 1);
+    EXPECT_EQ(wheel.size(), 0u);
+}
+
+TEST(ConcurrentTtlMapTest, ExpiredEntriesAreMisses) {
+    concurrent_ttl_map<int, int> map(20ms, 1ms, 4096, false);
+    map.add_or_update_mapping(1, 10);
+    map.add_or_update_mapping(2, 20, 10s);
+    EXPECT_EQ(map.value_for(1, -1), 10);
+    EXPECT_EQ(map.get(2), 20);
+
+    std::this_thread::sleep_for(40ms);
+    EXPECT_EQ(map.value_for(1, -1), -1);
+    EXPECT_FALSE(map.get(1).has_value());
+    EXPECT_EQ(map.value_for(2, -1), 20);
+    // 过期的元素在清理之前仍然占用空间
+    EXPECT_EQ(map.size(), 2u);
+    EXPECT_EQ(map.sweep(), 1u);
+    EXPECT_EQ(map.size(), 1u);
+
+    map.remove_mapping(2);
+    EXPECT_EQ(map.value_for(2, -1), -1);
+}
+
+// 重新写入以后，旧的定时器到期时不会删除元素
+TEST(ConcurrentTtlMapTest, RewriteExtendsLifetime) {
+    concurrent_ttl_map<std::string, int> map(20ms, 1ms, 4096, false);
+    map.add_or_update_mapping("session", 1);
+    std::this_thread::sleep_for(10ms);
+    map.add_or_update_mapping("session", 2, 10s);
+    std::this_thread::sleep_for(30ms);
+    EXPECT_EQ(map.sweep(), 0u);
+    EXPECT_EQ(map.value_for("session", -1), 2);
+    EXPECT_EQ(map.pending_expirations(), 1u);
+}
+
+// 反复刷新同一批key时，每个key只有一个定时器；旧的定时器提前到期时被重新放入时间轮
+TEST(ConcurrentTtlMapTest, RefreshKeepsOneTimerPerKey) {
+    concurrent_ttl_map<int, int> map(30ms, 1ms, 4096, false);
+    for (int i = 0; i < 100000; ++i) {
+        map.add_or_update_mapping(i % 100, i);
+    }
+    EXPECT_EQ(map.size(), 100u);
+    EXPECT_EQ(map.pending_expirations(), 100u);
+
+    // 一直刷新到旧的定时器到期以后，元素仍然存在，定时器被重新放入
+    const auto until = std::chrono::steady_clock::now() + 60ms;
+    while (std::chrono::steady_clock::now() < until) {
+        for (int i = 0; i < 100; ++i) {
+            map.add_or_update_mapping(i, i);
+        }
+        map.sweep();
+    }
+    EXPECT_EQ(map.size(), 100u);
+    EXPECT_LE(map.pending_expirations(), 100u);
+    EXPECT_EQ(map.value_for(7, -1), 7);
+
+    // 停止刷新以后，重新放入的定时器正常到期
+    std::this_thread::sleep_for(50ms);
+    std::size_t removed = 0;
+    for (int round = 0; round < 200 && removed < 100; ++round) {
+        removed += map.sweep();
+        std::this_thread::sleep_for(1ms);
+    }
+    EXPECT_EQ(removed, 100u);
+    EXPECT_EQ(map.size(), 0u);
+    EXPECT_EQ(map.pending_expirations(), 0u);
+}
+
+// 过期时间提前时需要一个更早的定时器，旧的定时器到期时被丢弃
+TEST(ConcurrentTtlMapTest, ShorterTtlArmsEarlierTimer) {
+    concurrent_ttl_map<int, int> map(10s, 1ms, 4096, false);
+    map.add_or_update_mapping(1, 1);
+    map.add_or_update_mapping(1, 2, 5ms);
+    EXPECT_EQ(map.pending_expirations(), 2u);
+    std::this_thread::sleep_for(20ms);
+    EXPECT_EQ(map.sweep(), 1u);
+    EXPECT_EQ(map.size(), 0u);
+    EXPECT_EQ(map.pending_expirations(), 1u);
+}
+
+// 每次清理最多删除max_expirations_per_tick个元素
+TEST(ConcurrentTtlMapTest, SweepIsBounded) {
+    concurrent_ttl_map<int, int> map(1ms, 1ms, 100, false);
+    for (int i = 0; i < 1000; ++i) {
+        map.add_or_update_mapping(i, i);
+    }
+    std::this_thread::sleep_for(10ms);
+    std::size_t total = 0;
+    for (int round = 0; round < 10; ++round) {
+        const std::size_t removed = map.sweep();
+        EXPECT_LE(removed, 100u);
+        total += removed;
+    }
+    EXPECT_EQ(total, 1000u);
+    EXPECT_EQ(map.size(), 0u);
+    EXPECT_EQ(map.pending_expirations(), 0u);
+}
+
+TEST(ConcurrentTtlMapTest, BackgroundSweeper) {
+    concurrent_ttl_map<int, int> map(5ms, 1ms);
+    const int num_threads = 4;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < 5000; ++i) {
+                map.add_or_update_mapping(t * 5000 + i, i);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (map.size() != 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(5ms);
+    }
+    EXPECT_EQ(map.size(), 0u);
+}
@@ -0,0 +1,688 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <optional>
+#include <type_traits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "../concurrent_unordered_map_v1.hpp"
+
+TEST(ConcurrentUnorderedMapTest, BasicOperations) {
+    concurrent_unordered_map<int, std::string> map;
+    EXPECT_EQ(map.value_for(1, "none"), "none");
+
+    map.add_or_update_mapping(1, "one");
+    map.add_or_update_mapping(2, "two");
+    EXPECT_EQ(map.value_for(1), "one");
+    EXPECT_EQ(map.value_for(2), "two");
+    EXPECT_EQ(map.size(), 2u);
+
+    map.add_or_update_mapping(1, "uno");
+    EXPECT_EQ(map.value_for(1), "uno");
+    EXPECT_EQ(map.size(), 2u);
+
+    map.remove_mapping(1);
+    map.remove_mapping(42);
+    EXPECT_EQ(map.value_for(1, "none"), "none");
+    EXPECT_EQ(map.size(), 1u);
+}
+
+// 插入大量元素以后，桶的数量会自动增加，所有的元素都还能找到
+TEST(ConcurrentUnorderedMapTest, GrowsWithLoadFactor) {
+    concurrent_unordered_map<int, int> map(19);
+    const std::size_t initial_buckets = map.bucket_count();
+    const int count = 100000;
+    for (int i = 0; i < count; ++i) {
+        map.add_or_update_mapping(i, i * 2);
+    }
+    EXPECT_GT(map.bucket_count(), initial_buckets);
+    EXPECT_EQ(map.size(), static_cast<std::size_t>(count));
+    EXPECT_LE(map.load_factor(), 2 * map.max_load_factor());
+    for (int i = 0; i < count; ++i) {
+        ASSERT_EQ(map.value_for(i, -1), i * 2) << "key " << i;
+    }
+    EXPECT_EQ(map.get_map().size(), static_cast<std::size_t>(count));
+}
+
+TEST(ConcurrentUnorderedMapTest, ReserveMigratesEverything) {
+    concurrent_unordered_map<int, int> map(4);
+    for (int i = 0; i < 1000; ++i) {
+        map.add_or_update_mapping(i, i);
+    }
+    map.reserve(1 << 16);
+    EXPECT_GE(map.bucket_count(), static_cast<std::size_t>(1 << 16));
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_EQ(map.value_for(i, -1), i);
+    }
+}
+
+// 多个线程在扩容的过程中同时读写，读者不能丢失已经插入的元素
+TEST(ConcurrentUnorderedMapTest, ConcurrentInsertAndLookupDuringResize) {
+    concurrent_unordered_map<int, int> map(2);
+    const int num_writers = 4;
+    const int items_per_writer = 20000;
+    std::atomic<int> writers_done(0);
+    std::vector<std::thread> threads;
+
+    for (int w = 0; w < num_writers; ++w) {
+        threads.emplace_back([&, w]() {
+            for (int i = 0; i < items_per_writer; ++i) {
+                const int key = w * items_per_writer + i;
+                map.add_or_update_mapping(key, key);
+                // 刚插入的元素马上就要能读到
+                ASSERT_EQ(map.value_for(key, -1), key);
+                if (i % 3 == 0) {
+                    map.remove_mapping(key);
+                }
+            }
+            writers_done.fetch_add(1);
+        });
+    }
+    threads.emplace_back([&]() {
+        while (writers_done.load() < num_writers) {
+            auto snapshot = map.get_map();
+            for (const auto& [key, value] : snapshot) {
+                ASSERT_EQ(key, value);
+            }
+        }
+    });
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    std::size_t expected = 0;
+    for (int w = 0; w < num_writers; ++w) {
+        for (int i = 0; i < items_per_writer; ++i) {
+            const int key = w * items_per_writer + i;
+            if (i % 3 == 0) {
+                ASSERT_EQ(map.value_for(key, -1), -1);
+            } else {
+                ASSERT_EQ(map.value_for(key, -1), key);
+                ++expected;
+            }
+        }
+    }
+    EXPECT_EQ(map.size(), expected);
+    EXPECT_EQ(map.get_map().size(), expected);
+}
+
+// 两个字段总是同时被修改，乐观读如果读到了写了一半的数据，就会看到两个字段不相等
+struct paired_value {
+    long long first = 0;
+    long long second = 0;
+};
+
+TEST(ConcurrentUnorderedMapTest, OptimisticReadsNeverSeeTornValues) {
+    concurrent_unordered_map<int, paired_value> map(4);
+    const int num_keys = 64;
+    for (int i = 0; i < num_keys; ++i) {
+        map.add_or_update_mapping(i, paired_value{i, i});
+    }
+
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> threads;
+    for (int w = 0; w < 2; ++w) {
+        threads.emplace_back([&, w]() {
+            long long round = 0;
+            while (!stop.load()) {
+                for (int i = 0; i < num_keys; ++i) {
+                    ++round;
+                    if ((round + w) % 5 == 0) {
+                        map.remove_mapping(i);
+                    } else {
+                        map.add_or_update_mapping(i, paired_value{round, round});
+                    }
+                }
+                // 插入新的key，触发扩容与迁移
+                map.add_or_update_mapping(num_keys + static_cast<int>(round % 100000), paired_value{round, round});
+            }
+        });
+    }
+    for (int r = 0; r < 4; ++r) {
+        threads.emplace_back([&]() {
+            for (int iteration = 0; iteration < 200000; ++iteration) {
+                const paired_value value = map.value_for(iteration % num_keys, paired_value{-1, -1});
+                ASSERT_EQ(value.first, value.second);
+            }
+        });
+    }
+    for (std::size_t i = 2; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+    stop.store(true);
+    threads[0].join();
+    threads[1].join();
+
+    // 删除与插入复用结点以后，数据仍然正确
+    for (int i = 0; i < num_keys; ++i) {
+        map.add_or_update_mapping(i, paired_value{i * 3, i * 3});
+    }
+    for (int i = 0; i < num_keys; ++i) {
+        EXPECT_EQ(map.value_for(i).first, i * 3);
+    }
+}
+
+// 每个元素占用较多的内存，结点的内存比桶的内存多得多
+struct large_value {
+    int id;
+    char payload[1020];
+};
+
+// 大量删除以后，空闲的结点最多保留与链表长度相同的个数，其余的被释放，扩容时也不会全部集中到一个桶中
+TEST(ConcurrentUnorderedMapTest, DeletedNodesAreReclaimed) {
+    const int count = 20000;
+    concurrent_unordered_map<int, large_value> map;
+    map.reserve(count);
+    const std::size_t base = map.memory_usage();
+    for (int i = 0; i < count; ++i) {
+        map.add_or_update_mapping(i, large_value{i, {}});
+    }
+    const std::size_t full = map.memory_usage();
+    for (int i = 0; i < count; ++i) {
+        map.remove_mapping(i);
+    }
+    EXPECT_LT(map.memory_usage(), base + (full - base) / 10);
+
+    // 删除一部分以后扩容：迁移时释放等待复用的结点
+    for (int i = 0; i < count; ++i) {
+        map.add_or_update_mapping(i, large_value{i, {}});
+    }
+    for (int i = 0; i < count; i += 2) {
+        map.compute(i, [](std::optional<large_value>) -> std::optional<large_value> { return std::nullopt; });
+    }
+    const std::size_t half = map.memory_usage();
+    map.reserve(count * 8);
+    EXPECT_EQ(map.size(), static_cast<std::size_t>(count / 2));
+    for (int i = 0; i < count; ++i) {
+        ASSERT_EQ(map.value_for(i, large_value{-1, {}}).id, i % 2 == 0 ? -1 : i);
+    }
+    // 被删除的结点在删除时就已经释放，扩容只增加了桶的内存
+    EXPECT_LT(half, full - (full - base) / 3);
+    concurrent_unordered_map<int, large_value> reference;
+    reference.reserve(count);
+    const std::size_t small_buckets = reference.memory_usage();
+    reference.reserve(count * 8);
+    EXPECT_LE(map.memory_usage(), half + (reference.memory_usage() - small_buckets));
+}
+
+// 删除的结点被释放时，正在乐观读的读者不会访问到已经释放的内存（用-fsanitize=address编译时可以检查）
+TEST(ConcurrentUnorderedMapTest, OptimisticReadsDuringReclamation) {
+    concurrent_unordered_map<int, paired_value> map(64);
+    map.max_load_factor(1000.0f);
+    std::atomic<bool> stop(false);
+    std::thread writer([&]() {
+        for (int round = 1; round <= 200; ++round) {
+            for (int i = 0; i < 2000; ++i) {
+                map.add_or_update_mapping(i, paired_value{round, round});
+            }
+            for (int i = 0; i < 2000; ++i) {
+                map.remove_mapping(i);
+            }
+        }
+        stop.store(true);
+    });
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 3; ++r) {
+        readers.emplace_back([&, r]() {
+            int key = r;
+            while (!stop.load()) {
+                const paired_value value = map.value_for(key, paired_value{-1, -1});
+                ASSERT_EQ(value.first, value.second);
+                key = (key + 7) % 2000;
+            }
+        });
+    }
+    writer.join();
+    for (auto& t : readers) {
+        t.join();
+    }
+    EXPECT_EQ(map.size(), 0u);
+}
+
+TEST(ConcurrentUnorderedMapTest, VisitReadsInPlace) {
+    concurrent_unordered_map<int, std::vector<int>> map;
+    map.add_or_update_mapping(1, {1, 2, 3});
+    std::size_t length = 0;
+    EXPECT_TRUE(map.visit(1, [&](const std::vector<int>& value) { length = value.size(); }));
+    EXPECT_EQ(length, 3u);
+    EXPECT_FALSE(map.visit(2, [&](const std::vector<int>&) { FAIL(); }));
+}
+
+TEST(ConcurrentUnorderedMapTest, UpsertAndCompute) {
+    concurrent_unordered_map<std::string, int> map;
+    EXPECT_TRUE(map.upsert("a", [](int& count) { ++count; }));
+    EXPECT_FALSE(map.upsert("a", [](int& count) { ++count; }));
+    EXPECT_EQ(map.value_for("a"), 2);
+    EXPECT_EQ(map.size(), 1u);
+
+    // 不存在时插入
+    auto result = map.compute("b", [](std::optional<int> current) -> std::optional<int> {
+        EXPECT_FALSE(current.has_value());
+        return 10;
+    });
+    EXPECT_EQ(result, 10);
+    // 存在时修改
+    result = map.compute("b", [](std::optional<int> current) { return std::optional<int>(*current * 2); });
+    EXPECT_EQ(map.value_for("b"), 20);
+    EXPECT_EQ(map.size(), 2u);
+    // 返回nullopt时删除
+    result = map.compute("b", [](std::optional<int>) { return std::optional<int>(); });
+    EXPECT_FALSE(result.has_value());
+    EXPECT_EQ(map.value_for("b", -1), -1);
+    EXPECT_EQ(map.size(), 1u);
+}
+
+// 多个线程同时对同一批key计数，每一次递增都不能丢失
+TEST(ConcurrentUnorderedMapTest, ConcurrentUpsertCountsEveryIncrement) {
+    concurrent_unordered_map<int, long long> map(2);
+    const int num_threads = 4;
+    const int rounds = 20000;
+    const int num_keys = 100;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < rounds; ++i) {
+                map.upsert(i % num_keys, [](long long& count) { ++count; });
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    for (int key = 0; key < num_keys; ++key) {
+        EXPECT_EQ(map.value_for(key), num_threads * rounds / num_keys);
+    }
+}
+
+// 带有is_transparent的哈希函数，可以直接用std::string_view查找
+struct transparent_string_hash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view value) const {
+        return std::hash<std::string_view>()(value);
+    }
+};
+
+TEST(ConcurrentUnorderedMapTest, HeterogeneousLookup) {
+    concurrent_unordered_map<std::string, int, transparent_string_hash> map;
+    map.add_or_update_mapping("apple", 1);
+    map.add_or_update_mapping("banana", 2);
+    const std::string_view key = "apple";
+    EXPECT_EQ(map.value_for(key), 1);
+    int seen = 0;
+    EXPECT_TRUE(map.visit(std::string_view("banana"), [&](int value) { seen = value; }));
+    EXPECT_EQ(seen, 2);
+    map.remove_mapping(std::string_view("banana"));
+    EXPECT_EQ(map.value_for(std::string_view("banana"), -1), -1);
+    EXPECT_EQ(map.size(), 1u);
+}
+
+TEST(ConcurrentUnorderedMapTest, MultiGetAndMultiPut) {
+    concurrent_unordered_map<int, int> map(4);
+    std::vector<std::pair<int, int>> items;
+    for (int i = 0; i < 1000; ++i) {
+        items.emplace_back(i, i * 3);
+    }
+    // 重复的key，后面的覆盖前面的
+    items.emplace_back(7, -7);
+    map.multi_put(items);
+    EXPECT_EQ(map.size(), 1000u);
+    EXPECT_GT(map.bucket_count(), 4u);
+
+    std::vector<int> keys = {7, 0, 999, 1000, 500, 7};
+    const std::vector<int> values = map.multi_get(keys, -1);
+    EXPECT_EQ(values, (std::vector<int>{-7, 0, 2997, -1, 1500, -7}));
+}
+
+// 批量操作与扩容同时进行，落在已经迁移走的桶中的key也能正确处理
+TEST(ConcurrentUnorderedMapTest, BatchesDuringResize) {
+    concurrent_unordered_map<int, std::string> map(2);
+    const int num_threads = 4;
+    const int batches = 200;
+    const int batch_size = 64;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int b = 0; b < batches; ++b) {
+                std::vector<std::pair<int, std::string>> items;
+                std::vector<int> keys;
+                for (int i = 0; i < batch_size; ++i) {
+                    const int key = (t * batches + b) * batch_size + i;
+                    items.emplace_back(key, std::to_string(key));
+                    keys.push_back(key);
+                }
+                map.multi_put(items);
+                const std::vector<std::string> values = map.multi_get(keys);
+                for (int i = 0; i < batch_size; ++i) {
+                    ASSERT_EQ(values[i], std::to_string(keys[i]));
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(map.size(), static_cast<std::size_t>(num_threads * batches * batch_size));
+    EXPECT_EQ(map.get_map().size(), map.size());
+}
+
+TEST(ConcurrentUnorderedMapTest, ForEachAndSnapshots) {
+    concurrent_unordered_map<int, int> map(4);
+    for (int i = 0; i < 10000; ++i) {
+        map.add_or_update_mapping(i, i + 1);
+    }
+    long long sum = 0;
+    std::size_t count = 0;
+    map.for_each([&](const int& key, const int& value) {
+        EXPECT_EQ(value, key + 1);
+        sum += key;
+        ++count;
+    });
+    EXPECT_EQ(count, 10000u);
+    EXPECT_EQ(sum, 10000LL * 9999 / 2);
+
+    std::vector<std::pair<int, int>> snapshot;
+    map.snapshot_to(snapshot);
+    std::sort(snapshot.begin(), snapshot.end());
+    ASSERT_EQ(snapshot.size(), 10000u);
+    for (int i = 0; i < 10000; ++i) {
+        EXPECT_EQ(snapshot[i], std::make_pair(i, i + 1));
+    }
+
+    auto parallel = map.parallel_snapshot(4);
+    std::sort(parallel.begin(), parallel.end());
+    EXPECT_EQ(parallel, snapshot);
+}
+
+// 遍历与写入、扩容同时进行：遍历开始前就存在并且没有被删除的元素，必须正好被访问一次
+TEST(ConcurrentUnorderedMapTest, WeaklyConsistentIterationDuringResize) {
+    concurrent_unordered_map<int, int> map(2);
+    const int stable_keys = 5000;
+    for (int i = 0; i < stable_keys; ++i) {
+        map.add_or_update_mapping(i, i);
+    }
+    std::atomic<bool> stop(false);
+    std::thread writer([&]() {
+        int key = stable_keys;
+        while (!stop.load()) {
+            map.add_or_update_mapping(key, key);
+            if (key % 2 == 0) {
+                map.remove_mapping(key);
+            }
+            ++key;
+        }
+    });
+    for (int round = 0; round < 20; ++round) {
+        std::vector<int> seen(stable_keys, 0);
+        map.for_each([&](const int& key, const int& value) {
+            ASSERT_EQ(key, value);
+            if (key < stable_keys) {
+                ++seen[key];
+            }
+        });
+        for (int i = 0; i < stable_keys; ++i) {
+            ASSERT_EQ(seen[i], 1) << "key " << i;
+        }
+        auto snapshot = map.parallel_snapshot(3);
+        EXPECT_GE(snapshot.size(), static_cast<std::size_t>(stable_keys));
+    }
+    stop.store(true);
+    writer.join();
+}
+
+TEST(ConcurrentUnorderedMapTest, BulkInsert) {
+    concurrent_unordered_map<int, int> map(2);
+    map.add_or_update_mapping(-1, -1);
+    map.add_or_update_mapping(5, 0);
+    std::vector<std::pair<int, int>> items;
+    for (int i = 0; i < 100000; ++i) {
+        items.emplace_back(i, i * 2);
+    }
+    // 重复的key以最后一个为准
+    items.emplace_back(5, 55);
+    map.bulk_insert(items.begin(), items.end(), 4);
+    EXPECT_EQ(map.size(), 100001u);
+    for (int i = 0; i < 100000; ++i) {
+        ASSERT_EQ(map.value_for(i, -2), i == 5 ? 55 : i * 2);
+    }
+    EXPECT_EQ(map.value_for(-1), -1);
+}
+
+// 只提供commit的执行器，记录提交的任务数
+struct counting_executor {
+    std::atomic<int> committed{0};
+    template<typename Function>
+    std::future<void> commit(Function f) {
+        committed.fetch_add(1);
+        return std::async(std::launch::async, std::move(f));
+    }
+};
+
+TEST(ConcurrentUnorderedMapTest, ParallelForEachAndReduce) {
+    concurrent_unordered_map<int, int> map;
+    for (int i = 1; i <= 10000; ++i) {
+        map.add_or_update_mapping(i, i);
+    }
+    std::atomic<long long> sum(0);
+    map.parallel_for_each([&](const int& key, const int& value) {
+        EXPECT_EQ(key, value);
+        sum.fetch_add(value);
+    }, 4);
+    EXPECT_EQ(sum.load(), 10000LL * 10001 / 2);
+
+    const long long total = map.parallel_reduce(0LL, [](const int&, const int& value) { return static_cast<long long>(value); },
+                                                [](long long a, long long b) { return a + b; }, 3);
+    EXPECT_EQ(total, 10000LL * 10001 / 2);
+
+    counting_executor executor;
+    const int max_value = map.parallel_reduce(0, [](const int&, const int& value) { return value; },
+                                              [](int a, int b) { return std::max(a, b); }, executor, 4);
+    EXPECT_EQ(max_value, 10000);
+    // 第一个任务由当前线程执行
+    EXPECT_EQ(executor.committed.load(), 3);
+
+    concurrent_unordered_map<int, int> copy;
+    std::vector<std::pair<int, int>> items(map.parallel_snapshot(2));
+    copy.bulk_insert(items.begin(), items.end(), executor, 4);
+    EXPECT_EQ(copy.size(), 10000u);
+    EXPECT_EQ(copy.value_for(1234), 1234);
+}
+
+// 在后台线程中稍后才运行任务的执行器，返回的future析构时不会等待（与线程池相同）
+struct delayed_executor {
+    std::atomic<int> committed{0};
+    std::vector<std::jthread> threads;
+    template<typename Function>
+    std::future<void> commit(Function f) {
+        committed.fetch_add(1);
+        std::packaged_task<void()> task(std::move(f));
+        std::future<void> future = task.get_future();
+        threads.emplace_back([task = std::move(task)]() mutable {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            task();
+        });
+        return future;
+    }
+};
+
+// 当前线程中的任务抛出异常时，也要等其他任务结束才离开，否则它们会访问已经销毁的f
+TEST(ConcurrentUnorderedMapTest, ParallelForEachWaitsForTasksOnException) {
+    concurrent_unordered_map<int, int> map;
+    for (int i = 0; i < 10000; ++i) {
+        map.add_or_update_mapping(i, i);
+    }
+    delayed_executor executor;
+    const std::thread::id caller = std::this_thread::get_id();
+    std::atomic<int> visited(0);
+    EXPECT_THROW(map.parallel_for_each([&](const int&, const int&) {
+        if (std::this_thread::get_id() == caller) {
+            throw std::runtime_error("task 0");
+        }
+        visited.fetch_add(1);
+    }, executor, 4), std::runtime_error);
+    EXPECT_EQ(executor.committed.load(), 3);
+    // 返回时所有的后台任务都已经结束，访问的元素个数不再变化
+    const int seen = visited.load();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(visited.load(), seen);
+    EXPECT_GT(seen, 0);
+}
+
+TEST(ConcurrentUnorderedMapTest, Freeze) {
+    concurrent_unordered_map<int, int> map;
+    for (int i = 0; i < 10000; ++i) {
+        map.add_or_update_mapping(i, i * 3);
+    }
+    auto frozen = map.freeze();
+    EXPECT_EQ(frozen->size(), 10000u);
+    EXPECT_GE(frozen->bucket_count(), 10000u);
+    // 冻结以后的修改不影响结果
+    map.add_or_update_mapping(1, -1);
+    map.remove_mapping(2);
+
+    std::vector<std::thread> readers;
+    std::atomic<int> errors(0);
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&, t]() {
+            for (int i = t; i < 10000; i += 4) {
+                if (frozen->value_for(i, -1) != i * 3 || !frozen->contains(i)) {
+                    errors.fetch_add(1);
+                }
+            }
+        });
+    }
+    for (auto& r : readers) {
+        r.join();
+    }
+    EXPECT_EQ(errors.load(), 0);
+    EXPECT_EQ(frozen->find(10000), nullptr);
+    EXPECT_EQ(frozen->value_for(-5, 7), 7);
+    long long total = 0;
+    frozen->for_each([&](const int&, const int& value) { total += value; });
+    EXPECT_EQ(total, 3LL * 9999 * 10000 / 2);
+
+    concurrent_unordered_map<std::string, int, transparent_string_hash> words;
+    words.add_or_update_mapping("apple", 1);
+    words.add_or_update_mapping("banana", 2);
+    auto frozen_words = words.freeze();
+    EXPECT_EQ(frozen_words->value_for(std::string_view("banana")), 2);
+    ASSERT_NE(frozen_words->find(std::string_view("apple")), nullptr);
+    EXPECT_EQ(*frozen_words->find(std::string_view("apple")), 1);
+
+    concurrent_unordered_map<int, int> empty;
+    EXPECT_EQ(empty.freeze()->value_for(1, -1), -1);
+}
+
+TEST(ConcurrentUnorderedMapTest, TransactBasics) {
+    concurrent_unordered_map<std::string, int> map;
+    map.add_or_update_mapping("a", 10);
+    map.add_or_update_mapping("b", 20);
+
+    const int sum = map.transact({"a", "c"}, {"b"}, [](auto& tx) {
+        EXPECT_FALSE(tx.contains("c"));
+        tx.set("c", tx.value_for("a") + tx.value_for("b"));
+        tx.erase("a");
+        EXPECT_EQ(tx.get("c"), 30);
+        EXPECT_THROW(tx.set("b", 0), std::logic_error);
+        EXPECT_THROW(tx.get("x"), std::out_of_range);
+        return *tx.get("c");
+    });
+    EXPECT_EQ(sum, 30);
+    EXPECT_EQ(map.value_for("a", -1), -1);
+    EXPECT_EQ(map.value_for("c", -1), 30);
+    EXPECT_EQ(map.size(), 2u);
+
+    // f抛出异常时不会有任何修改
+    EXPECT_THROW(map.transact({"b", "c"}, [](auto& tx) {
+        tx.set("b", 0);
+        tx.erase("c");
+        throw std::runtime_error("abort");
+    }), std::runtime_error);
+    EXPECT_EQ(map.value_for("b", -1), 20);
+    EXPECT_EQ(map.value_for("c", -1), 30);
+}
+
+// f返回引用时transact仍然按值返回，不会返回指向视图或者f内部的悬空引用
+TEST(ConcurrentUnorderedMapTest, TransactReturnsByValue) {
+    concurrent_unordered_map<std::string, std::string> map;
+    map.add_or_update_mapping("a", "alpha");
+    std::string last_read;
+    auto&& result = map.transact({"a"}, [&](auto& tx) -> const std::string& {
+        last_read = tx.value_for("a");
+        tx.set("a", "beta");
+        return last_read;
+    });
+    static_assert(std::is_same_v<decltype(result), std::string&&>);
+    last_read.clear();
+    EXPECT_EQ(result, "alpha");
+    EXPECT_EQ(map.value_for("a"), "beta");
+}
+
+// 多个线程同时在账户之间转账，同时不断插入其他元素触发扩容，总金额始终不变
+TEST(ConcurrentUnorderedMapTest, ConcurrentTransfers) {
+    concurrent_unordered_map<int, long long> map(2);
+    const int accounts = 16;
+    for (int i = 0; i < accounts; ++i) {
+        map.add_or_update_mapping(i, 1000);
+    }
+    std::atomic<bool> done(false);
+    std::atomic<int> bad_totals(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t]() {
+            unsigned seed = 17u + static_cast<unsigned>(t);
+            for (int i = 0; i < 5000; ++i) {
+                seed = seed * 1664525u + 1013904223u;
+                const int from = static_cast<int>(seed % accounts);
+                const int to = static_cast<int>((seed >> 8) % accounts);
+                map.transact({from, to}, [&](auto& tx) {
+                    const long long amount = static_cast<long long>(seed % 50);
+                    tx.set(from, tx.value_for(from) - amount);
+                    tx.set(to, tx.value_for(to) + amount);
+                });
+            }
+        });
+    }
+    // 只读的事务在同一时刻看到所有账户，总金额一定正确
+    threads.emplace_back([&]() {
+        std::vector<int> all;
+        for (int i = 0; i < accounts; ++i) {
+            all.push_back(i);
+        }
+        while (!done.load()) {
+            const long long total = map.transact({}, all, [&](auto& tx) {
+                long long result = 0;
+                for (int i = 0; i < accounts; ++i) {
+                    result += tx.value_for(i);
+                }
+                return result;
+            });
+            if (total != 1000LL * accounts) {
+                bad_totals.fetch_add(1);
+            }
+        }
+    });
+    std::thread grower([&]() {
+        for (int i = 0; i < 50000; ++i) {
+            map.add_or_update_mapping(accounts + i, 0);
+        }
+    });
+    grower.join();
+    for (int t = 0; t < 4; ++t) {
+        threads[t].join();
+    }
+    done.store(true);
+    threads.back().join();
+    EXPECT_EQ(bad_totals.load(), 0);
+    long long total = 0;
+    for (int i = 0; i < accounts; ++i) {
+        total += map.value_for(i);
+    }
+    EXPECT_EQ(total, 1000LL * accounts);
+    EXPECT_EQ(map.size(), static_cast<std::size_t>(accounts + 50000));
+}
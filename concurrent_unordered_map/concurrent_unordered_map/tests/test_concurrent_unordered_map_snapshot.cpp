@@ -0,0 +1,124 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "../concurrent_unordered_map_snapshot.hpp"
+
+// 测试结束时删除临时文件
+struct temp_file {
+    std::string path;
+    explicit temp_file(const std::string& name) : path(testing::TempDir() + name) {}
+    ~temp_file() {
+        std::remove(path.c_str());
+    }
+};
+
+struct point {
+    int x;
+    double y;
+};
+
+TEST(ConcurrentUnorderedMapSnapshotTest, SaveAndLoad) {
+    temp_file file("cumap_snapshot_roundtrip.bin");
+    concurrent_unordered_map<int, point> source;
+    for (int i = 0; i < 100000; ++i) {
+        source.add_or_update_mapping(i, point{i, i * 0.5});
+    }
+    ASSERT_TRUE(save_snapshot(source, file.path));
+
+    concurrent_unordered_map<int, point> target(2);
+    target.add_or_update_mapping(-1, point{-1, -1.0});
+    ASSERT_TRUE(load_snapshot(target, file.path, 4));
+    EXPECT_EQ(target.size(), 100001u);
+    EXPECT_GE(target.bucket_count(), 100000u);
+    for (int i = 0; i < 100000; ++i) {
+        const point p = target.value_for(i, point{0, 0});
+        ASSERT_EQ(p.x, i);
+        ASSERT_EQ(p.y, i * 0.5);
+    }
+    EXPECT_EQ(target.value_for(-1).x, -1);
+}
+
+// 没有默认构造函数，但是可以按字节复制
+struct weight {
+    explicit weight(int value_) : value(value_) {}
+    int value;
+};
+
+TEST(ConcurrentUnorderedMapSnapshotTest, NonDefaultConstructibleValue) {
+    temp_file file("cumap_snapshot_weight.bin");
+    concurrent_unordered_map<int, weight> source;
+    for (int i = 0; i < 1000; ++i) {
+        source.add_or_update_mapping(i, weight(i * 3));
+    }
+    ASSERT_TRUE(save_snapshot(source, file.path));
+    concurrent_unordered_map<int, weight> target;
+    ASSERT_TRUE(load_snapshot(target, file.path, 2));
+    EXPECT_EQ(target.size(), 1000u);
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_EQ(target.value_for(i, weight(-1)).value, i * 3);
+    }
+}
+
+// 写入失败时不会覆盖上一次的快照，也不会留下临时文件
+TEST(ConcurrentUnorderedMapSnapshotTest, FailedSaveKeepsPreviousSnapshot) {
+    temp_file file("cumap_snapshot_keep.bin");
+    concurrent_unordered_map<int, int> source;
+    for (int i = 0; i < 100; ++i) {
+        source.add_or_update_mapping(i, i);
+    }
+    ASSERT_TRUE(save_snapshot(source, file.path));
+    EXPECT_FALSE(std::filesystem::exists(file.path + ".tmp"));
+
+    // 临时文件的位置被一个目录占用，无法写入
+    std::filesystem::create_directory(file.path + ".tmp");
+    concurrent_unordered_map<int, int> empty;
+    EXPECT_FALSE(save_snapshot(empty, file.path));
+    std::filesystem::remove(file.path + ".tmp");
+
+    concurrent_unordered_map<int, int> target;
+    ASSERT_TRUE(load_snapshot(target, file.path));
+    EXPECT_EQ(target.size(), 100u);
+}
+
+TEST(ConcurrentUnorderedMapSnapshotTest, EmptyMap) {
+    temp_file file("cumap_snapshot_empty.bin");
+    concurrent_unordered_map<int, int> source;
+    ASSERT_TRUE(save_snapshot(source, file.path));
+    concurrent_unordered_map<int, int> target;
+    ASSERT_TRUE(load_snapshot(target, file.path));
+    EXPECT_EQ(target.size(), 0u);
+}
+
+TEST(ConcurrentUnorderedMapSnapshotTest, RejectsInvalidFiles) {
+    concurrent_unordered_map<int, int> map;
+    EXPECT_FALSE(load_snapshot(map, testing::TempDir() + "cumap_snapshot_missing.bin"));
+
+    // 类型的大小不一致
+    temp_file file("cumap_snapshot_types.bin");
+    concurrent_unordered_map<int, long long> wide;
+    wide.add_or_update_mapping(1, 1);
+    ASSERT_TRUE(save_snapshot(wide, file.path));
+    EXPECT_FALSE(load_snapshot(map, file.path));
+
+    // 文件被截断
+    temp_file truncated("cumap_snapshot_truncated.bin");
+    concurrent_unordered_map<int, int> source;
+    for (int i = 0; i < 10; ++i) {
+        source.add_or_update_mapping(i, i);
+    }
+    ASSERT_TRUE(save_snapshot(source, truncated.path));
+    std::string content;
+    {
+        std::ifstream in(truncated.path, std::ios::binary);
+        content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    {
+        std::ofstream out(truncated.path, std::ios::binary | std::ios::trunc);
+        out.write(content.data(), static_cast<std::streamsize>(content.size() - 4));
+    }
+    EXPECT_FALSE(load_snapshot(map, truncated.path));
+    EXPECT_EQ(map.size(), 0u);
+}
@@ -0,0 +1,90 @@
+// 开启统计功能以后单独编译，不能与没有开启统计的测试链接到同一个程序中
+// CMake已经通过target_compile_definitions定义了这个宏，这里只是为了单独编译这个文件时也能开启
+#ifndef CONCURRENT_UNORDERED_MAP_STATS
+#define CONCURRENT_UNORDERED_MAP_STATS
+#endif
+
+#include <atomic>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "../concurrent_unordered_map_v1.hpp"
+
+TEST(ConcurrentUnorderedMapStatsTest, ChainLengthHistogram) {
+    concurrent_unordered_map<int, int> map(1024);
+    for (int i = 0; i < 500; ++i) {
+        map.add_or_update_mapping(i, i);
+    }
+    const concurrent_unordered_map_stats stats = map.stats(4, 8);
+    EXPECT_EQ(stats.size, 500u);
+    EXPECT_EQ(stats.bucket_count, 1024u);
+    ASSERT_EQ(stats.chain_length_histogram.size(), 8u);
+    EXPECT_EQ(std::accumulate(stats.chain_length_histogram.begin(), stats.chain_length_histogram.end(), std::size_t(0)),
+              1024u);
+    EXPECT_GE(stats.max_chain_length, 1u);
+    // 每次插入加一次锁
+    EXPECT_EQ(stats.lock_count, 500u);
+    EXPECT_LE(stats.hot_buckets.size(), 4u);
+}
+
+// 所有key的哈希值都相同：所有的元素都在同一个桶中，这个桶也是唯一被加锁的桶
+struct constant_hash {
+    std::size_t operator()(int) const {
+        return 0;
+    }
+};
+
+TEST(ConcurrentUnorderedMapStatsTest, DetectsBadHashAndHotBucket) {
+    concurrent_unordered_map<int, int, constant_hash> map(64);
+    // 不让它扩容，否则统计会从新表重新开始
+    map.max_load_factor(1000.0f);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < 200; ++i) {
+                map.add_or_update_mapping(t * 200 + i, i);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    const concurrent_unordered_map_stats stats = map.stats(3, 16);
+    EXPECT_EQ(stats.max_chain_length, 800u);
+    EXPECT_EQ(stats.chain_length_histogram[0], 63u);
+    EXPECT_EQ(stats.chain_length_histogram[15], 1u);
+    ASSERT_EQ(stats.hot_buckets.size(), 1u);
+    EXPECT_EQ(stats.hot_buckets[0].chain_length, 800u);
+    EXPECT_EQ(stats.hot_buckets[0].lock_count, 800u);
+    EXPECT_EQ(stats.lock_count, 800u);
+
+    map.reset_stats();
+    EXPECT_EQ(map.stats().lock_count, 0u);
+}
+
+// 扩容期间收集统计：新表中还在被迁移的桶不会被读取（用-fsanitize=thread编译时可以检查）
+TEST(ConcurrentUnorderedMapStatsTest, StatsDuringResize) {
+    concurrent_unordered_map<int, int> map(2);
+    std::atomic<bool> done(false);
+    std::thread writer([&]() {
+        for (int i = 0; i < 100000; ++i) {
+            map.add_or_update_mapping(i, i);
+        }
+        done.store(true);
+    });
+    std::size_t rounds = 0;
+    while (!done.load()) {
+        // size()与各个桶不是同时读取的，这里只检查不依赖读取时机的条件
+        const concurrent_unordered_map_stats stats = map.stats(2, 4);
+        EXPECT_LE(stats.max_chain_length, 100000u);
+        ++rounds;
+    }
+    writer.join();
+    EXPECT_GT(rounds, 0u);
+    const concurrent_unordered_map_stats stats = map.stats();
+    EXPECT_EQ(stats.size, 100000u);
+    EXPECT_EQ(std::accumulate(stats.chain_length_histogram.begin(), stats.chain_length_histogram.end(), std::size_t(0)),
+              stats.bucket_count);
+}
@@ -0,0 +1,119 @@
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "../split_ordered_map.hpp"
+
+TEST(SplitOrderedMapTest, BasicOperations) {
+    split_ordered_map<int, std::string> map;
+    EXPECT_EQ(map.value_for(1, "none"), "none");
+
+    map.add_or_update_mapping(1, "one");
+    map.add_or_update_mapping(2, "two");
+    EXPECT_EQ(map.value_for(1), "one");
+    EXPECT_EQ(map.value_for(2), "two");
+    EXPECT_EQ(map.size(), 2u);
+
+    map.add_or_update_mapping(1, "uno");
+    EXPECT_EQ(map.value_for(1), "uno");
+    EXPECT_EQ(map.size(), 2u);
+
+    map.remove_mapping(1);
+    map.remove_mapping(42);
+    EXPECT_EQ(map.value_for(1, "none"), "none");
+    EXPECT_EQ(map.size(), 1u);
+}
+
+// 桶的数量翻倍时不移动任何结点，只是在第一次访问新桶时插入哨兵结点
+TEST(SplitOrderedMapTest, GrowsWithoutMovingNodes) {
+    split_ordered_map<int, int> map(2);
+    const int count = 100000;
+    for (int i = 0; i < count; ++i) {
+        map.add_or_update_mapping(i, i * 2);
+    }
+    EXPECT_GE(map.bucket_count(), static_cast<std::size_t>(count / 2));
+    EXPECT_EQ(map.size(), static_cast<std::size_t>(count));
+    for (int i = 0; i < count; ++i) {
+        ASSERT_EQ(map.value_for(i, -1), i * 2) << "key " << i;
+    }
+    for (int i = 0; i < count; i += 2) {
+        map.remove_mapping(i);
+    }
+    for (int i = 0; i < count; ++i) {
+        ASSERT_EQ(map.value_for(i, -1), i % 2 == 0 ? -1 : i * 2);
+    }
+    EXPECT_EQ(map.size(), static_cast<std::size_t>(count / 2));
+}
+
+// 所有key的哈希值都相同，它们都排在同一个位置上，依靠key本身区分
+struct constant_hash {
+    std::size_t operator()(int) const {
+        return 7;
+    }
+};
+
+TEST(SplitOrderedMapTest, HashCollisions) {
+    split_ordered_map<int, int, constant_hash> map;
+    for (int i = 0; i < 100; ++i) {
+        map.add_or_update_mapping(i, i);
+    }
+    map.remove_mapping(50);
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(map.value_for(i, -1), i == 50 ? -1 : i);
+    }
+    EXPECT_EQ(map.size(), 99u);
+}
+
+// 多个线程同时插入、更新、删除与查找，读者要么读到完整的值，要么读不到
+TEST(SplitOrderedMapTest, ConcurrentMixedOperations) {
+    split_ordered_map<int, std::string> map(2);
+    const int num_writers = 4;
+    const int items_per_writer = 20000;
+    std::atomic<int> writers_done(0);
+    std::vector<std::thread> threads;
+
+    for (int w = 0; w < num_writers; ++w) {
+        threads.emplace_back([&, w]() {
+            for (int i = 0; i < items_per_writer; ++i) {
+                const int key = w * items_per_writer + i;
+                map.add_or_update_mapping(key, std::to_string(key));
+                ASSERT_EQ(map.value_for(key), std::to_string(key));
+                if (i % 3 == 0) {
+                    map.remove_mapping(key);
+                } else if (i % 3 == 1) {
+                    map.add_or_update_mapping(key, std::to_string(-key));
+                }
+            }
+            writers_done.fetch_add(1);
+        });
+    }
+    threads.emplace_back([&]() {
+        unsigned seed = 1;
+        while (writers_done.load() < num_writers) {
+            seed = seed * 1664525u + 1013904223u;
+            const int key = static_cast<int>(seed % (num_writers * items_per_writer));
+            const std::string value = map.value_for(key, "missing");
+            ASSERT_TRUE(value == "missing" || value == std::to_string(key) || value == std::to_string(-key))
+                << value;
+        }
+    });
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    std::size_t expected = 0;
+    for (int w = 0; w < num_writers; ++w) {
+        for (int i = 0; i < items_per_writer; ++i) {
+            const int key = w * items_per_writer + i;
+            if (i % 3 == 0) {
+                ASSERT_EQ(map.value_for(key, "missing"), "missing");
+            } else {
+                ASSERT_EQ(map.value_for(key), std::to_string(i % 3 == 1 ? -key : key));
+                ++expected;
+            }
+        }
+    }
+    EXPECT_EQ(map.size(), expected);
+}
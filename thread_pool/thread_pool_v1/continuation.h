@@ -0,0 +1,277 @@
+//
+// Created by ghost-him on 25-5-15.
+//
+
+#ifndef CONTINUATION_H
+#define CONTINUATION_H
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "parallel_for.h"
+#include "unique_task.h"
+#include "worker_group.h"
+
+namespace thread_pool_v1 {
+
+    namespace detail {
+        /// task_future的共享状态：结果或者异常，以及完成以后要运行的后续任务
+        template <typename T>
+        struct future_state {
+            using stored_type = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+            explicit future_state(worker_group* group_) : group(group_) {}
+
+            /// 后续任务提交到这个线程组，等待时也帮这个线程组运行任务；为空时后续任务直接在完成的线程中运行
+            worker_group* group;
+            std::atomic<bool> ready = false;
+            std::optional<stored_type> value;
+            std::exception_ptr error;
+
+            std::mutex lock;
+            /// 完成以后要运行的后续任务，second为true时直接在完成的线程中运行（只做很少的工作，比如when_all的计数）
+            std::vector<std::pair<unique_task, bool>> continuations;
+
+            template <typename... Args>
+            void set_value(Args&&... args) {
+                value.emplace(std::forward<Args>(args)...);
+                complete();
+            }
+
+            void set_error(std::exception_ptr exception) {
+                error = std::move(exception);
+                complete();
+            }
+
+            /// 完成以后运行continuation，已经完成时立即运行
+            void on_ready(unique_task continuation, bool run_inline = false) {
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    if (!ready.load(std::memory_order_relaxed)) {
+                        continuations.emplace_back(std::move(continuation), run_inline);
+                        return;
+                    }
+                }
+                dispatch(continuation, run_inline);
+            }
+
+        private:
+            void complete() {
+                std::vector<std::pair<unique_task, bool>> pending;
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    ready.store(true, std::memory_order_release);
+                    pending.swap(continuations);
+                }
+                ready.notify_all();
+                if (group != nullptr) {
+                    group->notify_helpers();
+                }
+                for (auto& [continuation, run_inline]: pending) {
+                    dispatch(continuation, run_inline);
+                }
+            }
+
+            void dispatch(unique_task& continuation, bool run_inline) {
+                if (run_inline || group == nullptr) {
+                    continuation();
+                } else {
+                    group->submit(std::move(continuation));
+                }
+            }
+        };
+
+        /// 运行function，把返回值或者抛出的异常写入state
+        template <typename T, typename F>
+        void fulfill(future_state<T>& state, F&& function) {
+            try {
+                if constexpr (std::is_void_v<T>) {
+                    std::forward<F>(function)();
+                    state.set_value();
+                } else {
+                    state.set_value(std::forward<F>(function)());
+                }
+            } catch (...) {
+                state.set_error(std::current_exception());
+            }
+        }
+
+        template <typename T, typename F>
+        struct continuation_result {
+            using type = std::invoke_result_t<F&, const T&>;
+        };
+
+        template <typename F>
+        struct continuation_result<void, F> {
+            using type = std::invoke_result_t<F&>;
+        };
+    }
+
+    /// 可以添加后续任务的future
+    /// 与std::future不同：
+    ///   * then(f)在结果就绪以后把f作为一个新任务提交到线程组中，不需要任何线程阻塞等待
+    ///   * 可以复制，多个副本共享同一个结果，get()返回结果的引用，可以多次调用
+    ///   * get()/wait()在等待时帮忙运行线程组中的任务，在工作线程中调用也不会占住这个线程
+    template <typename T>
+    class task_future {
+    public:
+        using value_type = T;
+
+        task_future() = default;
+
+        explicit task_future(std::shared_ptr<detail::future_state<T>> state) : m_state(std::move(state)) {}
+
+        bool valid() const {
+            return m_state != nullptr;
+        }
+
+        bool ready() const {
+            return m_state->ready.load(std::memory_order_acquire);
+        }
+
+        void wait() const {
+            detail::future_state<T>& state = *m_state;
+            detail::help_until(state.group, [&state]() {
+                return state.ready.load(std::memory_order_acquire);
+            }, [&state]() {
+                state.ready.wait(false, std::memory_order_acquire);
+            });
+        }
+
+        /// 等待结果，任务抛出的异常在这里重新抛出
+        std::add_lvalue_reference_t<const T> get() const requires (!std::is_void_v<T>) {
+            wait();
+            if (m_state->error) {
+                std::rethrow_exception(m_state->error);
+            }
+            return *m_state->value;
+        }
+
+        void get() const requires std::is_void_v<T> {
+            wait();
+            if (m_state->error) {
+                std::rethrow_exception(m_state->error);
+            }
+        }
+
+        /// 结果就绪以后以function(结果)（T为void时是function()）运行，返回function的结果的future
+        /// 这个future失败时不运行function，异常直接传给返回的future
+        template <typename F>
+        auto then(F&& function) const -> task_future<typename detail::continuation_result<T, std::decay_t<F>>::type> {
+            using result_type = typename detail::continuation_result<T, std::decay_t<F>>::type;
+            auto next = std::make_shared<detail::future_state<result_type>>(m_state->group);
+            m_state->on_ready([previous = m_state, next, function = std::forward<F>(function)]() mutable {
+                if (previous->error) {
+                    next->set_error(previous->error);
+                    return;
+                }
+                detail::fulfill(*next, [&]() -> result_type {
+                    if constexpr (std::is_void_v<T>) {
+                        return function();
+                    } else {
+                        return function(std::as_const(*previous->value));
+                    }
+                });
+            });
+            return task_future<result_type>(std::move(next));
+        }
+
+        /// 完成以后在完成的线程中直接运行continuation，只给when_all、when_any这样只做很少工作的组合使用
+        void on_ready_inline(unique_task continuation) const {
+            m_state->on_ready(std::move(continuation), true);
+        }
+
+        worker_group* group() const {
+            return m_state->group;
+        }
+
+    private:
+        std::shared_ptr<detail::future_state<T>> m_state;
+    };
+
+    /// 在group中运行function，返回它的结果的task_future
+    template <typename F>
+    auto spawn(worker_group& group, F&& function) -> task_future<std::invoke_result_t<std::decay_t<F>&>> {
+        using result_type = std::invoke_result_t<std::decay_t<F>&>;
+        auto state = std::make_shared<detail::future_state<result_type>>(&group);
+        group.submit([state, function = std::forward<F>(function)]() mutable {
+            detail::fulfill(*state, function);
+        });
+        return task_future<result_type>(std::move(state));
+    }
+
+    /// 所有的future都完成以后完成，结果按顺序放在vector中（T为void时没有结果）
+    /// 只要有一个失败，就以第一个失败的future（按下标）的异常失败
+    template <typename T>
+    auto when_all(const std::vector<task_future<T>>& futures)
+        -> task_future<std::conditional_t<std::is_void_v<T>, void, std::vector<T>>> {
+        using result_type = std::conditional_t<std::is_void_v<T>, void, std::vector<T>>;
+        auto result = std::make_shared<detail::future_state<result_type>>(futures.empty() ? nullptr : futures.front().group());
+        if (futures.empty()) {
+            if constexpr (std::is_void_v<T>) {
+                result->set_value();
+            } else {
+                result->set_value(std::vector<T>());
+            }
+            return task_future<result_type>(std::move(result));
+        }
+        // 所有的后续任务共享输入与计数器，最后一个完成的负责收集结果
+        struct gather {
+            std::vector<task_future<T>> inputs;
+            std::atomic<size_t> remaining;
+        };
+        auto shared = std::make_shared<gather>(futures, futures.size());
+        for (const auto& future: futures) {
+            future.on_ready_inline([result, shared]() {
+                if (shared->remaining.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+                    return;
+                }
+                detail::fulfill(*result, [&shared]() -> result_type {
+                    if constexpr (std::is_void_v<T>) {
+                        for (const auto& input: shared->inputs) {
+                            input.get();
+                        }
+                    } else {
+                        std::vector<T> values;
+                        values.reserve(shared->inputs.size());
+                        for (const auto& input: shared->inputs) {
+                            values.push_back(input.get());
+                        }
+                        return values;
+                    }
+                });
+            });
+        }
+        return task_future<result_type>(std::move(result));
+    }
+
+    /// 任意一个future完成（成功或者失败）时完成，结果是它的下标，可以再通过futures[index].get()取得结果
+    /// 没有输入时永远不会完成，所以抛出std::invalid_argument
+    template <typename T>
+    task_future<size_t> when_any(const std::vector<task_future<T>>& futures) {
+        if (futures.empty()) {
+            throw std::invalid_argument("when_any: no futures");
+        }
+        auto result = std::make_shared<detail::future_state<size_t>>(futures.front().group());
+        auto claimed = std::make_shared<std::atomic<bool>>(false);
+        for (size_t i = 0; i < futures.size(); i++) {
+            futures[i].on_ready_inline([result, claimed, i]() {
+                if (!claimed->exchange(true, std::memory_order_acq_rel)) {
+                    result->set_value(i);
+                }
+            });
+        }
+        return task_future<size_t>(std::move(result));
+    }
+
+} // thread_pool_v1
+
+#endif //CONTINUATION_H
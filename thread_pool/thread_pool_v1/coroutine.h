@@ -0,0 +1,378 @@
+//
+// Created by ghost-him on 25-5-15.
+//
+
+#ifndef COROUTINE_H
+#define COROUTINE_H
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "continuation.h"
+#include "worker_group.h"
+
+namespace thread_pool_v1 {
+
+    /// co_await schedule(group)：把当前协程挂起，然后作为一个任务在group的工作线程中继续运行
+    /// 任务只保存协程的句柄（一个指针），提交时不分配内存
+    template <typename Group>
+    class schedule_awaiter {
+    public:
+        explicit schedule_awaiter(Group& group) : m_group(group) {}
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        /// 提交以后协程可能马上在其他线程中恢复运行甚至结束，之后不能再访问this
+        void await_suspend(std::coroutine_handle<> handle) {
+            m_group.submit([handle]() {
+                handle.resume();
+            });
+        }
+
+        void await_resume() const noexcept {}
+
+    private:
+        Group& m_group;
+    };
+
+    template <typename Group>
+    schedule_awaiter<Group> schedule(Group& group) {
+        return schedule_awaiter<Group>(group);
+    }
+
+    template <typename T = void>
+    class task;
+
+    namespace detail {
+        /// 协程结束时直接在结束的线程中恢复等待它的协程，不经过队列
+        /// 不使用对称转移：编译器没有把它优化为尾调用时（比如没有开优化或者开了sanitizer），
+        /// 一长串同步完成的co_await会让栈越来越深。改为与等待的一方各自交换一次标记，后到的一方负责恢复：
+        /// 子协程同步完成时由等待的一方直接继续运行（await_suspend返回false），异步完成时由这里恢复
+        struct final_awaiter {
+            bool await_ready() const noexcept {
+                return false;
+            }
+
+            template <typename Promise>
+            void await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+                auto& promise = handle.promise();
+                if (promise.handoff.exchange(true, std::memory_order_acq_rel)) {
+                    promise.continuation.resume();
+                }
+            }
+
+            void await_resume() const noexcept {}
+        };
+
+        struct task_promise_base {
+            /// 等待这个task的协程
+            std::coroutine_handle<> continuation;
+            /// 见final_awaiter
+            std::atomic<bool> handoff = false;
+            std::exception_ptr error;
+
+            /// 惰性启动：被co_await时才开始运行
+            std::suspend_always initial_suspend() const noexcept {
+                return {};
+            }
+
+            final_awaiter final_suspend() const noexcept {
+                return {};
+            }
+
+            void unhandled_exception() noexcept {
+                error = std::current_exception();
+            }
+        };
+
+        template <typename T>
+        struct task_promise : task_promise_base {
+            std::optional<T> value;
+
+            task<T> get_return_object() noexcept;
+
+            template <typename U = T>
+                requires std::is_convertible_v<U&&, T>
+            void return_value(U&& result) {
+                value.emplace(std::forward<U>(result));
+            }
+
+            T result() {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+                return std::move(*value);
+            }
+        };
+
+        template <>
+        struct task_promise<void> : task_promise_base {
+            task<void> get_return_object() noexcept;
+
+            void return_void() const noexcept {}
+
+            void result() const {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            }
+        };
+    }
+
+    /// 惰性的协程：调用时只创建协程帧，co_await时才在当前线程中开始运行
+    /// 在协程中co_await schedule(group)可以切换到线程组的工作线程；协程结束时直接在结束的线程中恢复等待它的协程，
+    /// 所以一串co_await在工作线程之间传递，不需要std::future，也不需要为每个任务创建互斥锁与条件变量
+    /// 异常在co_await处重新抛出；task只能移动，析构时销毁协程帧，所以必须在协程结束以后才能析构
+    template <typename T>
+    class [[nodiscard]] task {
+    public:
+        using promise_type = detail::task_promise<T>;
+        using value_type = T;
+
+        task() = default;
+
+        explicit task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+        task(task&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+
+        task& operator=(task&& other) noexcept {
+            if (this != &other) {
+                if (m_handle) {
+                    m_handle.destroy();
+                }
+                m_handle = std::exchange(other.m_handle, nullptr);
+            }
+            return *this;
+        }
+
+        task(const task&) = delete;
+        task& operator=(const task&) = delete;
+
+        ~task() {
+            if (m_handle) {
+                m_handle.destroy();
+            }
+        }
+
+        bool valid() const noexcept {
+            return static_cast<bool>(m_handle);
+        }
+
+        bool done() const noexcept {
+            return m_handle && m_handle.done();
+        }
+
+        /// 开始运行这个task，结束以后恢复等待的协程，结果是task的返回值
+        auto operator co_await() && noexcept {
+            struct awaiter {
+                std::coroutine_handle<promise_type> handle;
+
+                bool await_ready() const noexcept {
+                    return !handle || handle.done();
+                }
+
+                /// 在当前线程中运行这个task，直到它结束或者切换到其他线程
+                /// 已经结束时返回false，不挂起等待的协程；否则由结束的线程恢复它
+                bool await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                    handle.promise().continuation = awaiting;
+                    handle.resume();
+                    return !handle.promise().handoff.exchange(true, std::memory_order_acq_rel);
+                }
+
+                T await_resume() {
+                    return handle.promise().result();
+                }
+            };
+            return awaiter{m_handle};
+        }
+
+    private:
+        std::coroutine_handle<promise_type> m_handle;
+    };
+
+    namespace detail {
+        template <typename T>
+        task<T> task_promise<T>::get_return_object() noexcept {
+            return task<T>(std::coroutine_handle<task_promise>::from_promise(*this));
+        }
+
+        inline task<void> task_promise<void>::get_return_object() noexcept {
+            return task<void>(std::coroutine_handle<task_promise>::from_promise(*this));
+        }
+
+        /// sync_wait使用的协程：结束时通知等待的线程
+        /// 通知在持有锁时进行，等待的线程拿到锁以后才能销毁协程帧，所以通知之后不会再访问已经销毁的状态
+        struct sync_wait_driver {
+            struct promise_type {
+                std::mutex lock;
+                std::condition_variable cond;
+                bool finished = false;
+
+                sync_wait_driver get_return_object() noexcept {
+                    return sync_wait_driver{std::coroutine_handle<promise_type>::from_promise(*this)};
+                }
+
+                std::suspend_always initial_suspend() const noexcept {
+                    return {};
+                }
+
+                auto final_suspend() const noexcept {
+                    struct notifier {
+                        bool await_ready() const noexcept {
+                            return false;
+                        }
+
+                        void await_suspend(std::coroutine_handle<promise_type> handle) const noexcept {
+                            promise_type& promise = handle.promise();
+                            std::lock_guard<std::mutex> guard(promise.lock);
+                            promise.finished = true;
+                            promise.cond.notify_all();
+                        }
+
+                        void await_resume() const noexcept {}
+                    };
+                    return notifier{};
+                }
+
+                void return_void() const noexcept {}
+
+                /// 异常已经在协程体中保存，不会运行到这里
+                void unhandled_exception() const noexcept {
+                    std::terminate();
+                }
+            };
+
+            std::coroutine_handle<promise_type> handle;
+        };
+
+        template <typename T>
+        sync_wait_driver run_sync_wait(task<T>& work, std::optional<std::conditional_t<std::is_void_v<T>, bool, T>>& result,
+                                       std::exception_ptr& error) {
+            try {
+                if constexpr (std::is_void_v<T>) {
+                    co_await std::move(work);
+                    result.emplace(true);
+                } else {
+                    result.emplace(co_await std::move(work));
+                }
+            } catch (...) {
+                error = std::current_exception();
+            }
+        }
+
+        /// spawn(group, task)使用的协程：自己启动（不被等待），结束时自己销毁协程帧
+        struct detached_task {
+            struct promise_type {
+                detached_task get_return_object() const noexcept {
+                    return {};
+                }
+
+                std::suspend_never initial_suspend() const noexcept {
+                    return {};
+                }
+
+                std::suspend_never final_suspend() const noexcept {
+                    return {};
+                }
+
+                void return_void() const noexcept {}
+
+                void unhandled_exception() const noexcept {
+                    std::terminate();
+                }
+            };
+        };
+
+        template <typename T>
+        detached_task run_detached(worker_group& group, task<T> work, std::shared_ptr<future_state<T>> state) {
+            co_await schedule(group);
+            if constexpr (std::is_void_v<T>) {
+                try {
+                    co_await std::move(work);
+                } catch (...) {
+                    state->set_error(std::current_exception());
+                    co_return;
+                }
+                state->set_value();
+            } else {
+                std::optional<T> value;
+                try {
+                    value.emplace(co_await std::move(work));
+                } catch (...) {
+                    state->set_error(std::current_exception());
+                    co_return;
+                }
+                state->set_value(std::move(*value));
+            }
+        }
+    }
+
+    /// 在当前线程中运行work，阻塞到它结束，返回它的结果或者重新抛出它的异常
+    /// 用于从普通的函数进入协程，work中co_await schedule()以后由工作线程继续运行
+    /// 不要在工作线程中调用：它会阻塞这个线程，而不是像task_group::wait()一样帮忙运行任务
+    template <typename T>
+    T sync_wait(task<T> work) {
+        std::optional<std::conditional_t<std::is_void_v<T>, bool, T>> result;
+        std::exception_ptr error;
+        detail::sync_wait_driver driver = detail::run_sync_wait(work, result, error);
+        driver.handle.resume();
+        {
+            auto& promise = driver.handle.promise();
+            std::unique_lock<std::mutex> guard(promise.lock);
+            promise.cond.wait(guard, [&promise]() {
+                return promise.finished;
+            });
+        }
+        driver.handle.destroy();
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        if constexpr (!std::is_void_v<T>) {
+            return std::move(*result);
+        }
+    }
+
+    /// 在group中开始运行work，不等待它结束，返回它的结果的task_future
+    /// 可以一次启动很多个task，再用when_all或者co_await等待
+    template <typename T>
+    task_future<T> spawn(worker_group& group, task<T> work) {
+        auto state = std::make_shared<detail::future_state<T>>(&group);
+        detail::run_detached(group, std::move(work), state);
+        return task_future<T>(std::move(state));
+    }
+
+    /// 在协程中co_await一个task_future：结果就绪时直接在完成的线程中恢复协程，不阻塞任何线程
+    template <typename T>
+    auto operator co_await(task_future<T> future) noexcept {
+        struct awaiter {
+            task_future<T> future;
+
+            bool await_ready() const {
+                return future.ready();
+            }
+
+            /// 登记以后协程可能马上被恢复，之后不能再访问this
+            void await_suspend(std::coroutine_handle<> handle) const {
+                future.on_ready_inline([handle]() {
+                    handle.resume();
+                });
+            }
+
+            decltype(auto) await_resume() const {
+                return future.get();
+            }
+        };
+        return awaiter{std::move(future)};
+    }
+
+} // thread_pool_v1
+
+#endif //COROUTINE_H
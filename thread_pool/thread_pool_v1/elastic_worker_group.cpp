@@ -0,0 +1,150 @@
+//
+// Created by ghost-him on 25-5-15.
+//
+
+#include "elastic_worker_group.h"
+
+#include <algorithm>
+#include <system_error>
+
+namespace thread_pool_v1 {
+    elastic_worker_group::elastic_worker_group(size_t max_threads, std::chrono::milliseconds keep_alive, size_t min_threads)
+        : m_max_threads(std::max<size_t>(max_threads, 1)),
+          m_min_threads(std::min(min_threads, m_max_threads)),
+          m_keep_alive(keep_alive) {
+        std::lock_guard<std::mutex> guard(m_lock);
+        for (size_t i = 0; i < m_min_threads; i++) {
+            spawn_thread();
+        }
+    }
+
+    elastic_worker_group::~elastic_worker_group() {
+        stop();
+        thread_list exited;
+        {
+            // 等待正在运行任务的线程结束，之后没有线程再访问m_threads与m_exited
+            std::unique_lock<std::mutex> guard(m_lock);
+            m_exit_cond.wait(guard, [this]() {
+                return m_threads.empty();
+            });
+            exited.swap(m_exited);
+        }
+        for (auto& jthread: exited) {
+            jthread.join();
+        }
+    }
+
+    void elastic_worker_group::submit(runtime_task task) {
+        bool notify = false;
+        thread_list exited;
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_tasks.push(std::move(task));
+            ++m_submitted;
+            if (m_idle > 0) {
+                // 有空闲的线程，叫醒其中一个
+                --m_idle;
+                ++m_notified;
+                notify = true;
+            } else if (!m_stop && m_threads.size() < m_max_threads) {
+                // 所有的线程都在运行任务（阻塞），再创建一个
+                spawn_thread();
+            }
+            // 顺便回收已经退出的线程
+            exited.swap(m_exited);
+        }
+        if (notify) {
+            m_cond.notify_one();
+        }
+        for (auto& jthread: exited) {
+            jthread.join();
+        }
+    }
+
+    void elastic_worker_group::stop() {
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_stop = true;
+        }
+        m_cond.notify_all();
+    }
+
+    bool elastic_worker_group::stopped() const {
+        std::lock_guard<std::mutex> guard(m_lock);
+        return m_stop;
+    }
+
+    size_t elastic_worker_group::thread_count() const {
+        std::lock_guard<std::mutex> guard(m_lock);
+        return m_threads.size();
+    }
+
+    worker_metrics elastic_worker_group::metrics() const {
+        std::lock_guard<std::mutex> guard(m_lock);
+        worker_metrics result;
+        result.threads = m_threads.size();
+        result.active = m_active;
+        result.queued = m_tasks.size();
+        result.submitted = m_submitted;
+        result.completed = m_completed;
+        result.peak_threads = m_peak_threads;
+        return result;
+    }
+
+    void elastic_worker_group::spawn_thread() {
+        auto self = m_threads.emplace(m_threads.end());
+        try {
+            // 新线程先等待锁，所以在它运行之前self已经保存了这个线程
+            *self = std::jthread([this, self]() {
+                worker_loop(self);
+            });
+        } catch (const std::system_error&) {
+            m_threads.erase(self);
+            // 已经有其他线程时，任务留在队列中由它们运行
+            if (m_threads.empty()) {
+                throw;
+            }
+            return;
+        }
+        m_peak_threads = std::max(m_peak_threads, m_threads.size());
+    }
+
+    void elastic_worker_group::worker_loop(thread_list::iterator self) {
+        std::unique_lock<std::mutex> guard(m_lock);
+        while (!m_stop) {
+            if (!m_tasks.empty()) {
+                runtime_task task = m_tasks.pop();
+                ++m_active;
+                guard.unlock();
+                task();
+                // 在锁外销毁任务捕获的对象
+                task = runtime_task();
+                guard.lock();
+                --m_active;
+                ++m_completed;
+                continue;
+            }
+            // 没有任务，等待被提交者叫醒，空闲超过m_keep_alive以后退出
+            ++m_idle;
+            const auto deadline = std::chrono::steady_clock::now() + m_keep_alive;
+            bool timed_out = false;
+            while (m_notified == 0 && !m_stop && !timed_out) {
+                timed_out = m_cond.wait_until(guard, deadline) == std::cv_status::timeout;
+            }
+            if (m_notified > 0) {
+                // 提交者已经把这个线程从m_idle中减去了
+                --m_notified;
+                continue;
+            }
+            --m_idle;
+            if (timed_out && m_tasks.empty() && m_threads.size() > m_min_threads) {
+                break;
+            }
+        }
+        // 线程不能回收自己，移动到m_exited中，由下一次提交或者析构函数回收
+        m_exited.splice(m_exited.end(), m_threads, self);
+        if (m_threads.empty()) {
+            m_exit_cond.notify_all();
+        }
+    }
+} // thread_pool_v1
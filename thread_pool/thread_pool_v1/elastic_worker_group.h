@@ -0,0 +1,85 @@
+//
+// Created by ghost-him on 25-5-15.
+//
+
+#ifndef ELASTIC_WORKER_GROUP_H
+#define ELASTIC_WORKER_GROUP_H
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <thread>
+
+#include "task_ring.h"
+#include "unique_task.h"
+#include "worker_group.h"
+
+namespace thread_pool_v1 {
+
+    /// 线程数随阻塞的任务数伸缩的线程组，用来运行io密集型的任务
+    /// io任务大部分时间在等待，占着线程却不占用cpu，所以不能像worker_group一样按核心数固定线程数：
+    ///   * 提交任务时如果没有空闲的线程，并且线程数还没有达到max_threads，就创建一个新线程，
+    ///     所以线程数会跟着同时阻塞的任务数增长
+    ///   * 线程空闲超过keep_alive以后退出，直到只剩min_threads个线程
+    /// 所有的任务放在同一个由互斥锁保护的队列中，io任务的运行时间远大于加锁的时间
+    class elastic_worker_group {
+    public:
+        using runtime_task = unique_task;
+
+        explicit elastic_worker_group(size_t max_threads = 256,
+                                      std::chrono::milliseconds keep_alive = std::chrono::seconds(10),
+                                      size_t min_threads = 0);
+        ~elastic_worker_group();
+
+        elastic_worker_group(const elastic_worker_group&) = delete;
+        elastic_worker_group& operator=(const elastic_worker_group&) = delete;
+
+        /// 提交一个任务
+        void submit(runtime_task task);
+
+        /// 通知所有的工作线程退出，还没有开始运行的任务不会再运行，析构时等待正在运行的任务结束
+        void stop();
+
+        bool stopped() const;
+
+        size_t thread_count() const;
+
+        worker_metrics metrics() const;
+
+    private:
+        using thread_list = std::list<std::jthread>;
+
+        /// 在持有锁时调用，创建一个新的工作线程
+        void spawn_thread();
+        /// self是这个线程在m_threads中的位置，退出时移动到m_exited中，由其他线程回收
+        void worker_loop(thread_list::iterator self);
+
+        const size_t m_max_threads;
+        const size_t m_min_threads;
+        const std::chrono::milliseconds m_keep_alive;
+
+        mutable std::mutex m_lock;
+        std::condition_variable m_cond;
+        /// 最后一个线程退出时通知析构函数
+        std::condition_variable m_exit_cond;
+        bool m_stop = false;
+
+        task_ring m_tasks;
+        /// 正在等待任务的线程数，以及已经被提交者叫醒、还没有醒来的线程数
+        /// 提交者每叫醒一个线程就把一个空闲的线程转为被叫醒的线程，所以连续提交多个任务时不会都只叫醒同一个线程
+        size_t m_idle = 0;
+        size_t m_notified = 0;
+        size_t m_active = 0;
+        size_t m_peak_threads = 0;
+        std::uint64_t m_submitted = 0;
+        std::uint64_t m_completed = 0;
+
+        /// 正在运行的线程，以及已经退出、还没有回收的线程
+        thread_list m_threads;
+        thread_list m_exited;
+    };
+
+} // thread_pool_v1
+
+#endif //ELASTIC_WORKER_GROUP_H
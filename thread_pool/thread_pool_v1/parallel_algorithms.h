@@ -0,0 +1,147 @@
+//
+// Created by ghost-him on 25-5-15.
+//
+
+#ifndef PARALLEL_ALGORITHMS_H
+#define PARALLEL_ALGORITHMS_H
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <optional>
+#include <utility>
+
+#include "task_group.h"
+#include "worker_group.h"
+
+namespace thread_pool_v1 {
+
+    /// 基于task_group的fork-join并行算法
+    /// 每一层把范围分成两半，后一半交给task_group，前一半在当前线程中继续，然后wait()；
+    /// wait()会先运行自己刚刚提交的那一半（没有被窃取时），所以递归的深度只有log(n/grain)，也不会阻塞工作线程
+    /// grain是不再拆分的最小范围，为0时取 范围大小 / (线程数 * 8)，至少为1
+
+    namespace detail {
+        inline std::size_t default_grain(const worker_group& group, std::size_t count, std::size_t minimum) {
+            return std::max(minimum, count / (group.thread_count() * 8));
+        }
+
+        template <typename Iterator, typename T, typename BinaryOp>
+        T reduce_range(worker_group& group, Iterator first, Iterator last, BinaryOp& op, std::size_t grain) {
+            const auto count = static_cast<std::size_t>(last - first);
+            if (count <= grain) {
+                return std::accumulate(std::next(first), last, T(*first), op);
+            }
+            const Iterator middle = first + static_cast<std::ptrdiff_t>(count / 2);
+            std::optional<T> right;
+            task_group tasks(group);
+            tasks.run([&group, &right, middle, last, &op, grain]() {
+                right.emplace(reduce_range<Iterator, T>(group, middle, last, op, grain));
+            });
+            T left = reduce_range<Iterator, T>(group, first, middle, op, grain);
+            tasks.wait();
+            return op(std::move(left), std::move(*right));
+        }
+
+        template <typename InputIterator, typename OutputIterator, typename UnaryOp>
+        void transform_range(worker_group& group, InputIterator first, InputIterator last, OutputIterator d_first,
+                             UnaryOp& op, std::size_t grain) {
+            const auto count = static_cast<std::size_t>(last - first);
+            if (count <= grain) {
+                std::transform(first, last, d_first, op);
+                return;
+            }
+            const auto half = static_cast<std::ptrdiff_t>(count / 2);
+            task_group tasks(group);
+            tasks.run([&group, first, half, last, d_first, &op, grain]() {
+                transform_range(group, first + half, last, d_first + half, op, grain);
+            });
+            transform_range(group, first, first + half, d_first, op, grain);
+            tasks.wait();
+        }
+
+        /// 三个元素的中位数作为枢轴
+        template <typename Iterator, typename Compare>
+        Iterator median_of_three(Iterator a, Iterator b, Iterator c, Compare& comp) {
+            if (comp(*a, *b)) {
+                return comp(*b, *c) ? b : (comp(*a, *c) ? c : a);
+            }
+            return comp(*a, *c) ? a : (comp(*b, *c) ? c : b);
+        }
+
+        /// 并行快速排序：划分为小于、等于、大于枢轴的三段，两边并行地递归
+        /// depth_limit用完时（划分一直不均匀）改用std::sort，保证最坏情况下也是O(n log n)
+        template <typename Iterator, typename Compare>
+        void sort_range(worker_group& group, Iterator first, Iterator last, Compare& comp, std::size_t grain, int depth_limit) {
+            const auto count = static_cast<std::size_t>(last - first);
+            if (count <= grain || depth_limit == 0) {
+                std::sort(first, last, comp);
+                return;
+            }
+            auto pivot = *median_of_three(first, first + static_cast<std::ptrdiff_t>(count / 2), std::prev(last), comp);
+            const Iterator lower_end = std::partition(first, last, [&](const auto& value) {
+                return comp(value, pivot);
+            });
+            const Iterator upper_begin = std::partition(lower_end, last, [&](const auto& value) {
+                return !comp(pivot, value);
+            });
+            task_group tasks(group);
+            tasks.run([&group, upper_begin, last, &comp, grain, depth_limit]() {
+                sort_range(group, upper_begin, last, comp, grain, depth_limit - 1);
+            });
+            sort_range(group, first, lower_end, comp, grain, depth_limit - 1);
+            tasks.wait();
+        }
+    }
+
+    /// 用op归约[first, last)，结果为op(init, 所有元素归约的结果)
+    /// op必须满足结合律，元素之间的结合顺序不确定（与std::reduce相同）
+    template <std::random_access_iterator Iterator, typename T, typename BinaryOp = std::plus<>>
+    T parallel_reduce(worker_group& group, Iterator first, Iterator last, T init, BinaryOp op = BinaryOp(),
+                      std::size_t grain = 0) {
+        if (first == last) {
+            return init;
+        }
+        const auto count = static_cast<std::size_t>(last - first);
+        if (grain == 0) {
+            grain = detail::default_grain(group, count, 1);
+        }
+        return op(std::move(init), detail::reduce_range<Iterator, T>(group, first, last, op, grain));
+    }
+
+    /// 把op(*it)写入从d_first开始的范围，返回写入的最后一个元素之后的位置
+    template <std::random_access_iterator InputIterator, std::random_access_iterator OutputIterator, typename UnaryOp>
+    OutputIterator parallel_transform(worker_group& group, InputIterator first, InputIterator last, OutputIterator d_first,
+                                      UnaryOp op, std::size_t grain = 0) {
+        const auto count = static_cast<std::size_t>(last - first);
+        if (count == 0) {
+            return d_first;
+        }
+        if (grain == 0) {
+            grain = detail::default_grain(group, count, 1);
+        }
+        detail::transform_range(group, first, last, d_first, op, grain);
+        return d_first + static_cast<std::ptrdiff_t>(count);
+    }
+
+    /// 排序[first, last)，不稳定（与std::sort相同）
+    template <std::random_access_iterator Iterator, typename Compare = std::less<>>
+    void parallel_sort(worker_group& group, Iterator first, Iterator last, Compare comp = Compare(), std::size_t grain = 0) {
+        const auto count = static_cast<std::size_t>(last - first);
+        if (count < 2) {
+            return;
+        }
+        if (grain == 0) {
+            // 太小的范围划分与提交的开销比排序本身还大
+            grain = detail::default_grain(group, count, 2048);
+        }
+        int depth_limit = 0;
+        for (std::size_t n = count; n > 1; n /= 2) {
+            depth_limit += 2;
+        }
+        detail::sort_range(group, first, last, comp, grain, depth_limit);
+    }
+
+} // thread_pool_v1
+
+#endif //PARALLEL_ALGORITHMS_H
@@ -0,0 +1,192 @@
+//
+// Created by ghost-him on 25-5-15.
+//
+
+#ifndef PARALLEL_FOR_H
+#define PARALLEL_FOR_H
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "worker_group.h"
+
+namespace thread_pool_v1 {
+
+    namespace detail {
+        /// 帮忙运行任务的线程每次睡眠的最长时间，提交与完成都会提前唤醒它，这只是防止错过唤醒的兜底
+        inline constexpr std::chrono::microseconds helper_park_timeout{1000};
+
+        /// 在done()成立之前帮助group运行其他任务，而不是阻塞当前线程，所以在工作线程中等待也不会占住这个线程
+        /// 暂时没有可以运行的任务时（剩下的任务正在其他线程中运行），先让出cpu，多次以后在group中短暂地睡眠，
+        /// 有新任务提交（比如完成以后才提交的后续任务）或者完成时被唤醒，醒来以后继续帮忙，
+        /// 所以即使group只有一个线程并且正在这里等待，之后提交到group的任务也会由这个线程运行
+        /// group为空时没有可以帮忙的任务，调用block()睡眠，调用者保证完成时会唤醒block()
+        template <typename Done, typename Block>
+        void help_until(worker_group* group, Done&& done, Block&& block) {
+            int idle_rounds = 0;
+            while (!done()) {
+                if (group != nullptr && group->try_run_one()) {
+                    idle_rounds = 0;
+                    continue;
+                }
+                if (idle_rounds < 64) {
+                    ++idle_rounds;
+                    std::this_thread::yield();
+                } else if (group != nullptr) {
+                    // 不清零idle_rounds：醒来以后只尝试一次try_run_one，取不到任务就再次睡眠
+                    group->park_helper(done, helper_park_timeout);
+                } else {
+                    block();
+                }
+            }
+        }
+
+        /// 一组任务共同的完成状态
+        struct completion_state {
+            /// 等待时帮忙运行这个组中的任务
+            worker_group* group = nullptr;
+            std::atomic<bool> finished = false;
+            std::atomic<bool> failed = false;
+            /// 第一个异常，只由把failed改为true的线程写入
+            std::exception_ptr error;
+
+            void fail(std::exception_ptr exception) {
+                if (!failed.exchange(true)) {
+                    error = std::move(exception);
+                }
+            }
+
+            void finish() {
+                finished.store(true, std::memory_order_release);
+                finished.notify_all();
+                if (group != nullptr) {
+                    group->notify_helpers();
+                }
+            }
+        };
+    }
+
+    /// 一组任务的完成句柄，代替每个任务一个std::future
+    /// 所有的任务结束以后wait()返回，任务抛出的第一个异常在wait()中重新抛出
+    class completion_handle {
+    public:
+        /// 默认构造的句柄表示已经完成
+        completion_handle() = default;
+
+        explicit completion_handle(std::shared_ptr<detail::completion_state> state) : m_state(std::move(state)) {}
+
+        bool done() const {
+            return m_state == nullptr || m_state->finished.load(std::memory_order_acquire);
+        }
+
+        /// 等待所有的任务结束，等待时帮忙运行线程组中的任务，所以也可以在同一个线程组的工作线程中调用
+        void wait() const {
+            if (m_state == nullptr) {
+                return;
+            }
+            detail::completion_state& state = *m_state;
+            detail::help_until(state.group, [&state]() {
+                return state.finished.load(std::memory_order_acquire);
+            }, [&state]() {
+                state.finished.wait(false, std::memory_order_acquire);
+            });
+            if (m_state->error) {
+                std::rethrow_exception(m_state->error);
+            }
+        }
+
+    private:
+        std::shared_ptr<detail::completion_state> m_state;
+    };
+
+    namespace detail {
+        template <typename Index, typename F>
+        struct for_state : completion_state {
+            for_state(worker_group& group_, F function_, Index grain_, std::make_unsigned_t<Index> count)
+                : function(std::move(function_)), grain(grain_), remaining(count) {
+                group = &group_;
+            }
+
+            F function;
+            Index grain;
+            /// 还没有处理完的下标个数，减到0的线程负责通知完成
+            std::atomic<std::make_unsigned_t<Index>> remaining;
+        };
+
+        template <typename Index, typename F>
+        void run_chunk(for_state<Index, F>& state, Index begin, Index end) {
+            // 已经有任务失败时，剩下的下标只计数，不再运行
+            if (state.failed.load(std::memory_order_relaxed)) {
+                return;
+            }
+            try {
+                for (Index i = begin; i < end; ++i) {
+                    state.function(i);
+                }
+            } catch (...) {
+                state.fail(std::current_exception());
+            }
+        }
+
+        /// 惰性二分（lazy binary splitting）：
+        /// 只有自己的队列为空时，才把剩下的范围拆成两半，后一半作为新的任务放入队列等待其他线程窃取；
+        /// 自己的队列不为空时，说明其他线程还有任务可以窃取，先顺序地处理grain个下标再检查
+        /// 所以任务的个数随空闲的线程数自动调整，而不是事先按固定的块数切分
+        /// shared_queue时以共用队列的长度作为判断的依据（见worker_group::local_queue_size），
+        /// 队列中还有任务时不拆分，也就不会每拆分一次都去抢队列的锁
+        template <typename Index, typename F>
+        void run_range(const std::shared_ptr<for_state<Index, F>>& state, Index begin, Index end) {
+            using count_type = std::make_unsigned_t<Index>;
+            count_type processed = 0;
+            while (end - begin > state->grain) {
+                if (state->group->local_queue_size() == 0) {
+                    const Index middle = begin + (end - begin) / 2;
+                    state->group->submit([state, middle, end]() {
+                        run_range(state, middle, end);
+                    });
+                    end = middle;
+                } else {
+                    run_chunk(*state, begin, static_cast<Index>(begin + state->grain));
+                    processed += static_cast<count_type>(state->grain);
+                    begin += state->grain;
+                }
+            }
+            run_chunk(*state, begin, end);
+            processed += static_cast<count_type>(end - begin);
+            if (state->remaining.fetch_sub(processed, std::memory_order_acq_rel) == processed) {
+                state->finish();
+            }
+        }
+    }
+
+    /// 在group中对[begin, end)中的每个下标调用function(i)，立即返回一个完成句柄
+    /// grain是不再拆分的最小范围，为0时根据范围的大小与线程数自动选择
+    template <std::integral Index, typename F>
+    completion_handle parallel_for(worker_group& group, Index begin, Index end, F&& function,
+                                   std::type_identity_t<Index> grain = 0) {
+        if (!(begin < end)) {
+            return completion_handle();
+        }
+        using count_type = std::make_unsigned_t<Index>;
+        const count_type count = static_cast<count_type>(end - begin);
+        if (grain <= 0) {
+            // 每个线程大约分到64块，块足够小才能平衡负载，惰性二分会在没有空闲线程时避免继续拆分
+            grain = static_cast<Index>(std::max<count_type>(1, count / static_cast<count_type>(group.thread_count() * 64)));
+        }
+        auto state = std::make_shared<detail::for_state<Index, std::decay_t<F>>>(group, std::forward<F>(function), grain, count);
+        group.submit([state, begin, end]() {
+            detail::run_range(state, begin, end);
+        });
+        return completion_handle(state);
+    }
+
+} // thread_pool_v1
+
+#endif //PARALLEL_FOR_H
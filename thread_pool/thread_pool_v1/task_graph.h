@@ -0,0 +1,170 @@
+//
+// Created by ghost-him on 25-5-15.
+//
+
+#ifndef TASK_GRAPH_H
+#define TASK_GRAPH_H
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "parallel_for.h"
+#include "unique_task.h"
+#include "worker_group.h"
+
+namespace thread_pool_v1 {
+
+    /// 有依赖关系的一组任务（有向无环图）
+    /// 每个结点记录还没有完成的前驱的个数，一个结点完成时把所有后继的计数原子地减一，减到0的后继被提交到线程组，
+    /// 所以没有任何线程需要阻塞等待前驱：结点只有在所有的前驱都完成以后才会被提交
+    /// 一个结点抛出异常以后，之后的结点不再运行（但是仍然按依赖关系完成计数），第一个异常在wait()中重新抛出
+    /// 同一张图可以多次运行，但是上一次运行结束之前不能再次调用run()，也不能修改图
+    class task_graph {
+    public:
+        using node_id = size_t;
+
+        explicit task_graph(worker_group& group) : m_group(group) {}
+
+        task_graph(const task_graph&) = delete;
+        task_graph& operator=(const task_graph&) = delete;
+
+        /// 结点引用着这张图，析构前等待正在进行的运行结束
+        ~task_graph() {
+            if (m_running != nullptr) {
+                try {
+                    completion_handle(m_running).wait();
+                } catch (...) {
+                }
+            }
+        }
+
+        /// 添加一个结点，它在dependencies中的结点都完成以后运行
+        template <typename F>
+        node_id add(F&& function, std::initializer_list<node_id> dependencies = {}) {
+            const node_id id = m_nodes.size();
+            m_nodes.emplace_back();
+            m_nodes.back().function = unique_task(std::forward<F>(function));
+            for (node_id dependency: dependencies) {
+                precede(dependency, id);
+            }
+            return id;
+        }
+
+        /// before完成以后after才能运行
+        void precede(node_id before, node_id after) {
+            if (before >= m_nodes.size() || after >= m_nodes.size()) {
+                throw std::out_of_range("task_graph: node does not exist");
+            }
+            m_nodes[before].successors.push_back(after);
+            ++m_nodes[after].predecessors;
+        }
+
+        size_t size() const {
+            return m_nodes.size();
+        }
+
+        /// 开始运行整张图，立即返回一个完成句柄；图中有环时抛出std::logic_error
+        completion_handle run() {
+            check_acyclic();
+            if (m_nodes.empty()) {
+                return completion_handle();
+            }
+            auto state = std::make_shared<run_state>(m_nodes.size());
+            state->group = &m_group;
+            m_running = state;
+            for (auto& node: m_nodes) {
+                node.pending.store(node.predecessors, std::memory_order_relaxed);
+            }
+            // 提交所有没有前驱的结点，submit中的加锁保证其他线程能看到上面重置的计数
+            for (node_id id = 0; id < m_nodes.size(); id++) {
+                if (m_nodes[id].predecessors == 0) {
+                    schedule(state, id);
+                }
+            }
+            return completion_handle(state);
+        }
+
+    private:
+        struct node {
+            unique_task function;
+            std::vector<node_id> successors;
+            size_t predecessors = 0;
+            /// 这一次运行中还没有完成的前驱的个数
+            std::atomic<size_t> pending = 0;
+        };
+
+        struct run_state : detail::completion_state {
+            explicit run_state(size_t count) : remaining(count) {}
+
+            /// 还没有完成的结点的个数，减到0的线程负责通知完成
+            std::atomic<size_t> remaining;
+        };
+
+        void schedule(const std::shared_ptr<run_state>& state, node_id id) {
+            m_group.submit([this, state, id]() {
+                run_node(state, id);
+            });
+        }
+
+        void run_node(const std::shared_ptr<run_state>& state, node_id id) {
+            node& current = m_nodes[id];
+            if (!state->failed.load(std::memory_order_relaxed)) {
+                try {
+                    current.function();
+                } catch (...) {
+                    state->fail(std::current_exception());
+                }
+            }
+            for (node_id successor: current.successors) {
+                if (m_nodes[successor].pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    schedule(state, successor);
+                }
+            }
+            // 这是这个结点最后一次访问图，之后图可能已经被析构了
+            if (state->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                state->finish();
+            }
+        }
+
+        /// 拓扑排序（Kahn算法），不能处理所有的结点时说明有环
+        void check_acyclic() const {
+            std::vector<size_t> in_degree(m_nodes.size());
+            std::vector<node_id> ready;
+            for (node_id id = 0; id < m_nodes.size(); id++) {
+                in_degree[id] = m_nodes[id].predecessors;
+                if (in_degree[id] == 0) {
+                    ready.push_back(id);
+                }
+            }
+            size_t visited = 0;
+            while (!ready.empty()) {
+                const node_id id = ready.back();
+                ready.pop_back();
+                ++visited;
+                for (node_id successor: m_nodes[id].successors) {
+                    if (--in_degree[successor] == 0) {
+                        ready.push_back(successor);
+                    }
+                }
+            }
+            if (visited != m_nodes.size()) {
+                throw std::logic_error("task_graph: dependency cycle");
+            }
+        }
+
+        worker_group& m_group;
+        /// 结点中有原子变量，不能移动，使用deque保证添加结点时已有的结点不会移动
+        std::deque<node> m_nodes;
+        /// 最近一次运行的状态
+        std::shared_ptr<run_state> m_running;
+    };
+
+} // thread_pool_v1
+
+#endif //TASK_GRAPH_H
@@ -0,0 +1,94 @@
+//
+// Created by ghost-him on 25-5-15.
+//
+
+#ifndef TASK_GROUP_H
+#define TASK_GROUP_H
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "parallel_for.h"
+#include "worker_group.h"
+
+namespace thread_pool_v1 {
+
+    /// 一组fork-join的任务：run()提交任务，wait()等待所有的任务结束
+    /// 与在任务中调用future.get()不同，wait()在等待时帮忙运行线程组中的任务（首先是自己的队列中刚刚提交的子任务），
+    /// 所以在工作线程中嵌套地使用也不会因为所有的工作线程都在等待而耗尽线程池或者死锁
+    /// 任务抛出的第一个异常在wait()中重新抛出，之后还没有开始的任务不再运行
+    class task_group {
+    public:
+        explicit task_group(worker_group& group) : m_group(group), m_state(std::make_shared<state>()) {}
+
+        task_group(const task_group&) = delete;
+        task_group& operator=(const task_group&) = delete;
+
+        /// 没有调用wait()时在这里等待所有的任务结束，忽略异常
+        ~task_group() {
+            wait_all();
+        }
+
+        template <typename F>
+        void run(F&& function) {
+            m_state->pending.fetch_add(1, std::memory_order_relaxed);
+            // 任务持有状态的所有权：最后一个任务唤醒等待的线程时，task_group可能已经被析构了
+            m_group.submit([state = m_state, group = &m_group, function = std::forward<F>(function)]() mutable {
+                if (!state->failed.load(std::memory_order_relaxed)) {
+                    try {
+                        function();
+                    } catch (...) {
+                        if (!state->failed.exchange(true)) {
+                            state->error = std::current_exception();
+                        }
+                    }
+                }
+                // 最后一个任务结束时才唤醒等待的线程
+                if (state->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    state->pending.notify_all();
+                    group->notify_helpers();
+                }
+            });
+        }
+
+        /// 等待所有的任务结束，并重新抛出第一个异常
+        void wait() {
+            wait_all();
+            if (m_state->error) {
+                std::exception_ptr error = std::move(m_state->error);
+                m_state->error = nullptr;
+                m_state->failed.store(false);
+                std::rethrow_exception(error);
+            }
+        }
+
+    private:
+        struct state {
+            std::atomic<size_t> pending = 0;
+            std::atomic<bool> failed = false;
+            /// 第一个异常，只由把failed改为true的线程写入
+            std::exception_ptr error;
+        };
+
+        void wait_all() {
+            state& current = *m_state;
+            detail::help_until(&m_group, [&current]() {
+                return current.pending.load(std::memory_order_acquire) == 0;
+            }, [&current]() {
+                const size_t pending = current.pending.load(std::memory_order_acquire);
+                if (pending != 0) {
+                    current.pending.wait(pending, std::memory_order_acquire);
+                }
+            });
+        }
+
+        worker_group& m_group;
+        std::shared_ptr<state> m_state;
+    };
+
+} // thread_pool_v1
+
+#endif //TASK_GROUP_H
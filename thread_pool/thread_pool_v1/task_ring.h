@@ -0,0 +1,59 @@
+//
+// Created by ghost-him on 25-5-15.
+//
+
+#ifndef TASK_RING_H
+#define TASK_RING_H
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "unique_task.h"
+
+namespace thread_pool_v1 {
+
+    /// 可以增长的环形缓冲区，作为先进先出的任务队列
+    /// 增长以后不会再缩小，所以队列的长度稳定以后，放入与取出都不再分配内存
+    class task_ring {
+    public:
+        bool empty() const {
+            return m_size == 0;
+        }
+
+        size_t size() const {
+            return m_size;
+        }
+
+        void push(unique_task&& task) {
+            if (m_size == m_items.size()) {
+                grow();
+            }
+            m_items[(m_head + m_size) & (m_items.size() - 1)] = std::move(task);
+            ++m_size;
+        }
+
+        unique_task pop() {
+            unique_task task = std::move(m_items[m_head]);
+            m_head = (m_head + 1) & (m_items.size() - 1);
+            --m_size;
+            return task;
+        }
+
+    private:
+        void grow() {
+            std::vector<unique_task> bigger(m_items.empty() ? 64 : m_items.size() * 2);
+            for (size_t i = 0; i < m_size; i++) {
+                bigger[i] = std::move(m_items[(m_head + i) & (m_items.size() - 1)]);
+            }
+            m_items.swap(bigger);
+            m_head = 0;
+        }
+
+        std::vector<unique_task> m_items;
+        size_t m_head = 0;
+        size_t m_size = 0;
+    };
+
+} // thread_pool_v1
+
+#endif //TASK_RING_H
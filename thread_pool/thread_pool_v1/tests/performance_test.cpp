@@ -7,9 +7,18 @@
 #include <functional>
 #include <numeric>   // For std::accumulate (optional, for using results)
 #include <iomanip>   // For std::fixed and std::setprecision
+#include <algorithm>
+#include <atomic>
+#include <tuple>
+#include <cmath>
+#include <random>
+#ifdef THREAD_POOL_WITH_EXECUTION_POLICY
+#include <execution>
+#endif
 
 // 确保你的线程池头文件路径正确
 #include "../thread_pool.h"
+#include "../worker_group.h"
 // #include "enable_singleton.h" // 通常 thread_pool.h 会包含它
 
 // --- 参数调整区 ---
@@ -39,6 +48,174 @@ long long cpu_intensive_task(int id, int complexity) {
     return result;
 }
 
+// --- 调度方式的扩展性测试 ---
+// 短任务的个数与计算量，以及递归提交的任务树的深度
+static constexpr int SCALING_TASKS = 200000;
+static constexpr int SCALING_COMPLEXITY = 200;
+static constexpr int SPAWN_DEPTH = 17;
+
+// 等待计数器达到expected
+void wait_for(const std::atomic<int>& counter, int expected) {
+    while (counter.load(std::memory_order_acquire) < expected) {
+        std::this_thread::yield();
+    }
+}
+
+// 在工作线程中递归地提交任务，形成一棵二叉树
+void spawn_tree(thread_pool_v1::worker_group& group, std::atomic<int>& counter, int depth) {
+    if (depth > 0) {
+        group.submit([&group, &counter, depth]() { spawn_tree(group, counter, depth - 1); });
+        group.submit([&group, &counter, depth]() { spawn_tree(group, counter, depth - 1); });
+    }
+    cpu_intensive_task(depth, SCALING_COMPLEXITY);
+    counter.fetch_add(1, std::memory_order_release);
+}
+
+// 返回{外部线程提交短任务的时间, 工作线程递归提交任务的时间}，单位为毫秒
+std::pair<double, double> benchmark_schedule(size_t thread_num, thread_pool_v1::schedule_mode mode) {
+    thread_pool_v1::worker_group group(thread_num, mode);
+    std::atomic<int> counter(0);
+    std::atomic<long long> checksum(0);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < SCALING_TASKS; ++i) {
+        group.submit([&counter, &checksum, i]() {
+            checksum.fetch_add(cpu_intensive_task(i, SCALING_COMPLEXITY), std::memory_order_relaxed);
+            counter.fetch_add(1, std::memory_order_release);
+        });
+    }
+    wait_for(counter, SCALING_TASKS);
+    const double external_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    counter.store(0);
+    start = std::chrono::high_resolution_clock::now();
+    group.submit([&group, &counter]() { spawn_tree(group, counter, SPAWN_DEPTH); });
+    wait_for(counter, (1 << (SPAWN_DEPTH + 1)) - 1);
+    const double nested_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    return {external_ms, nested_ms + (checksum.load() == 42 ? 1e-9 : 0)};
+}
+
+// --- commit与post的对比 ---
+// 几乎没有计算量的任务，时间主要花在提交与调度上
+static constexpr int POST_TASKS = 1000000;
+
+// 返回{commit的时间, post的时间}，单位为毫秒
+std::pair<double, double> benchmark_post(thread_pool_v1::thread_pool& pool) {
+    std::atomic<int> counter(0);
+    std::vector<std::future<void>> futures;
+    futures.reserve(POST_TASKS);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < POST_TASKS; ++i) {
+        futures.push_back(pool.commit([&counter]() { counter.fetch_add(1, std::memory_order_release); }));
+    }
+    for (auto& future : futures) {
+        future.get();
+    }
+    const double commit_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    counter.store(0);
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < POST_TASKS; ++i) {
+        pool.post([&counter]() { counter.fetch_add(1, std::memory_order_release); });
+    }
+    wait_for(counter, POST_TASKS);
+    const double post_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    return {commit_ms, post_ms};
+}
+
+// --- 逐个commit、commit_batch与parallel_for的对比 ---
+// 返回{逐个commit的时间, commit_batch的时间, parallel_for的时间}，单位为毫秒
+std::tuple<double, double, double> benchmark_batch(thread_pool_v1::thread_pool& pool) {
+    std::vector<long long> results(SCALING_TASKS);
+    auto start = std::chrono::high_resolution_clock::now();
+    {
+        std::vector<std::future<void>> futures;
+        futures.reserve(SCALING_TASKS);
+        for (int i = 0; i < SCALING_TASKS; ++i) {
+            futures.push_back(pool.commit([&results, i]() { results[i] = cpu_intensive_task(i, SCALING_COMPLEXITY); }));
+        }
+        for (auto& future : futures) {
+            future.get();
+        }
+    }
+    const double commit_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    {
+        std::vector<std::function<void()>> functions;
+        functions.reserve(SCALING_TASKS);
+        for (int i = 0; i < SCALING_TASKS; ++i) {
+            functions.emplace_back([&results, i]() { results[i] = cpu_intensive_task(i, SCALING_COMPLEXITY); });
+        }
+        for (auto& future : pool.commit_batch(functions)) {
+            future.get();
+        }
+    }
+    const double batch_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    pool.parallel_for(0, SCALING_TASKS, [&results](int i) { results[i] = cpu_intensive_task(i, SCALING_COMPLEXITY); }).wait();
+    const double parallel_for_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    return {commit_ms, batch_ms, parallel_for_ms};
+}
+
+// --- 并行算法与std::算法的对比 ---
+static constexpr size_t ALGORITHM_ELEMENTS = 4000000;
+
+// 运行function，返回毫秒数
+template <typename F>
+double time_ms(F&& function) {
+    const auto start = std::chrono::high_resolution_clock::now();
+    function();
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void benchmark_algorithms(thread_pool_v1::thread_pool& pool) {
+    std::mt19937 random(7);
+    std::vector<int> input(ALGORITHM_ELEMENTS);
+    for (auto& value : input) {
+        value = static_cast<int>(random() % 1000000);
+    }
+    std::vector<double> output(ALGORITHM_ELEMENTS);
+    auto transform_op = [](int x) { return std::sqrt(static_cast<double>(x)) * 1.5 + 1.0; };
+    long long sink = 0;
+
+    std::cout << "algorithm | std:: (sequential) | thread_pool";
+#ifdef THREAD_POOL_WITH_EXECUTION_POLICY
+    std::cout << " | std::execution::par";
+#endif
+    std::cout << std::endl;
+
+    // reduce
+    std::cout << "reduce    | " << std::setw(15) << time_ms([&]() { sink += std::reduce(input.begin(), input.end(), 0LL); }) << " ms | "
+              << std::setw(8) << time_ms([&]() { sink += pool.parallel_reduce(input.begin(), input.end(), 0LL); }) << " ms";
+#ifdef THREAD_POOL_WITH_EXECUTION_POLICY
+    std::cout << " | " << std::setw(16) << time_ms([&]() { sink += std::reduce(std::execution::par, input.begin(), input.end(), 0LL); }) << " ms";
+#endif
+    std::cout << std::endl;
+
+    // transform
+    std::cout << "transform | " << std::setw(15) << time_ms([&]() { std::transform(input.begin(), input.end(), output.begin(), transform_op); }) << " ms | "
+              << std::setw(8) << time_ms([&]() { pool.parallel_transform(input.begin(), input.end(), output.begin(), transform_op); }) << " ms";
+#ifdef THREAD_POOL_WITH_EXECUTION_POLICY
+    std::cout << " | " << std::setw(16) << time_ms([&]() { std::transform(std::execution::par, input.begin(), input.end(), output.begin(), transform_op); }) << " ms";
+#endif
+    std::cout << std::endl;
+
+    // sort，每次排序同一份未排序的数据
+    std::vector<int> data = input;
+    std::cout << "sort      | " << std::setw(15) << time_ms([&]() { std::sort(data.begin(), data.end()); }) << " ms | ";
+    data = input;
+    std::cout << std::setw(8) << time_ms([&]() { pool.parallel_sort(data.begin(), data.end()); }) << " ms";
+#ifdef THREAD_POOL_WITH_EXECUTION_POLICY
+    data = input;
+    std::cout << " | " << std::setw(16) << time_ms([&]() { std::sort(std::execution::par, data.begin(), data.end()); }) << " ms";
+#endif
+    std::cout << std::endl;
+    if (sink == 42 || output[0] < 0 || !std::is_sorted(data.begin(), data.end())) {
+        std::cout << "WARNING: unexpected algorithm result" << std::endl;
+    }
+}
+
 int main() {
     std::cout << "Benchmark Configuration:" << std::endl;
     std::cout << "------------------------" << std::endl;
@@ -134,6 +311,42 @@ int main() {
         std::cout << "WARNING: Results from methods DO NOT match!" << std::endl;
     }
 
+    // --- 4. 不同线程数下两种调度方式的对比 ---
+    std::cout << "\n--- Scheduling scalability ---" << std::endl;
+    std::cout << "external: " << SCALING_TASKS << " short tasks committed from the main thread" << std::endl;
+    std::cout << "nested:   " << (1 << (SPAWN_DEPTH + 1)) - 1 << " tasks spawned recursively from workers" << std::endl;
+    std::cout << "threads | shared_queue external | work_stealing external | shared_queue nested | work_stealing nested" << std::endl;
+    const size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t thread_num = 1; ; thread_num = std::min(thread_num * 2, hardware)) {
+        const auto shared = benchmark_schedule(thread_num, thread_pool_v1::schedule_mode::shared_queue);
+        const auto stealing = benchmark_schedule(thread_num, thread_pool_v1::schedule_mode::work_stealing);
+        std::cout << std::setw(7) << thread_num << " | "
+                  << std::setw(18) << shared.first << " ms | "
+                  << std::setw(19) << stealing.first << " ms | "
+                  << std::setw(16) << shared.second << " ms | "
+                  << std::setw(17) << stealing.second << " ms" << std::endl;
+        if (thread_num == hardware) {
+            break;
+        }
+    }
+
+    // --- 5. commit与post提交极短任务的对比 ---
+    std::cout << "\n--- commit vs post ---" << std::endl;
+    const auto submit = benchmark_post(thread_pool_v1::thread_pool::get_instance());
+    std::cout << POST_TASKS << " empty tasks with commit: " << submit.first << " ms" << std::endl;
+    std::cout << POST_TASKS << " empty tasks with post:   " << submit.second << " ms" << std::endl;
+
+    // --- 6. 逐个commit、commit_batch与parallel_for的对比 ---
+    std::cout << "\n--- commit vs commit_batch vs parallel_for ---" << std::endl;
+    const auto [commit_ms, batch_ms, parallel_for_ms] = benchmark_batch(thread_pool_v1::thread_pool::get_instance());
+    std::cout << SCALING_TASKS << " short tasks with commit:       " << commit_ms << " ms" << std::endl;
+    std::cout << SCALING_TASKS << " short tasks with commit_batch: " << batch_ms << " ms" << std::endl;
+    std::cout << SCALING_TASKS << " iterations with parallel_for:  " << parallel_for_ms << " ms" << std::endl;
+
+    // --- 7. 并行算法与std::算法的对比 ---
+    std::cout << "\n--- Parallel algorithms (" << ALGORITHM_ELEMENTS << " elements) ---" << std::endl;
+    benchmark_algorithms(thread_pool_v1::thread_pool::get_instance());
+
     // 确保单例线程池在程序结束前被正确关闭和清理
     // 如果没有显式调用 stop()，单例的析构函数应处理此问题
     // 如果之前调用了 pool.stop()，这里可以不用再调用
@@ -0,0 +1,211 @@
+#include "gtest/gtest.h"
+#include "../continuation.h"
+#include "../task_graph.h"
+#include "../thread_pool.h"
+#include "../worker_group.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(ContinuationTest, ThenPassesValues) {
+    thread_pool_v1::worker_group group(2);
+    auto future = thread_pool_v1::spawn(group, []() { return 20; })
+        .then([](int x) { return x + 1; })
+        .then([](int x) { return std::to_string(x * 2); });
+    EXPECT_EQ(future.get(), "42");
+    // 副本共享同一个结果，可以多次取得
+    auto copy = future;
+    EXPECT_EQ(copy.get(), "42");
+    EXPECT_TRUE(copy.ready());
+
+    std::atomic<int> counter(0);
+    auto done = thread_pool_v1::spawn(group, [&counter]() { counter.fetch_add(1); })
+        .then([&counter]() { counter.fetch_add(10); })
+        .then([&counter]() { return counter.load(); });
+    EXPECT_EQ(done.get(), 11);
+
+    // 已经完成的future上添加后续任务
+    auto ready = thread_pool_v1::spawn(group, []() { return 1; });
+    ready.wait();
+    EXPECT_EQ(ready.then([](int x) { return x * 3; }).get(), 3);
+}
+
+TEST(ContinuationTest, ThenSkipsOnError) {
+    thread_pool_v1::worker_group group(2);
+    std::atomic<bool> ran(false);
+    auto future = thread_pool_v1::spawn(group, []() -> int { throw std::runtime_error("first"); })
+        .then([&ran](int x) { ran = true; return x; })
+        .then([&ran](int) { ran = true; });
+    EXPECT_THROW(future.get(), std::runtime_error);
+    EXPECT_FALSE(ran.load());
+
+    auto later = thread_pool_v1::spawn(group, []() { return 1; })
+        .then([](int) -> int { throw std::logic_error("second"); });
+    EXPECT_THROW(later.get(), std::logic_error);
+}
+
+TEST(ContinuationTest, WhenAllAndWhenAny) {
+    thread_pool_v1::worker_group group(4);
+    std::vector<thread_pool_v1::task_future<int>> futures;
+    for (int i = 0; i < 100; ++i) {
+        futures.push_back(thread_pool_v1::spawn(group, [i]() { return i * i; }));
+    }
+    auto all = thread_pool_v1::when_all(futures).then([](const std::vector<int>& values) {
+        long long sum = 0;
+        for (size_t i = 0; i < values.size(); ++i) {
+            EXPECT_EQ(values[i], static_cast<int>(i * i));
+            sum += values[i];
+        }
+        return sum;
+    });
+    EXPECT_EQ(all.get(), 328350);
+
+    std::atomic<int> counter(0);
+    std::vector<thread_pool_v1::task_future<void>> voids;
+    for (int i = 0; i < 50; ++i) {
+        voids.push_back(thread_pool_v1::spawn(group, [&counter]() { counter.fetch_add(1); }));
+    }
+    thread_pool_v1::when_all(voids).get();
+    EXPECT_EQ(counter.load(), 50);
+
+    EXPECT_TRUE(thread_pool_v1::when_all(std::vector<thread_pool_v1::task_future<int>>()).get().empty());
+    EXPECT_NO_THROW(thread_pool_v1::when_all(std::vector<thread_pool_v1::task_future<void>>()).get());
+
+    // 一个失败时when_all失败
+    futures.push_back(thread_pool_v1::spawn(group, []() -> int { throw std::runtime_error("failed"); }));
+    EXPECT_THROW(thread_pool_v1::when_all(futures).get(), std::runtime_error);
+
+    // when_any在第一个完成的时候完成，不等待还没有完成的
+    // （不能用阻塞的任务代替没有完成的future：等待的线程会帮忙运行任务，可能正好运行到它）
+    auto pending = std::make_shared<thread_pool_v1::detail::future_state<int>>(&group);
+    std::vector<thread_pool_v1::task_future<int>> race;
+    race.emplace_back(pending);
+    race.push_back(thread_pool_v1::spawn(group, []() { return 2; }));
+    const size_t index = thread_pool_v1::when_any(race).get();
+    EXPECT_EQ(index, 1u);
+    EXPECT_EQ(race[index].get(), 2);
+    EXPECT_FALSE(race[0].ready());
+    pending->set_value(1);
+    EXPECT_EQ(race[0].get(), 1);
+
+    EXPECT_THROW(thread_pool_v1::when_any(std::vector<thread_pool_v1::task_future<int>>()), std::invalid_argument);
+}
+
+// 只有一个工作线程时，在任务中等待另一个任务的结果也不会死锁
+TEST(ContinuationTest, WaitingInsideWorkerDoesNotDeadlock) {
+    thread_pool_v1::worker_group group(1);
+    auto outer = thread_pool_v1::spawn(group, [&group]() {
+        auto inner = thread_pool_v1::spawn(group, []() { return 5; });
+        for (int i = 0; i < 1000; ++i) {
+            inner = inner.then([](int x) { return x + 1; });
+        }
+        return inner.get();
+    });
+    EXPECT_EQ(outer.get(), 1005);
+}
+
+// 只有一个工作线程，并且它正在等待的future依赖另一个组中的任务：另一个组完成以后，后续任务才提交到这个组，
+// 等待的线程已经睡眠了，需要被新提交的任务唤醒并运行它
+TEST(ContinuationTest, WaiterRunsContinuationSubmittedLater) {
+    thread_pool_v1::worker_group group(1);
+    thread_pool_v1::worker_group io(1);
+    auto outer = thread_pool_v1::spawn(group, [&group, &io]() {
+        auto a = thread_pool_v1::spawn(group, []() { return 1; });
+        auto b = thread_pool_v1::spawn(io, []() {
+            // 让等待的线程先用完让出cpu的次数，进入睡眠
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            return 2;
+        });
+        auto sum = thread_pool_v1::when_all(std::vector{a, b}).then([](const std::vector<int>& values) {
+            return values[0] + values[1];
+        });
+        return sum.get();
+    });
+    EXPECT_EQ(outer.get(), 3);
+}
+
+TEST(TaskGraphTest, RunsInDependencyOrder) {
+    thread_pool_v1::worker_group group(4);
+    thread_pool_v1::task_graph graph(group);
+    std::mutex lock;
+    std::vector<char> order;
+    auto record = [&lock, &order](char name) {
+        return [&lock, &order, name]() {
+            std::lock_guard<std::mutex> guard(lock);
+            order.push_back(name);
+        };
+    };
+    // a -> b, a -> c, b -> d, c -> d
+    const auto a = graph.add(record('a'));
+    const auto b = graph.add(record('b'), {a});
+    const auto c = graph.add(record('c'), {a});
+    graph.add(record('d'), {b, c});
+    EXPECT_EQ(graph.size(), 4u);
+
+    // 同一张图可以运行多次
+    for (int round = 0; round < 20; ++round) {
+        order.clear();
+        graph.run().wait();
+        ASSERT_EQ(order.size(), 4u);
+        EXPECT_EQ(order.front(), 'a');
+        EXPECT_EQ(order.back(), 'd');
+    }
+}
+
+TEST(TaskGraphTest, WideGraphAndErrors) {
+    thread_pool_v1::worker_group group(2);
+    {
+        // 1000个结点的链与扇出扇入
+        thread_pool_v1::task_graph graph(group);
+        std::atomic<int> counter(0);
+        auto previous = graph.add([]() {});
+        for (int i = 0; i < 1000; ++i) {
+            previous = graph.add([&counter]() { counter.fetch_add(1); }, {previous});
+        }
+        auto sink = graph.add([]() {});
+        for (int i = 0; i < 1000; ++i) {
+            auto node = graph.add([&counter]() { counter.fetch_add(1); }, {previous});
+            graph.precede(node, sink);
+        }
+        graph.run().wait();
+        EXPECT_EQ(counter.load(), 2000);
+    }
+    {
+        thread_pool_v1::task_graph graph(group);
+        std::atomic<bool> ran(false);
+        const auto first = graph.add([]() { throw std::runtime_error("node"); });
+        graph.add([&ran]() { ran = true; }, {first});
+        EXPECT_THROW(graph.run().wait(), std::runtime_error);
+        EXPECT_FALSE(ran.load());
+    }
+    {
+        thread_pool_v1::task_graph graph(group);
+        const auto a = graph.add([]() {});
+        const auto b = graph.add([]() {}, {a});
+        graph.precede(b, a);
+        EXPECT_THROW(graph.run(), std::logic_error);
+        EXPECT_THROW(graph.precede(a, 5), std::out_of_range);
+    }
+    {
+        thread_pool_v1::task_graph graph(group);
+        EXPECT_TRUE(graph.run().done());
+    }
+}
+
+TEST(ContinuationTest, ThreadPoolSpawnAndGraph) {
+    auto pool = thread_pool_v1::thread_pool::create_for_testing(2);
+    auto future = pool->spawn([](int a, int b) { return a * b; }, 6, 7).then([](int x) { return x + 1; });
+    EXPECT_EQ(future.get(), 43);
+
+    std::atomic<int> counter(0);
+    auto graph = pool->make_task_graph();
+    const auto first = graph.add([&counter]() { counter.fetch_add(1); });
+    graph.add([&counter]() { counter.fetch_add(counter.load() * 10); }, {first});
+    graph.run().wait();
+    EXPECT_EQ(counter.load(), 11);
+}
@@ -0,0 +1,132 @@
+#include "gtest/gtest.h"
+#include "../continuation.h"
+#include "../coroutine.h"
+#include "../thread_pool.h"
+#include "../worker_group.h"
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    thread_pool_v1::task<int> add(int a, int b) {
+        co_return a + b;
+    }
+
+    thread_pool_v1::task<void> fail() {
+        throw std::runtime_error("coroutine");
+        co_return;
+    }
+
+    thread_pool_v1::task<std::thread::id> switch_to(thread_pool_v1::worker_group& group) {
+        co_await thread_pool_v1::schedule(group);
+        co_return std::this_thread::get_id();
+    }
+}
+
+TEST(CoroutineTest, ScheduleResumesOnWorker) {
+    thread_pool_v1::worker_group group(2);
+    const std::thread::id worker = thread_pool_v1::sync_wait(switch_to(group));
+    EXPECT_NE(worker, std::this_thread::get_id());
+
+    // 惰性启动：没有被等待的task不会运行
+    std::atomic<bool> started(false);
+    auto lazy = [&started]() -> thread_pool_v1::task<void> {
+        started = true;
+        co_return;
+    };
+    {
+        auto unused = lazy();
+        EXPECT_FALSE(started.load());
+    }
+    EXPECT_FALSE(started.load());
+    thread_pool_v1::sync_wait(lazy());
+    EXPECT_TRUE(started.load());
+}
+
+TEST(CoroutineTest, NestedTasksAndExceptions) {
+    thread_pool_v1::worker_group group(2);
+    auto parent = [&group]() -> thread_pool_v1::task<std::string> {
+        int sum = co_await add(1, 2);
+        co_await thread_pool_v1::schedule(group);
+        sum += co_await add(sum, 4);
+        co_return std::to_string(sum);
+    };
+    EXPECT_EQ(thread_pool_v1::sync_wait(parent()), "10");
+
+    EXPECT_THROW(thread_pool_v1::sync_wait(fail()), std::runtime_error);
+    auto caught = []() -> thread_pool_v1::task<bool> {
+        try {
+            co_await fail();
+        } catch (const std::runtime_error&) {
+            co_return true;
+        }
+        co_return false;
+    };
+    EXPECT_TRUE(thread_pool_v1::sync_wait(caught()));
+
+    // 同步完成的子协程不挂起父协程，很长的循环也不会让栈越来越深
+    auto loop = []() -> thread_pool_v1::task<long long> {
+        long long total = 0;
+        for (int i = 0; i < 100000; ++i) {
+            total += co_await add(i, 0);
+        }
+        co_return total;
+    };
+    EXPECT_EQ(thread_pool_v1::sync_wait(loop()), 4999950000LL);
+}
+
+// 很多个同时进行的协程共享少量的工作线程
+TEST(CoroutineTest, ThousandsOfTasksInFlight) {
+    thread_pool_v1::worker_group group(2);
+    std::mutex lock;
+    std::set<std::thread::id> threads;
+    std::atomic<int> steps(0);
+    auto work = [&](int i) -> thread_pool_v1::task<int> {
+        for (int round = 0; round < 3; ++round) {
+            co_await thread_pool_v1::schedule(group);
+            steps.fetch_add(1, std::memory_order_relaxed);
+        }
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            threads.insert(std::this_thread::get_id());
+        }
+        co_return i;
+    };
+    std::vector<thread_pool_v1::task_future<int>> futures;
+    for (int i = 0; i < 5000; ++i) {
+        futures.push_back(thread_pool_v1::spawn(group, work(i)));
+    }
+    auto total = [&futures]() -> thread_pool_v1::task<long long> {
+        // 等待task_future：最后一个完成的工作线程直接恢复这个协程
+        const std::vector<int> values = co_await thread_pool_v1::when_all(futures);
+        long long sum = 0;
+        for (int value : values) {
+            sum += value;
+        }
+        co_return sum;
+    };
+    EXPECT_EQ(thread_pool_v1::sync_wait(total()), 12497500LL);
+    EXPECT_EQ(steps.load(), 15000);
+    EXPECT_LE(threads.size(), group.thread_count());
+    EXPECT_FALSE(threads.contains(std::this_thread::get_id()));
+
+    // 协程中的异常传给task_future
+    auto failed = thread_pool_v1::spawn(group, fail());
+    EXPECT_THROW(failed.get(), std::runtime_error);
+}
+
+TEST(CoroutineTest, ThreadPoolSchedule) {
+    auto pool = thread_pool_v1::thread_pool::create_for_testing(2);
+    auto body = [&pool]() -> thread_pool_v1::task<int> {
+        co_await pool->schedule();
+        const int cpu = co_await pool->spawn([]() { return 20; });
+        co_await pool->schedule_io();
+        co_return cpu + co_await add(1, 1);
+    };
+    EXPECT_EQ(thread_pool_v1::sync_wait(body()), 22);
+    EXPECT_EQ(pool->spawn(add(2, 3)).get(), 5);
+}
@@ -0,0 +1,145 @@
+#include "gtest/gtest.h"
+#include "../elastic_worker_group.h"
+#include "../thread_pool.h"
+#include "../worker_group.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+namespace {
+    // 等待condition成立，最多等待几秒
+    bool wait_until(const std::function<bool()>& condition) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (!condition()) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
+    // 模拟阻塞的io：一直等到release被设置
+    void block_until(const std::atomic<bool>& release) {
+        while (!release.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+// 线程数跟着阻塞的任务数增长，空闲以后再缩小
+TEST(ElasticWorkerGroupTest, GrowsAndShrinksWithBlockedTasks) {
+    thread_pool_v1::elastic_worker_group group(64, std::chrono::milliseconds(50));
+    EXPECT_EQ(group.thread_count(), 0);
+
+    std::atomic<bool> release(false);
+    std::atomic<int> finished(0);
+    for (int i = 0; i < 8; ++i) {
+        group.submit([&release, &finished]() {
+            block_until(release);
+            finished.fetch_add(1);
+        });
+    }
+    ASSERT_TRUE(wait_until([&group]() { return group.metrics().active == 8; }));
+    EXPECT_EQ(group.thread_count(), 8);
+    EXPECT_EQ(group.metrics().queued, 0);
+
+    release.store(true);
+    ASSERT_TRUE(wait_until([&finished]() { return finished.load() == 8; }));
+    ASSERT_TRUE(wait_until([&group]() { return group.thread_count() == 0; }));
+
+    const auto metrics = group.metrics();
+    EXPECT_EQ(metrics.submitted, 8);
+    EXPECT_EQ(metrics.completed, 8);
+    EXPECT_EQ(metrics.peak_threads, 8);
+}
+
+TEST(ElasticWorkerGroupTest, RespectsThreadLimits) {
+    thread_pool_v1::elastic_worker_group group(2, std::chrono::milliseconds(20), 1);
+    EXPECT_EQ(group.thread_count(), 1);
+
+    std::atomic<bool> release(false);
+    std::atomic<int> finished(0);
+    for (int i = 0; i < 5; ++i) {
+        group.submit([&release, &finished]() {
+            block_until(release);
+            finished.fetch_add(1);
+        });
+    }
+    ASSERT_TRUE(wait_until([&group]() { return group.metrics().active == 2; }));
+    auto metrics = group.metrics();
+    EXPECT_EQ(metrics.threads, 2);
+    EXPECT_EQ(metrics.queued, 3);
+
+    release.store(true);
+    ASSERT_TRUE(wait_until([&finished]() { return finished.load() == 5; }));
+    // 空闲以后保留min_threads个线程
+    ASSERT_TRUE(wait_until([&group]() { return group.thread_count() == 1; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    EXPECT_EQ(group.thread_count(), 1);
+    EXPECT_EQ(group.metrics().peak_threads, 2);
+}
+
+// 空闲的线程被重复使用，不会为每个任务都创建线程
+TEST(ElasticWorkerGroupTest, ReusesIdleThreads) {
+    thread_pool_v1::elastic_worker_group group(64, std::chrono::seconds(10));
+    std::atomic<int> counter(0);
+    for (int i = 0; i < 100; ++i) {
+        group.submit([&counter]() { counter.fetch_add(1); });
+        // 线程在同一次加锁中记录完成并且转为空闲
+        ASSERT_TRUE(wait_until([&group, i]() { return group.metrics().completed == static_cast<std::uint64_t>(i + 1); }));
+    }
+    // 每个任务都在下一个任务提交之前结束，所以一个线程就够了
+    EXPECT_EQ(counter.load(), 100);
+    EXPECT_EQ(group.metrics().peak_threads, 1);
+}
+
+TEST(ElasticWorkerGroupTest, WorkerGroupMetrics) {
+    for (auto mode : {thread_pool_v1::schedule_mode::shared_queue, thread_pool_v1::schedule_mode::work_stealing}) {
+        thread_pool_v1::worker_group group(2, mode);
+        std::atomic<int> counter(0);
+        for (int i = 0; i < 100; ++i) {
+            group.submit([&group, &counter]() {
+                group.submit([&counter]() { counter.fetch_add(1); });
+                counter.fetch_add(1);
+            });
+        }
+        ASSERT_TRUE(wait_until([&counter]() { return counter.load() == 200; }));
+        ASSERT_TRUE(wait_until([&group]() { return group.metrics().completed == 200; }));
+        const auto metrics = group.metrics();
+        EXPECT_EQ(metrics.threads, 2);
+        EXPECT_EQ(metrics.submitted, 200);
+        EXPECT_EQ(metrics.active, 0);
+        EXPECT_EQ(metrics.queued, 0);
+    }
+}
+
+// 阻塞的io任务不会占用cpu任务的线程：io任务一直等到cpu任务运行完才结束
+TEST(ElasticWorkerGroupTest, IoTasksDoNotStarveCpuTasks) {
+    // 在线程池之前声明，线程池析构时io任务还会读取它
+    std::atomic<bool> cpu_done(false);
+    auto pool = thread_pool_v1::thread_pool::create_for_testing(2);
+    // 在线程池之后声明，先于线程池析构：断言失败提前返回时也要放开io任务，否则线程池析构时会一直等待
+    struct release_guard {
+        std::atomic<bool>& flag;
+        ~release_guard() {
+            flag.store(true);
+        }
+    } guard{cpu_done};
+    std::vector<std::future<void>> io_futures;
+    for (size_t i = 0; i < pool->thread_count() + 2; ++i) {
+        io_futures.push_back(pool->commit_io([&cpu_done]() { block_until(cpu_done); }));
+    }
+    ASSERT_TRUE(wait_until([&pool, &io_futures]() { return pool->io_metrics().active == io_futures.size(); }));
+    auto cpu_future = pool->commit_cpu([&cpu_done]() {
+        cpu_done.store(true);
+        return 42;
+    });
+    ASSERT_EQ(cpu_future.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    EXPECT_EQ(cpu_future.get(), 42);
+    for (auto& future : io_futures) {
+        future.get();
+    }
+    EXPECT_GE(pool->io_metrics().peak_threads, pool->thread_count() + 2);
+}
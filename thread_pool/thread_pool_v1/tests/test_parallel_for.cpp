@@ -0,0 +1,147 @@
+#include "gtest/gtest.h"
+#include "../parallel_for.h"
+#include "../thread_pool.h"
+#include "../worker_group.h"
+#include <atomic>
+#include <chrono>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+    bool wait_for_count(const std::atomic<int>& counter, int expected) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (counter.load() < expected) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        return true;
+    }
+}
+
+TEST(ParallelForTest, SubmitBatchRunsEveryTask) {
+    for (auto mode : {thread_pool_v1::schedule_mode::shared_queue, thread_pool_v1::schedule_mode::work_stealing}) {
+        thread_pool_v1::worker_group group(4, mode);
+        std::atomic<int> counter(0);
+        std::vector<thread_pool_v1::unique_task> tasks;
+        for (int i = 0; i < 1000; ++i) {
+            tasks.emplace_back([&counter]() { counter.fetch_add(1); });
+        }
+        group.submit_batch(tasks);
+        ASSERT_TRUE(wait_for_count(counter, 1000));
+
+        // 工作线程中一次提交的任务放入自己的队列，由其他线程窃取
+        group.submit([&group, &counter]() {
+            std::vector<thread_pool_v1::unique_task> nested;
+            for (int i = 0; i < 1000; ++i) {
+                nested.emplace_back([&counter]() { counter.fetch_add(1); });
+            }
+            group.submit_batch(nested);
+        });
+        ASSERT_TRUE(wait_for_count(counter, 2000));
+        EXPECT_EQ(group.metrics().submitted, 2001);
+    }
+}
+
+TEST(ParallelForTest, VisitsEveryIndexOnce) {
+    thread_pool_v1::worker_group group(4);
+    for (int grain : {0, 1, 7, 1000, 100000}) {
+        std::vector<std::atomic<int>> visits(10007);
+        auto handle = thread_pool_v1::parallel_for(group, 0, static_cast<int>(visits.size()), [&visits](int i) {
+            visits[i].fetch_add(1);
+        }, grain);
+        handle.wait();
+        EXPECT_TRUE(handle.done());
+        for (size_t i = 0; i < visits.size(); ++i) {
+            ASSERT_EQ(visits[i].load(), 1) << "index " << i << " grain " << grain;
+        }
+    }
+}
+
+TEST(ParallelForTest, HandlesEmptyAndOffsetRanges) {
+    thread_pool_v1::worker_group group(2);
+    std::atomic<long long> sum(0);
+    auto empty = thread_pool_v1::parallel_for(group, 5, 5, [&sum](int i) { sum += i; });
+    EXPECT_TRUE(empty.done());
+    empty.wait();
+
+    thread_pool_v1::parallel_for(group, -100LL, 101LL, [&sum](long long i) { sum += i; }, 3).wait();
+    EXPECT_EQ(sum.load(), 0);
+    thread_pool_v1::parallel_for(group, 10u, 20u, [&sum](unsigned i) { sum += i; }).wait();
+    EXPECT_EQ(sum.load(), 145);
+}
+
+TEST(ParallelForTest, RethrowsFirstException) {
+    thread_pool_v1::worker_group group(4);
+    std::atomic<int> calls(0);
+    auto handle = thread_pool_v1::parallel_for(group, 0, 100000, [&calls](int i) {
+        calls.fetch_add(1);
+        if (i == 500) {
+            throw std::runtime_error("index 500");
+        }
+    }, 10);
+    EXPECT_THROW(handle.wait(), std::runtime_error);
+    EXPECT_TRUE(handle.done());
+    // 出现异常以后剩下的块不再运行
+    EXPECT_LT(calls.load(), 100000);
+}
+
+// shared_queue时以共用队列的长度判断是否拆分：队列中还有其他任务时不拆分，整个范围由一个任务顺序地处理
+TEST(ParallelForTest, SharedQueueSplitsOnlyWhenQueueIsEmpty) {
+    thread_pool_v1::worker_group group(1, thread_pool_v1::schedule_mode::shared_queue);
+    std::atomic<bool> release(false);
+    group.submit([&release]() {
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+    });
+    std::vector<std::atomic<int>> visits(10000);
+    auto handle = thread_pool_v1::parallel_for(group, 0, static_cast<int>(visits.size()), [&visits](int i) {
+        visits[i].fetch_add(1);
+    }, 10);
+    // parallel_for的任务运行时，队列中还有这个任务
+    std::atomic<int> after(0);
+    group.submit([&after]() { after.fetch_add(1); });
+    release.store(true);
+    // 不调用wait()：等待的线程会帮忙运行队列中的任务，使队列变空
+    while (!handle.done()) {
+        std::this_thread::yield();
+    }
+    handle.wait();
+    for (size_t i = 0; i < visits.size(); ++i) {
+        ASSERT_EQ(visits[i].load(), 1) << "index " << i;
+    }
+    ASSERT_TRUE(wait_for_count(after, 1));
+    EXPECT_EQ(group.metrics().submitted, 3);
+
+    // 队列为空时仍然会拆分
+    thread_pool_v1::worker_group idle(4, thread_pool_v1::schedule_mode::shared_queue);
+    std::atomic<long long> sum(0);
+    thread_pool_v1::parallel_for(idle, 0, 10000, [&sum](int i) { sum += i; }, 10).wait();
+    EXPECT_EQ(sum.load(), 49995000);
+    EXPECT_GT(idle.metrics().submitted, 1);
+}
+
+TEST(ParallelForTest, ThreadPoolBatchAndParallelFor) {
+    for (auto mode : {thread_pool_v1::schedule_mode::shared_queue, thread_pool_v1::schedule_mode::work_stealing}) {
+        auto pool = thread_pool_v1::thread_pool::create_for_testing(2, mode);
+        std::vector<std::function<int()>> functions;
+        for (int i = 0; i < 100; ++i) {
+            functions.emplace_back([i]() { return i * 2; });
+        }
+        auto futures = pool->commit_batch(functions);
+        ASSERT_EQ(futures.size(), 100);
+        int total = 0;
+        for (auto& future : futures) {
+            total += future.get();
+        }
+        EXPECT_EQ(total, 9900);
+
+        std::vector<int> values(50000);
+        pool->parallel_for(size_t(0), values.size(), [&values](size_t i) { values[i] = static_cast<int>(i % 7); }).wait();
+        EXPECT_EQ(std::accumulate(values.begin(), values.end(), 0LL), 149997);
+    }
+}
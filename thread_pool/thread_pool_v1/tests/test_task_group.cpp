@@ -0,0 +1,165 @@
+#include "gtest/gtest.h"
+#include "../parallel_algorithms.h"
+#include "../parallel_for.h"
+#include "../task_group.h"
+#include "../worker_group.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    long long fib(thread_pool_v1::worker_group& group, int n) {
+        if (n < 2) {
+            return n;
+        }
+        long long left = 0;
+        thread_pool_v1::task_group tasks(group);
+        tasks.run([&group, &left, n]() { left = fib(group, n - 1); });
+        const long long right = fib(group, n - 2);
+        tasks.wait();
+        return left + right;
+    }
+}
+
+// 在工作线程中嵌套地等待：只有一个工作线程时也不会死锁
+TEST(TaskGroupTest, NestedWaitsDoNotDeadlock) {
+    for (size_t threads : {1, 2, 4}) {
+        thread_pool_v1::worker_group group(threads);
+        std::promise<long long> result;
+        group.submit([&group, &result]() { result.set_value(fib(group, 20)); });
+        auto future = result.get_future();
+        ASSERT_EQ(future.wait_for(std::chrono::seconds(30)), std::future_status::ready);
+        EXPECT_EQ(future.get(), 6765);
+        // 外部线程中等待时也会帮忙运行任务
+        EXPECT_EQ(fib(group, 15), 610);
+    }
+}
+
+TEST(TaskGroupTest, RethrowsFirstException) {
+    thread_pool_v1::worker_group group(2);
+    thread_pool_v1::task_group tasks(group);
+    std::atomic<int> finished(0);
+    for (int i = 0; i < 10; ++i) {
+        tasks.run([&finished, i]() {
+            if (i == 3) {
+                throw std::runtime_error("task 3");
+            }
+            finished.fetch_add(1);
+        });
+    }
+    EXPECT_THROW(tasks.wait(), std::runtime_error);
+    EXPECT_LE(finished.load(), 9);
+
+    // 异常被取走以后可以继续使用
+    tasks.run([&finished]() { finished.fetch_add(100); });
+    EXPECT_NO_THROW(tasks.wait());
+    EXPECT_GE(finished.load(), 100);
+}
+
+// parallel_for的完成句柄在工作线程中等待时同样帮忙运行任务
+TEST(TaskGroupTest, NestedParallelForInsideWorker) {
+    thread_pool_v1::worker_group group(1);
+    std::promise<long long> result;
+    group.submit([&group, &result]() {
+        std::atomic<long long> sum(0);
+        thread_pool_v1::parallel_for(group, 0, 10000, [&sum](int i) { sum += i; }, 16).wait();
+        result.set_value(sum.load());
+    });
+    auto future = result.get_future();
+    ASSERT_EQ(future.wait_for(std::chrono::seconds(30)), std::future_status::ready);
+    EXPECT_EQ(future.get(), 49995000);
+}
+
+// 等待的线程睡眠以后仍然会帮忙：唯一的工作线程提交了一批任务后忙等它们完成，
+// 这些任务只能由正在wait()中睡眠的外部线程运行，新提交的任务需要唤醒它
+TEST(TaskGroupTest, WaiterKeepsHelpingAfterSleeping) {
+    for (auto mode : {thread_pool_v1::schedule_mode::shared_queue, thread_pool_v1::schedule_mode::work_stealing}) {
+        thread_pool_v1::worker_group group(1, mode);
+        std::atomic<int> counter(0);
+        std::atomic<bool> started(false);
+        std::atomic<bool> all_ran(false);
+        thread_pool_v1::task_group tasks(group);
+        tasks.run([&group, &counter, &started, &all_ran]() {
+            started.store(true);
+            // 让外部线程先用完让出cpu的次数，进入睡眠
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            for (int i = 0; i < 100; ++i) {
+                group.submit([&counter]() { counter.fetch_add(1); });
+            }
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+            while (counter.load() < 100 && std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::yield();
+            }
+            all_ran.store(counter.load() == 100);
+        });
+        // 确保这个任务由工作线程运行，而不是被wait()中的外部线程取走
+        while (!started.load()) {
+            std::this_thread::yield();
+        }
+        tasks.wait();
+        EXPECT_TRUE(all_ran.load());
+    }
+}
+
+TEST(TaskGroupTest, ParallelReduce) {
+    thread_pool_v1::worker_group group(4);
+    std::vector<long long> values(100003);
+    std::iota(values.begin(), values.end(), 1);
+    EXPECT_EQ(thread_pool_v1::parallel_reduce(group, values.begin(), values.end(), 10LL),
+              std::accumulate(values.begin(), values.end(), 10LL));
+    EXPECT_EQ(thread_pool_v1::parallel_reduce(group, values.begin(), values.end(), 0LL,
+                                              [](long long a, long long b) { return std::max(a, b); }, 7),
+              100003);
+    EXPECT_EQ(thread_pool_v1::parallel_reduce(group, values.begin(), values.begin(), 5LL), 5);
+
+    std::vector<std::string> words = {"a", "b", "c", "d", "e", "f", "g"};
+    EXPECT_EQ(thread_pool_v1::parallel_reduce(group, words.begin(), words.end(), std::string(">"), std::plus<>(), 1),
+              ">abcdefg");
+}
+
+TEST(TaskGroupTest, ParallelTransform) {
+    thread_pool_v1::worker_group group(4);
+    std::vector<int> input(50001);
+    std::iota(input.begin(), input.end(), 0);
+    std::vector<long long> output(input.size());
+    auto end = thread_pool_v1::parallel_transform(group, input.begin(), input.end(), output.begin(),
+                                                  [](int x) { return static_cast<long long>(x) * x; }, 100);
+    EXPECT_EQ(end, output.end());
+    for (size_t i = 0; i < input.size(); ++i) {
+        ASSERT_EQ(output[i], static_cast<long long>(i) * static_cast<long long>(i));
+    }
+}
+
+TEST(TaskGroupTest, ParallelSort) {
+    thread_pool_v1::worker_group group(4);
+    std::mt19937 random(42);
+    for (int range : {10, 1000, 1 << 30}) {
+        std::vector<int> values(200000);
+        for (auto& value : values) {
+            value = static_cast<int>(random() % range);
+        }
+        auto expected = values;
+        std::sort(expected.begin(), expected.end());
+        thread_pool_v1::parallel_sort(group, values.begin(), values.end(), std::less<>(), 256);
+        EXPECT_EQ(values, expected);
+
+        thread_pool_v1::parallel_sort(group, values.begin(), values.end(), std::greater<>());
+        EXPECT_TRUE(std::is_sorted(values.begin(), values.end(), std::greater<>()));
+    }
+    // 已经有序以及所有元素都相同的输入
+    std::vector<int> sorted(100000);
+    std::iota(sorted.begin(), sorted.end(), 0);
+    thread_pool_v1::parallel_sort(group, sorted.begin(), sorted.end(), std::less<>(), 64);
+    EXPECT_TRUE(std::is_sorted(sorted.begin(), sorted.end()));
+    std::vector<int> same(100000, 7);
+    thread_pool_v1::parallel_sort(group, same.begin(), same.end(), std::less<>(), 64);
+    EXPECT_EQ(std::count(same.begin(), same.end(), 7), 100000);
+}
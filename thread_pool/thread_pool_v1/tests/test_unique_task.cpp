@@ -0,0 +1,145 @@
+#include "gtest/gtest.h"
+#include "../thread_pool.h"
+#include "../unique_task.h"
+#include "../worker_group.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <thread>
+
+namespace {
+    // 当前线程调用operator new的次数
+    thread_local long long t_allocations = 0;
+
+    bool wait_until(const std::atomic<int>& counter, int expected) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (counter.load() < expected) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        return true;
+    }
+}
+
+// 替换全局的operator new，统计每个线程分配内存的次数
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void* operator new(std::size_t size) {
+    ++t_allocations;
+    if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+#pragma GCC diagnostic pop
+
+TEST(UniqueTaskTest, SmallCallablesAreStoredInline) {
+    int value = 0;
+    auto small = [&value]() { ++value; };
+    EXPECT_TRUE(thread_pool_v1::unique_task::fits_inline<decltype(small)>);
+
+    const long long before = t_allocations;
+    thread_pool_v1::unique_task task(small);
+    thread_pool_v1::unique_task moved(std::move(task));
+    EXPECT_EQ(t_allocations, before);
+    EXPECT_FALSE(task);
+    ASSERT_TRUE(moved);
+    moved();
+    EXPECT_EQ(value, 1);
+
+    // 超过inline_size的对象分配在堆上，移动时只移动指针
+    std::array<char, 128> big{};
+    big[0] = 5;
+    thread_pool_v1::unique_task large([big, &value]() { value += big[0]; });
+    EXPECT_EQ(t_allocations, before + 1);
+    thread_pool_v1::unique_task large_moved;
+    large_moved = std::move(large);
+    EXPECT_EQ(t_allocations, before + 1);
+    large_moved();
+    EXPECT_EQ(value, 6);
+}
+
+TEST(UniqueTaskTest, HoldsMoveOnlyCallables) {
+    auto owned = std::make_unique<int>(41);
+    int result = 0;
+    thread_pool_v1::unique_task task([owned = std::move(owned), &result]() { result = *owned + 1; });
+    thread_pool_v1::unique_task other = std::move(task);
+    other();
+    EXPECT_EQ(result, 42);
+}
+
+// 外部线程提交到共享队列或注入队列：队列的容量稳定以后，提交小任务不再分配内存
+TEST(UniqueTaskTest, ExternalSubmitDoesNotAllocate) {
+    for (auto mode : {thread_pool_v1::schedule_mode::shared_queue, thread_pool_v1::schedule_mode::work_stealing}) {
+        thread_pool_v1::worker_group group(1, mode);
+        std::atomic<int> counter(0);
+        long long allocations = 0;
+        for (int round = 0; round < 2; ++round) {
+            // 先让唯一的工作线程阻塞，保证任务都堆积在队列中
+            std::atomic<bool> release(false);
+            group.submit([&release]() {
+                while (!release.load()) {
+                    std::this_thread::yield();
+                }
+            });
+            const long long before = t_allocations;
+            for (int i = 0; i < 1000; ++i) {
+                group.submit([&counter]() { counter.fetch_add(1); });
+            }
+            allocations = t_allocations - before;
+            release.store(true);
+            ASSERT_TRUE(wait_until(counter, 1000 * (round + 1)));
+        }
+        // 第一轮扩容了队列，第二轮不应该再分配
+        EXPECT_EQ(allocations, 0);
+    }
+}
+
+// 工作线程提交到自己的队列时使用回收的结点，不分配内存
+TEST(UniqueTaskTest, WorkerSubmitReusesNodes) {
+    thread_pool_v1::worker_group group(1);
+    std::atomic<int> counter(0);
+    std::atomic<long long> allocations(-1);
+    for (int round = 0; round < 2; ++round) {
+        std::atomic<int> finished(0);
+        group.submit([&]() {
+            const long long before = t_allocations;
+            for (int i = 0; i < 100; ++i) {
+                group.submit([&counter]() { counter.fetch_add(1); });
+            }
+            allocations.store(t_allocations - before);
+            finished.store(1);
+        });
+        ASSERT_TRUE(wait_until(finished, 1));
+        ASSERT_TRUE(wait_until(counter, 100 * (round + 1)));
+    }
+    EXPECT_EQ(allocations.load(), 0);
+}
+
+TEST(UniqueTaskTest, PostRunsWithoutFuture) {
+    std::atomic<int> counter(0);
+    {
+        auto pool = thread_pool_v1::thread_pool::create_for_testing(2);
+        for (int i = 0; i < 100; ++i) {
+            pool->post([&counter](int delta) { counter.fetch_add(delta); }, 2);
+        }
+        EXPECT_TRUE(wait_until(counter, 200));
+        // 停止以后不能再提交
+        pool->stop();
+        EXPECT_THROW(pool->post([&counter]() { counter.fetch_add(1); }), std::runtime_error);
+    }
+    EXPECT_EQ(counter.load(), 200);
+}
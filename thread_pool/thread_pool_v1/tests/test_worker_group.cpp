@@ -0,0 +1,139 @@
+#include "gtest/gtest.h"
+#include "../worker_group.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+    // 等待counter达到expected，最多等待几秒
+    bool wait_for_count(const std::atomic<int>& counter, int expected) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (counter.load() < expected) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    // 在工作线程中递归地提交任务，形成一棵深度为depth的二叉树
+    void spawn_tree(thread_pool_v1::worker_group& group, std::atomic<int>& counter, int depth) {
+        counter.fetch_add(1);
+        if (depth == 0) {
+            return;
+        }
+        group.submit([&group, &counter, depth]() { spawn_tree(group, counter, depth - 1); });
+        group.submit([&group, &counter, depth]() { spawn_tree(group, counter, depth - 1); });
+    }
+}
+
+TEST(WorkStealingDequeTest, OwnerPopsNewestAndThievesStealOldest) {
+    thread_pool_v1::work_stealing_deque<int*> deque(2);
+    std::vector<int> values(100);
+    for (int i = 0; i < 100; ++i) {
+        values[i] = i;
+        deque.push(&values[i]);
+    }
+    EXPECT_EQ(deque.size(), 100);
+    EXPECT_EQ(*deque.pop(), 99);
+    EXPECT_EQ(*deque.steal(), 0);
+    EXPECT_EQ(*deque.steal(), 1);
+    EXPECT_EQ(*deque.pop(), 98);
+    while (deque.pop() != nullptr) {
+    }
+    EXPECT_TRUE(deque.empty());
+    EXPECT_EQ(deque.steal(), nullptr);
+}
+
+// 拥有者不断放入与取出，同时有多个窃取者，每个元素正好被取走一次
+TEST(WorkStealingDequeTest, EveryItemTakenOnce) {
+    constexpr int count = 200000;
+    thread_pool_v1::work_stealing_deque<int*> deque(4);
+    std::vector<int> values(count, 0);
+    std::vector<std::atomic<int>> taken(count);
+    std::atomic<bool> done(false);
+    std::vector<std::thread> thieves;
+    for (int t = 0; t < 3; ++t) {
+        thieves.emplace_back([&]() {
+            while (!done.load() || !deque.empty()) {
+                if (int* item = deque.steal()) {
+                    taken[item - values.data()].fetch_add(1);
+                }
+            }
+        });
+    }
+    for (int i = 0; i < count; ++i) {
+        deque.push(&values[i]);
+        if (i % 3 == 0) {
+            if (int* item = deque.pop()) {
+                taken[item - values.data()].fetch_add(1);
+            }
+        }
+    }
+    while (int* item = deque.pop()) {
+        taken[item - values.data()].fetch_add(1);
+    }
+    done.store(true);
+    for (auto& t : thieves) {
+        t.join();
+    }
+    for (int i = 0; i < count; ++i) {
+        ASSERT_EQ(taken[i].load(), 1) << i;
+    }
+}
+
+TEST(WorkerGroupTest, RunsExternalTasksInBothModes) {
+    for (auto mode : {thread_pool_v1::schedule_mode::shared_queue, thread_pool_v1::schedule_mode::work_stealing}) {
+        thread_pool_v1::worker_group group(4, mode);
+        EXPECT_EQ(group.thread_count(), 4u);
+        EXPECT_EQ(group.mode(), mode);
+        std::atomic<int> counter(0);
+        for (int i = 0; i < 10000; ++i) {
+            group.submit([&counter]() { counter.fetch_add(1); });
+        }
+        EXPECT_TRUE(wait_for_count(counter, 10000));
+    }
+}
+
+// 工作线程中提交的任务进入自己的队列，其他线程通过窃取分担
+TEST(WorkerGroupTest, NestedSubmissionsAreStolen) {
+    thread_pool_v1::worker_group group(4);
+    std::atomic<int> counter(0);
+    constexpr int depth = 14;
+    group.submit([&]() { spawn_tree(group, counter, depth); });
+    EXPECT_TRUE(wait_for_count(counter, (1 << (depth + 1)) - 1));
+}
+
+// 线程睡眠以后，新提交的任务仍然会被执行
+TEST(WorkerGroupTest, WakesSleepingWorkers) {
+    thread_pool_v1::worker_group group(2);
+    std::atomic<int> counter(0);
+    for (int round = 0; round < 50; ++round) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        group.submit([&counter]() { counter.fetch_add(1); });
+        ASSERT_TRUE(wait_for_count(counter, round + 1));
+    }
+}
+
+// 停止以后还没有运行的任务被直接释放
+TEST(WorkerGroupTest, StopDropsPendingTasks) {
+    std::atomic<int> counter(0);
+    {
+        thread_pool_v1::worker_group group(1);
+        std::atomic<bool> release(false);
+        group.submit([&release]() {
+            while (!release.load()) {
+                std::this_thread::yield();
+            }
+        });
+        for (int i = 0; i < 100; ++i) {
+            group.submit([&counter]() { counter.fetch_add(1); });
+        }
+        group.stop();
+        EXPECT_TRUE(group.stopped());
+        release.store(true);
+    }
+    EXPECT_LT(counter.load(), 100);
+}
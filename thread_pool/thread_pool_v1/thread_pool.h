@@ -6,58 +6,213 @@
 #define THREAD_POOL_H
 #include <functional>
 #include <future>
+#include <memory>
+#include <ranges>
+#include <vector>
 
+#include "continuation.h"
+#include "coroutine.h"
+#include "elastic_worker_group.h"
 #include "enable_singleton.h"
+#include "parallel_algorithms.h"
+#include "parallel_for.h"
+#include "task_graph.h"
+#include "task_group.h"
+#include "worker_group.h"
 #include <thread>
-#include <queue>
 #include <mutex>
 
 namespace thread_pool_v1 {
     class thread_pool : public enable_singleton<thread_pool> {
     friend class enable_singleton<thread_pool>;
+    friend struct std::default_delete<thread_pool>;
     public:
-        using runtime_task = std::function<void()>;
+        using runtime_task = worker_group::runtime_task;
 
-        /// 向线程池提示一个任务
+        /// 只用于测试：创建一个独立的线程池，不受全局线程池（可能已经被其他测试停止）的影响
+        /// 业务代码应该通过get_instance()使用全局的线程池
+        static std::unique_ptr<thread_pool> create_for_testing(size_t thread_num,
+                                                               schedule_mode mode = schedule_mode::work_stealing,
+                                                               size_t max_io_threads = 256) {
+            return std::unique_ptr<thread_pool>(new thread_pool(thread_num, mode, max_io_threads));
+        }
+
+        /// 向线程池提示一个任务，与commit_cpu相同
         template <typename F, typename... Args>
         auto commit(F&& function, Args&&... args) -> std::future<decltype(function(args...))> {
+            return commit_to(m_workers, std::forward<F>(function), std::forward<Args>(args)...);
+        }
+
+        /// 提交一个cpu密集型的任务，由线程数等于核心数的工作线程运行
+        template <typename F, typename... Args>
+        auto commit_cpu(F&& function, Args&&... args) -> std::future<decltype(function(args...))> {
+            return commit_to(m_workers, std::forward<F>(function), std::forward<Args>(args)...);
+        }
+
+        /// 提交一个io密集型（会阻塞）的任务，由单独的、线程数随阻塞的任务数伸缩的线程组运行，不会占用cpu任务的线程
+        template <typename F, typename... Args>
+        auto commit_io(F&& function, Args&&... args) -> std::future<decltype(function(args...))> {
+            return commit_to(m_io_workers, std::forward<F>(function), std::forward<Args>(args)...);
+        }
+
+        /// 一次提交多个无参数的cpu密集型任务，只加一次锁，并且按任务数叫醒合适个数的线程，返回每个任务的future
+        template <std::ranges::input_range Range>
+        auto commit_batch(Range&& functions) -> std::vector<std::future<std::invoke_result_t<std::ranges::range_reference_t<Range>>>> {
             if (m_stop.load()) {
                 throw std::runtime_error("thread pool has been stoped");
             }
-            // 获得这个任务的返回类型
-            using return_type = decltype(function(args...));
-            // 构造这个任务的对象
-            auto pool_task = std::make_shared<std::packaged_task<return_type()>>(std::bind(std::forward<F>(function), std::forward<Args>(args)...));
-            // 将任务的返回值与future绑定
-            std::future<return_type> return_value = pool_task->get_future();
-            {
-                std::lock_guard<std::mutex> guard(m_queue_lock);
-                // 向队列中添加
-                m_task_queue.emplace([pool_task]() {
-                    // 通过值传递获得这个任务
-                    (*pool_task)();
+            using return_type = std::invoke_result_t<std::ranges::range_reference_t<Range>>;
+            std::vector<runtime_task> tasks;
+            std::vector<std::future<return_type>> return_values;
+            if constexpr (std::ranges::sized_range<Range>) {
+                tasks.reserve(std::ranges::size(functions));
+                return_values.reserve(std::ranges::size(functions));
+            }
+            for (auto&& function: functions) {
+                std::packaged_task<return_type()> pool_task(std::forward<decltype(function)>(function));
+                return_values.push_back(pool_task.get_future());
+                tasks.emplace_back([pool_task = std::move(pool_task)]() mutable {
+                    pool_task();
                 });
             }
-            // 通知一个线程来运行这个任务
-            m_cond.notify_one();
-            return return_value;
+            m_workers.submit_batch(tasks);
+            return return_values;
+        }
+
+        /// 对[begin, end)中的每个下标调用function(i)，由cpu线程组使用惰性二分并行地运行
+        /// 返回一个完成句柄，而不是每个下标或者每块一个future
+        template <std::integral Index, typename F>
+        completion_handle parallel_for(Index begin, Index end, F&& function, std::type_identity_t<Index> grain = 0) {
+            if (m_stop.load()) {
+                throw std::runtime_error("thread pool has been stoped");
+            }
+            return thread_pool_v1::parallel_for(m_workers, begin, end, std::forward<F>(function), grain);
+        }
+
+        /// 在cpu线程组中运行的fork-join任务组与并行算法，见task_group.h与parallel_algorithms.h
+        task_group make_task_group() {
+            return task_group(m_workers);
+        }
+
+        /// 在cpu线程组中运行一个任务，返回可以用then()添加后续任务的task_future，见continuation.h
+        template <typename F, typename... Args>
+            requires std::invocable<std::decay_t<F>&, std::decay_t<Args>&...>
+        auto spawn(F&& function, Args&&... args) {
+            if (m_stop.load()) {
+                throw std::runtime_error("thread pool has been stoped");
+            }
+            return thread_pool_v1::spawn(m_workers, bind_task(std::forward<F>(function), std::forward<Args>(args)...));
+        }
+
+        /// 在cpu线程组中开始运行一个协程，返回它的结果的task_future，见coroutine.h
+        template <typename T>
+        task_future<T> spawn(task<T> work) {
+            if (m_stop.load()) {
+                throw std::runtime_error("thread pool has been stoped");
+            }
+            return thread_pool_v1::spawn(m_workers, std::move(work));
+        }
+
+        /// 在协程中co_await pool.schedule()切换到cpu线程组的工作线程，co_await pool.schedule_io()切换到io线程组
+        schedule_awaiter<worker_group> schedule() {
+            if (m_stop.load()) {
+                throw std::runtime_error("thread pool has been stoped");
+            }
+            return thread_pool_v1::schedule(m_workers);
+        }
+
+        schedule_awaiter<elastic_worker_group> schedule_io() {
+            if (m_stop.load()) {
+                throw std::runtime_error("thread pool has been stoped");
+            }
+            return thread_pool_v1::schedule(m_io_workers);
+        }
+
+        /// 在cpu线程组中运行的依赖图，见task_graph.h
+        task_graph make_task_graph() {
+            return task_graph(m_workers);
+        }
+
+        template <std::random_access_iterator Iterator, typename T, typename BinaryOp = std::plus<>>
+        T parallel_reduce(Iterator first, Iterator last, T init, BinaryOp op = BinaryOp(), size_t grain = 0) {
+            return thread_pool_v1::parallel_reduce(m_workers, first, last, std::move(init), std::move(op), grain);
+        }
+
+        template <std::random_access_iterator InputIterator, std::random_access_iterator OutputIterator, typename UnaryOp>
+        OutputIterator parallel_transform(InputIterator first, InputIterator last, OutputIterator d_first, UnaryOp op, size_t grain = 0) {
+            return thread_pool_v1::parallel_transform(m_workers, first, last, d_first, std::move(op), grain);
+        }
+
+        template <std::random_access_iterator Iterator, typename Compare = std::less<>>
+        void parallel_sort(Iterator first, Iterator last, Compare comp = Compare(), size_t grain = 0) {
+            thread_pool_v1::parallel_sort(m_workers, first, last, std::move(comp), grain);
+        }
+
+        /// 提交一个不需要返回值的cpu密集型任务，不创建future
+        /// 函数与参数一共不超过unique_task::inline_size个字节时，提交的过程中不分配内存
+        /// 任务不能抛出异常，否则会调用std::terminate
+        template <typename F, typename... Args>
+        void post(F&& function, Args&&... args) {
+            if (m_stop.load()) {
+                throw std::runtime_error("thread pool has been stoped");
+            }
+            m_workers.submit(bind_task(std::forward<F>(function), std::forward<Args>(args)...));
         }
 
         void stop();
 
+        size_t thread_count() const {
+            return m_workers.thread_count();
+        }
+
+        /// cpu线程组与io线程组的运行状态
+        worker_metrics cpu_metrics() const {
+            return m_workers.metrics();
+        }
+
+        worker_metrics io_metrics() const {
+            return m_io_workers.metrics();
+        }
+
     private:
-        explicit thread_pool(size_t thread_num = std::thread::hardware_concurrency());
+        template <typename Group, typename F, typename... Args>
+        auto commit_to(Group& group, F&& function, Args&&... args) -> std::future<decltype(function(args...))> {
+            if (m_stop.load()) {
+                throw std::runtime_error("thread pool has been stoped");
+            }
+            // 获得这个任务的返回类型
+            using return_type = decltype(function(args...));
+            // 构造这个任务的对象，packaged_task只能移动，直接保存在unique_task中，不需要再用std::shared_ptr包一层
+            std::packaged_task<return_type()> pool_task(bind_task(std::forward<F>(function), std::forward<Args>(args)...));
+            // 将任务的返回值与future绑定
+            std::future<return_type> return_value = pool_task.get_future();
+            // 向队列中添加，并通知一个线程来运行这个任务
+            group.submit([pool_task = std::move(pool_task)]() mutable {
+                pool_task();
+            });
+            return return_value;
+        }
+
+        /// 把函数与参数保存在一个无参数的可调用对象中，调用时参数以左值的形式传入（与std::bind相同）
+        template <typename F, typename... Args>
+        static auto bind_task(F&& function, Args&&... args) {
+            return [function = std::forward<F>(function), ... args = std::forward<Args>(args)]() mutable -> decltype(auto) {
+                return std::invoke(function, args...);
+            };
+        }
+
+        /// cpu线程组默认使用工作窃取的调度方式，io线程组最多有max_io_threads个线程
+        explicit thread_pool(size_t thread_num = std::thread::hardware_concurrency(),
+                             schedule_mode mode = schedule_mode::work_stealing,
+                             size_t max_io_threads = 256);
         ~thread_pool();
         /// 中止
         std::atomic<bool> m_stop = false;
 
-        /// 任务队列
-        std::queue<runtime_task> m_task_queue;
-        std::mutex m_queue_lock;
-        /// 用于通知线程运行任务的条件变量
-        std::condition_variable m_cond;
-        /// 维护所有的线程
-        std::vector<std::jthread> m_jthreads;
+        /// cpu任务的工作线程与任务队列
+        worker_group m_workers;
+        /// io任务的工作线程与任务队列
+        elastic_worker_group m_io_workers;
     };
 
 } // thread_pool_v1
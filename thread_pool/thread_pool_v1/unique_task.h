@@ -0,0 +1,117 @@
+//
+// Created by ghost-him on 25-5-15.
+//
+
+#ifndef UNIQUE_TASK_H
+#define UNIQUE_TASK_H
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace thread_pool_v1 {
+
+    /// 只能移动的、无参数无返回值的可调用对象
+    /// 与std::function<void()>不同：
+    ///   * 可以保存只能移动的对象（比如std::packaged_task），不需要再用std::shared_ptr包一层
+    ///   * 不超过inline_size字节、并且移动时不抛出异常的对象直接保存在内部的缓冲区中，不需要分配内存；更大的对象才分配在堆上
+    class unique_task {
+    public:
+        /// 内部缓冲区的大小，加上虚表指针正好是一个缓存行
+        static constexpr std::size_t inline_size = 56;
+
+        unique_task() noexcept = default;
+
+        template <typename F>
+            requires (!std::is_same_v<std::decay_t<F>, unique_task> && std::is_invocable_v<std::decay_t<F>&>)
+        unique_task(F&& function) {
+            using stored = std::decay_t<F>;
+            if constexpr (fits_inline<stored>) {
+                ::new (static_cast<void*>(m_storage)) stored(std::forward<F>(function));
+                m_vtable = &inline_vtable<stored>;
+            } else {
+                ::new (static_cast<void*>(m_storage)) stored*(new stored(std::forward<F>(function)));
+                m_vtable = &heap_vtable<stored>;
+            }
+        }
+
+        unique_task(unique_task&& other) noexcept {
+            move_from(other);
+        }
+
+        unique_task& operator=(unique_task&& other) noexcept {
+            if (this != &other) {
+                reset();
+                move_from(other);
+            }
+            return *this;
+        }
+
+        unique_task(const unique_task&) = delete;
+        unique_task& operator=(const unique_task&) = delete;
+
+        ~unique_task() {
+            reset();
+        }
+
+        void operator()() {
+            m_vtable->invoke(m_storage);
+        }
+
+        explicit operator bool() const noexcept {
+            return m_vtable != nullptr;
+        }
+
+        /// 对象是否保存在内部的缓冲区中，不需要分配内存
+        template <typename F>
+        static constexpr bool fits_inline = sizeof(F) <= inline_size &&
+                                            alignof(F) <= alignof(std::max_align_t) &&
+                                            std::is_nothrow_move_constructible_v<F>;
+
+    private:
+        struct vtable {
+            void (*invoke)(void* storage);
+            /// 把src中的对象移动到dst中，并销毁src中的对象
+            void (*relocate)(void* dst, void* src) noexcept;
+            void (*destroy)(void* storage) noexcept;
+        };
+
+        template <typename F>
+        static constexpr vtable inline_vtable = {
+            [](void* storage) { (*static_cast<F*>(storage))(); },
+            [](void* dst, void* src) noexcept {
+                ::new (dst) F(std::move(*static_cast<F*>(src)));
+                static_cast<F*>(src)->~F();
+            },
+            [](void* storage) noexcept { static_cast<F*>(storage)->~F(); },
+        };
+
+        template <typename F>
+        static constexpr vtable heap_vtable = {
+            [](void* storage) { (**static_cast<F**>(storage))(); },
+            [](void* dst, void* src) noexcept { ::new (dst) F*(*static_cast<F**>(src)); },
+            [](void* storage) noexcept { delete *static_cast<F**>(storage); },
+        };
+
+        void move_from(unique_task& other) noexcept {
+            if (other.m_vtable != nullptr) {
+                other.m_vtable->relocate(m_storage, other.m_storage);
+                m_vtable = other.m_vtable;
+                other.m_vtable = nullptr;
+            }
+        }
+
+        void reset() noexcept {
+            if (m_vtable != nullptr) {
+                m_vtable->destroy(m_storage);
+                m_vtable = nullptr;
+            }
+        }
+
+        alignas(std::max_align_t) unsigned char m_storage[inline_size];
+        const vtable* m_vtable = nullptr;
+    };
+
+} // thread_pool_v1
+
+#endif //UNIQUE_TASK_H
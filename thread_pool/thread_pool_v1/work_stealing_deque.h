@@ -0,0 +1,134 @@
+//
+// Created by ghost-him on 25-5-15.
+//
+
+#ifndef WORK_STEALING_DEQUE_H
+#define WORK_STEALING_DEQUE_H
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace thread_pool_v1 {
+
+    /// Chase–Lev工作窃取双端队列
+    /// 只有拥有者线程可以调用push与pop，从底部（bottom）放入与取出，所以拥有者总是先处理最新放入的任务（LIFO）；
+    /// 其他线程调用steal从顶部（top）窃取最早放入的任务（FIFO），多个窃取者之间以及与拥有者之间通过CAS竞争最后一个元素
+    /// 环形数组满了以后由拥有者扩容为2倍，旧的数组保留到队列析构，因为窃取者可能还在读取它
+    /// T必须是指针类型，空队列或者竞争失败时返回nullptr
+    template <typename T>
+    class work_stealing_deque {
+        static_assert(std::is_pointer_v<T>, "work_stealing_deque只能保存指针");
+
+        struct ring {
+            std::int64_t capacity;
+            std::unique_ptr<std::atomic<T>[]> items;
+
+            explicit ring(std::int64_t capacity_) : capacity(capacity_), items(new std::atomic<T>[capacity_]) {}
+
+            T get(std::int64_t index) const {
+                return items[index & (capacity - 1)].load(std::memory_order_relaxed);
+            }
+
+            void put(std::int64_t index, T item) {
+                items[index & (capacity - 1)].store(item, std::memory_order_relaxed);
+            }
+        };
+
+    public:
+        explicit work_stealing_deque(std::int64_t capacity = 256) {
+            std::int64_t rounded = 1;
+            while (rounded < capacity) {
+                rounded *= 2;
+            }
+            m_rings.emplace_back(new ring(rounded));
+            m_ring.store(m_rings.back().get(), std::memory_order_relaxed);
+        }
+
+        work_stealing_deque(const work_stealing_deque&) = delete;
+        work_stealing_deque& operator=(const work_stealing_deque&) = delete;
+
+        /// 只能由拥有者调用
+        void push(T item) {
+            const std::int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+            const std::int64_t top = m_top.load(std::memory_order_acquire);
+            ring* current = m_ring.load(std::memory_order_relaxed);
+            if (bottom - top > current->capacity - 1) {
+                current = grow(current, top, bottom);
+            }
+            current->put(bottom, item);
+            // release保证窃取者看到新的bottom时，也能看到元素本身
+            m_bottom.store(bottom + 1, std::memory_order_release);
+        }
+
+        /// 只能由拥有者调用，取出最新放入的元素
+        T pop() {
+            const std::int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+            ring* current = m_ring.load(std::memory_order_relaxed);
+            // 先占住底部的元素，再读top，与steal中先读top再读bottom配对，两者都使用seq_cst
+            m_bottom.store(bottom, std::memory_order_seq_cst);
+            std::int64_t top = m_top.load(std::memory_order_seq_cst);
+            if (top > bottom) {
+                // 队列是空的
+                m_bottom.store(bottom + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            T item = current->get(bottom);
+            if (top == bottom) {
+                // 只剩最后一个元素，与窃取者竞争
+                if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    item = nullptr;
+                }
+                m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            }
+            return item;
+        }
+
+        /// 可以由任意线程调用，取出最早放入的元素
+        T steal() {
+            std::int64_t top = m_top.load(std::memory_order_seq_cst);
+            const std::int64_t bottom = m_bottom.load(std::memory_order_seq_cst);
+            if (top >= bottom) {
+                return nullptr;
+            }
+            ring* current = m_ring.load(std::memory_order_acquire);
+            T item = current->get(top);
+            if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return nullptr;
+            }
+            return item;
+        }
+
+        /// 只是一个近似值
+        bool empty() const {
+            return m_bottom.load(std::memory_order_relaxed) <= m_top.load(std::memory_order_relaxed);
+        }
+
+        std::int64_t size() const {
+            const std::int64_t size = m_bottom.load(std::memory_order_relaxed) - m_top.load(std::memory_order_relaxed);
+            return size > 0 ? size : 0;
+        }
+
+    private:
+        ring* grow(ring* current, std::int64_t top, std::int64_t bottom) {
+            auto* bigger = new ring(current->capacity * 2);
+            for (std::int64_t i = top; i < bottom; ++i) {
+                bigger->put(i, current->get(i));
+            }
+            m_rings.emplace_back(bigger);
+            m_ring.store(bigger, std::memory_order_release);
+            return bigger;
+        }
+
+        // top与bottom分别由窃取者与拥有者频繁修改，放在不同的缓存行中
+        alignas(64) std::atomic<std::int64_t> m_top{0};
+        alignas(64) std::atomic<std::int64_t> m_bottom{0};
+        alignas(64) std::atomic<ring*> m_ring{nullptr};
+        /// 所有分配过的数组，只由拥有者修改
+        std::vector<std::unique_ptr<ring>> m_rings;
+    };
+
+} // thread_pool_v1
+
+#endif //WORK_STEALING_DEQUE_H
@@ -0,0 +1,441 @@
+//
+// Created by ghost-him on 25-5-15.
+//
+
+#include "worker_group.h"
+
+#include <algorithm>
+
+namespace thread_pool_v1 {
+    namespace {
+        /// 当前线程所属的组以及在组中的下标，不是工作线程时group为空
+        struct worker_identity {
+            const worker_group* group = nullptr;
+            size_t index = 0;
+        };
+        thread_local worker_identity t_identity;
+        /// 外部线程窃取时选择对象的随机数状态
+        thread_local std::uint64_t t_external_seed = 0x2545F4914F6CDD1Dull;
+
+        std::uint64_t next_random(std::uint64_t& state) {
+            // xorshift64
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            return state;
+        }
+    }
+
+    worker_group::worker_group(size_t thread_num, schedule_mode mode) : m_mode(mode) {
+        if (thread_num <= 0) {
+            thread_num = 1;
+        }
+        m_stats = std::make_unique<thread_stats[]>(thread_num);
+        if (m_mode == schedule_mode::work_stealing) {
+            for (size_t i = 0; i < thread_num; i++) {
+                m_workers.emplace_back(std::make_unique<worker>());
+                m_workers.back()->seed = 0x9E3779B97F4A7C15ull * (i + 1);
+            }
+        }
+        // 启动指定个数的线程
+        for (size_t i = 0; i < thread_num; i++) {
+            m_jthreads.emplace_back([this, i](std::stop_token stop_token) {
+                t_identity = {this, i};
+                if (m_mode == schedule_mode::work_stealing) {
+                    work_stealing_loop(i, stop_token);
+                } else {
+                    shared_queue_loop(i, stop_token);
+                }
+            });
+        }
+    }
+
+    worker_group::~worker_group() {
+        stop();
+        for (auto& jthread: m_jthreads) {
+            jthread.join();
+        }
+        // 释放没有运行的任务以及所有的结点，注入队列中的任务随着队列一起释放
+        auto delete_list = [](task_node* node) {
+            while (node != nullptr) {
+                task_node* next = node->next;
+                delete node;
+                node = next;
+            }
+        };
+        for (auto& w: m_workers) {
+            while (task_node* node = w->deque.pop()) {
+                delete node;
+            }
+            delete_list(w->free_nodes);
+            delete_list(w->remote_free.load());
+        }
+    }
+
+    void worker_group::submit(runtime_task task) {
+        const long long index = current_index();
+        if (index >= 0) {
+            // 只有这个线程修改自己的计数，不需要原子的加法
+            auto& submitted = m_stats[index].submitted;
+            submitted.store(submitted.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+        if (m_mode == schedule_mode::shared_queue) {
+            {
+                std::lock_guard<std::mutex> guard(m_queue_lock);
+                m_task_queue.push(std::move(task));
+                m_queue_size.store(m_task_queue.size(), std::memory_order_relaxed);
+                if (index < 0) {
+                    m_external_submitted.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            m_cond.notify_one();
+            notify_helpers();
+            return;
+        }
+        if (index >= 0) {
+            // 工作线程中提交的任务放入自己的队列，不需要加锁
+            m_workers[index]->deque.push(acquire_node(index, std::move(task)));
+        } else {
+            std::lock_guard<std::mutex> guard(m_injection_lock);
+            m_injection_queue.push(std::move(task));
+            m_injection_size.fetch_add(1);
+            m_external_submitted.fetch_add(1, std::memory_order_relaxed);
+        }
+        wake_one();
+        notify_helpers();
+    }
+
+    void worker_group::submit_batch(std::span<runtime_task> tasks) {
+        if (tasks.empty()) {
+            return;
+        }
+        const long long index = current_index();
+        if (index >= 0) {
+            auto& submitted = m_stats[index].submitted;
+            submitted.store(submitted.load(std::memory_order_relaxed) + tasks.size(), std::memory_order_relaxed);
+        }
+        if (m_mode == schedule_mode::shared_queue) {
+            {
+                std::lock_guard<std::mutex> guard(m_queue_lock);
+                for (auto& task: tasks) {
+                    m_task_queue.push(std::move(task));
+                }
+                m_queue_size.store(m_task_queue.size(), std::memory_order_relaxed);
+                if (index < 0) {
+                    m_external_submitted.fetch_add(tasks.size(), std::memory_order_relaxed);
+                }
+            }
+            if (tasks.size() >= m_jthreads.size()) {
+                m_cond.notify_all();
+            } else {
+                for (size_t i = 0; i < tasks.size(); i++) {
+                    m_cond.notify_one();
+                }
+            }
+            notify_helpers();
+            return;
+        }
+        if (index >= 0) {
+            for (auto& task: tasks) {
+                m_workers[index]->deque.push(acquire_node(index, std::move(task)));
+            }
+        } else {
+            std::lock_guard<std::mutex> guard(m_injection_lock);
+            for (auto& task: tasks) {
+                m_injection_queue.push(std::move(task));
+            }
+            m_injection_size.fetch_add(tasks.size());
+            m_external_submitted.fetch_add(tasks.size(), std::memory_order_relaxed);
+        }
+        wake(tasks.size());
+        notify_helpers();
+    }
+
+    size_t worker_group::local_queue_size() const {
+        const long long index = current_index();
+        if (index < 0) {
+            return 0;
+        }
+        if (m_mode == schedule_mode::shared_queue) {
+            return m_queue_size.load(std::memory_order_relaxed);
+        }
+        return static_cast<size_t>(m_workers[index]->deque.size());
+    }
+
+    worker_metrics worker_group::metrics() const {
+        worker_metrics result;
+        result.threads = m_jthreads.size();
+        result.peak_threads = m_jthreads.size();
+        result.submitted = m_external_submitted.load(std::memory_order_relaxed);
+        result.completed = m_external_completed.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < m_jthreads.size(); i++) {
+            result.submitted += m_stats[i].submitted.load(std::memory_order_relaxed);
+            result.completed += m_stats[i].completed.load(std::memory_order_relaxed);
+            result.active += m_stats[i].busy.load(std::memory_order_relaxed) ? 1 : 0;
+        }
+        // 各项不是同时读取的，差值可能暂时为负
+        const std::uint64_t started = result.completed + result.active;
+        result.queued = result.submitted > started ? static_cast<size_t>(result.submitted - started) : 0;
+        return result;
+    }
+
+    bool worker_group::try_run_one() {
+        const long long index = current_index();
+        if (m_mode == schedule_mode::shared_queue) {
+            runtime_task task;
+            {
+                std::lock_guard<std::mutex> guard(m_queue_lock);
+                if (m_task_queue.empty()) {
+                    return false;
+                }
+                task = m_task_queue.pop();
+                m_queue_size.store(m_task_queue.size(), std::memory_order_relaxed);
+            }
+            run_task(index, task);
+            return true;
+        }
+        task_node* node = nullptr;
+        if (index >= 0) {
+            node = find_task(index);
+        } else {
+            // 外部线程没有自己的队列与结点，直接运行注入队列中的任务
+            if (m_injection_size.load(std::memory_order_relaxed) != 0) {
+                runtime_task task;
+                {
+                    std::lock_guard<std::mutex> guard(m_injection_lock);
+                    if (!m_injection_queue.empty()) {
+                        task = m_injection_queue.pop();
+                        m_injection_size.fetch_sub(1);
+                    }
+                }
+                if (task) {
+                    run_task(index, task);
+                    return true;
+                }
+            }
+            node = steal_from_others(index);
+        }
+        if (node == nullptr) {
+            return false;
+        }
+        run_task(index, node->task);
+        release_node(node);
+        return true;
+    }
+
+    void worker_group::run_task(long long index, runtime_task& task) {
+        if (index < 0) {
+            task();
+            task = runtime_task();
+            m_external_completed.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        thread_stats& stats = m_stats[index];
+        stats.busy.store(true, std::memory_order_relaxed);
+        task();
+        // 先销毁任务捕获的对象，再更新计数
+        task = runtime_task();
+        stats.busy.store(false, std::memory_order_relaxed);
+        stats.completed.store(stats.completed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void worker_group::stop() {
+        m_stop = true;
+        for (auto& jthread: m_jthreads) {
+            jthread.request_stop();
+        }
+        m_cond.notify_all();
+        {
+            std::lock_guard<std::mutex> guard(m_sleep_lock);
+            ++m_wake_epoch;
+        }
+        m_sleep_cond.notify_all();
+        {
+            std::lock_guard<std::mutex> guard(m_helper_lock);
+            ++m_helper_epoch;
+        }
+        m_helper_cond.notify_all();
+    }
+
+    void worker_group::notify_helpers() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_parked_helpers.load() == 0) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> guard(m_helper_lock);
+            ++m_helper_epoch;
+        }
+        m_helper_cond.notify_all();
+    }
+
+    long long worker_group::current_index() const {
+        return t_identity.group == this ? static_cast<long long>(t_identity.index) : -1;
+    }
+
+    void worker_group::shared_queue_loop(size_t index, const std::stop_token& stop_token) {
+        // 只要还不需要暂停时，就一直处理这些工作
+        while (!stop_token.stop_requested()) {
+            runtime_task task;
+            {
+                std::unique_lock<std::mutex> guard(m_queue_lock);
+                m_cond.wait(guard, [this, &stop_token]() {
+                    return stop_token.stop_requested() || !m_task_queue.empty();
+                });
+                if (stop_token.stop_requested()) {
+                    return ;
+                }
+                task = m_task_queue.pop();
+                m_queue_size.store(m_task_queue.size(), std::memory_order_relaxed);
+            }
+
+            run_task(index, task);
+        }
+    }
+
+    void worker_group::work_stealing_loop(size_t index, const std::stop_token& stop_token) {
+        while (!stop_token.stop_requested()) {
+            if (task_node* node = find_task(index)) {
+                run_task(index, node->task);
+                release_node(node);
+                continue;
+            }
+            wait_for_work(stop_token);
+        }
+    }
+
+    worker_group::task_node* worker_group::acquire_node(size_t index, runtime_task&& task) {
+        worker& self = *m_workers[index];
+        if (self.free_nodes == nullptr) {
+            // 只有这个线程会取走remote_free中的结点，所以一次全部取走不会有ABA问题
+            self.free_nodes = self.remote_free.exchange(nullptr, std::memory_order_acquire);
+        }
+        task_node* node = self.free_nodes;
+        if (node != nullptr) {
+            self.free_nodes = node->next;
+        } else {
+            node = new task_node;
+            node->owner = index;
+        }
+        node->next = nullptr;
+        node->task = std::move(task);
+        return node;
+    }
+
+    void worker_group::release_node(task_node* node) {
+        worker& owner = *m_workers[node->owner];
+        if (current_index() == static_cast<long long>(node->owner)) {
+            node->next = owner.free_nodes;
+            owner.free_nodes = node;
+            return;
+        }
+        node->next = owner.remote_free.load(std::memory_order_relaxed);
+        while (!owner.remote_free.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+    }
+
+    worker_group::task_node* worker_group::find_task(size_t index) {
+        if (task_node* node = m_workers[index]->deque.pop()) {
+            return node;
+        }
+        if (task_node* node = take_from_injection(index)) {
+            return node;
+        }
+        return steal_from_others(index);
+    }
+
+    worker_group::task_node* worker_group::take_from_injection(size_t index) {
+        if (m_injection_size.load(std::memory_order_relaxed) == 0) {
+            return nullptr;
+        }
+        task_node* first = nullptr;
+        size_t batch = 0;
+        {
+            std::lock_guard<std::mutex> guard(m_injection_lock);
+            if (m_injection_queue.empty()) {
+                return nullptr;
+            }
+            // 一次取走平均分给自己的一份（最多32个），多出来的放入自己的队列，其他线程可以来窃取
+            batch = std::min<size_t>({m_injection_queue.size() / m_workers.size() + 1, m_injection_queue.size(), 32});
+            first = acquire_node(index, m_injection_queue.pop());
+            for (size_t i = 1; i < batch; i++) {
+                m_workers[index]->deque.push(acquire_node(index, m_injection_queue.pop()));
+            }
+            m_injection_size.fetch_sub(batch);
+        }
+        if (batch > 1) {
+            // 自己的队列中还有任务，叫醒另一个线程来窃取
+            wake_one();
+        }
+        return first;
+    }
+
+    worker_group::task_node* worker_group::steal_from_others(long long index) {
+        const size_t count = m_workers.size();
+        if (index >= 0 && count <= 1) {
+            return nullptr;
+        }
+        // 从一个随机的位置开始，依次尝试其他所有的线程
+        const size_t start = next_random(index >= 0 ? m_workers[index]->seed : t_external_seed) % count;
+        for (size_t i = 0; i < count; i++) {
+            const size_t victim = (start + i) % count;
+            if (static_cast<long long>(victim) == index) {
+                continue;
+            }
+            if (task_node* node = m_workers[victim]->deque.steal()) {
+                return node;
+            }
+        }
+        return nullptr;
+    }
+
+    bool worker_group::has_visible_work() const {
+        if (m_queue_size.load() != 0 || m_injection_size.load() != 0) {
+            return true;
+        }
+        for (const auto& w: m_workers) {
+            if (!w->deque.empty()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void worker_group::wait_for_work(const std::stop_token& stop_token) {
+        std::unique_lock<std::mutex> guard(m_sleep_lock);
+        const std::uint64_t epoch = m_wake_epoch;
+        // 先登记为睡眠，再检查一次所有的队列，提交者先放入任务再检查m_sleepers，
+        // 两边都使用seq_cst，所以至少有一边能看到另一边，不会错过唤醒
+        m_sleepers.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!has_visible_work()) {
+            m_sleep_cond.wait(guard, [this, epoch, &stop_token]() {
+                return stop_token.stop_requested() || m_wake_epoch != epoch;
+            });
+        }
+        m_sleepers.fetch_sub(1);
+    }
+
+    void worker_group::wake_one() {
+        wake(1);
+    }
+
+    void worker_group::wake(size_t count) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const size_t sleepers = m_sleepers.load();
+        if (sleepers == 0) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> guard(m_sleep_lock);
+            ++m_wake_epoch;
+        }
+        if (count >= sleepers) {
+            m_sleep_cond.notify_all();
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                m_sleep_cond.notify_one();
+            }
+        }
+    }
+} // thread_pool_v1
@@ -0,0 +1,208 @@
+//
+// Created by ghost-him on 25-5-15.
+//
+
+#ifndef WORKER_GROUP_H
+#define WORKER_GROUP_H
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "task_ring.h"
+#include "unique_task.h"
+#include "work_stealing_deque.h"
+
+namespace thread_pool_v1 {
+
+    /// 任务的调度方式
+    enum class schedule_mode {
+        /// 所有的任务放在一个由互斥锁保护的队列中，所有的工作线程从同一个队列中取任务
+        shared_queue,
+        /// 每个工作线程有自己的Chase–Lev双端队列：
+        /// 工作线程中提交的任务放入自己的队列的底部，并且先处理最新的任务（LIFO）；
+        /// 外部线程提交的任务放入全局的注入队列；自己的队列为空时，先从注入队列中取一批，再随机地从其他线程的队列顶部窃取
+        work_stealing
+    };
+
+    /// 线程组的运行状态，各项分别读取，并发修改时只是一个近似值
+    struct worker_metrics {
+        /// 当前的线程数
+        size_t threads = 0;
+        /// 正在运行任务的线程数
+        size_t active = 0;
+        /// 已经提交但是还没有开始运行的任务数
+        size_t queued = 0;
+        /// 创建以来提交与运行完的任务总数
+        std::uint64_t submitted = 0;
+        std::uint64_t completed = 0;
+        /// 线程数曾经达到的最大值
+        size_t peak_threads = 0;
+    };
+
+    /// 一组工作线程，以及它们共享的任务队列
+    /// 与thread_pool不同，可以创建任意多个，线程数与调度方式都可以指定
+    class worker_group {
+    public:
+        using runtime_task = unique_task;
+
+        explicit worker_group(size_t thread_num = std::thread::hardware_concurrency(),
+                              schedule_mode mode = schedule_mode::work_stealing);
+        ~worker_group();
+
+        worker_group(const worker_group&) = delete;
+        worker_group& operator=(const worker_group&) = delete;
+
+        /// 提交一个任务
+        void submit(runtime_task task);
+
+        /// 一次提交多个任务（task中的任务被移走），只加一次锁，并且按任务数叫醒合适个数的线程
+        void submit_batch(std::span<runtime_task> tasks);
+
+        /// 从队列中取出一个任务，在当前线程中运行，没有可以运行的任务时返回false
+        /// 用来在等待其他任务时帮忙运行任务，而不是阻塞当前线程：工作线程先取自己的队列，外部线程先取注入队列，然后再窃取
+        bool try_run_one();
+
+        /// 等待其他任务的线程（help_until）暂时取不到任务时调用：睡眠到有新任务提交、notify_helpers()被调用，
+        /// 或者最多timeout。返回以后调用者重新检查done()并再次尝试try_run_one，所以不会因为睡眠而不再帮忙
+        template <typename Done>
+        void park_helper(Done&& done, std::chrono::microseconds timeout) {
+            std::unique_lock<std::mutex> guard(m_helper_lock);
+            const std::uint64_t epoch = m_helper_epoch;
+            // 与wait_for_work相同：先登记，再检查条件，提交者与完成者先修改状态再检查m_parked_helpers
+            m_parked_helpers.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!done() && !has_visible_work()) {
+                m_helper_cond.wait_for(guard, timeout, [this, epoch]() {
+                    return m_helper_epoch != epoch || m_stop.load();
+                });
+            }
+            m_parked_helpers.fetch_sub(1);
+        }
+
+        /// 唤醒所有在park_helper中睡眠的线程，等待的条件可能已经成立或者有新任务时调用
+        void notify_helpers();
+
+        /// 当前线程是这个组的工作线程时，返回它能看到的还在排队的任务数，外部线程返回0：
+        /// 工作窃取时是它自己的队列中的任务数，shared_queue时所有线程共用一个队列，是这个队列的长度（近似）
+        /// 可以用来判断是否还需要拆分任务：队列不为空时，说明其他线程还有可以取走的任务
+        size_t local_queue_size() const;
+
+        /// 通知所有的工作线程退出，还没有开始运行的任务不会再运行，线程在析构时回收
+        void stop();
+
+        bool stopped() const {
+            return m_stop.load();
+        }
+
+        size_t thread_count() const {
+            return m_jthreads.size();
+        }
+
+        schedule_mode mode() const {
+            return m_mode;
+        }
+
+        worker_metrics metrics() const;
+
+    private:
+        /// 工作窃取队列中保存的结点，运行完以后放回所属线程的空闲链表中重复使用
+        struct task_node {
+            runtime_task task;
+            task_node* next = nullptr;
+            /// 分配这个结点的工作线程
+            size_t owner = 0;
+        };
+
+        /// 每个工作线程的计数，只由这个线程修改，独占缓存行
+        struct alignas(64) thread_stats {
+            std::atomic<std::uint64_t> submitted = 0;
+            std::atomic<std::uint64_t> completed = 0;
+            std::atomic<bool> busy = false;
+        };
+
+        /// 每个工作线程的状态，独占缓存行
+        struct alignas(64) worker {
+            work_stealing_deque<task_node*> deque;
+            /// 选择窃取对象的随机数状态
+            std::uint64_t seed = 0;
+            /// 空闲的结点，只由这个线程访问
+            task_node* free_nodes = nullptr;
+            /// 其他线程运行完以后归还的结点（无锁栈），这个线程的空闲链表为空时一次全部取走
+            alignas(64) std::atomic<task_node*> remote_free = nullptr;
+        };
+
+        /// 运行一个任务并更新第index个线程的计数，index为-1时表示外部线程
+        void run_task(long long index, runtime_task& task);
+
+        void shared_queue_loop(size_t index, const std::stop_token& stop_token);
+        void work_stealing_loop(size_t index, const std::stop_token& stop_token);
+
+        /// 依次尝试自己的队列、注入队列与其他线程的队列
+        task_node* find_task(size_t index);
+        task_node* take_from_injection(size_t index);
+        /// index为-1时表示外部线程
+        task_node* steal_from_others(long long index);
+        /// 从第index个线程的空闲链表中取一个结点保存task，没有空闲的结点时才分配
+        task_node* acquire_node(size_t index, runtime_task&& task);
+        /// 运行完以后把结点还给分配它的线程
+        void release_node(task_node* node);
+        /// 是否有任何一个队列不为空（近似）
+        bool has_visible_work() const;
+        /// 没有任务时睡眠，直到有新任务或者需要退出
+        void wait_for_work(const std::stop_token& stop_token);
+        /// 有线程在睡眠时唤醒其中一个
+        void wake_one();
+        /// 最多唤醒count个睡眠的线程
+        void wake(size_t count);
+
+        /// 当前线程是这个组的工作线程时，返回它的下标，否则返回-1
+        long long current_index() const;
+
+        const schedule_mode m_mode;
+        std::atomic<bool> m_stop = false;
+
+        /// 每个线程的计数，以及外部线程提交的任务数（在队列的锁中修改）
+        std::unique_ptr<thread_stats[]> m_stats;
+        std::atomic<std::uint64_t> m_external_submitted = 0;
+        /// 外部线程通过try_run_one运行完的任务数
+        std::atomic<std::uint64_t> m_external_completed = 0;
+
+        /// shared_queue：唯一的任务队列
+        task_ring m_task_queue;
+        std::mutex m_queue_lock;
+        /// 队列中任务的个数，在锁中修改，不加锁时用来估计队列的长度
+        std::atomic<size_t> m_queue_size = 0;
+        std::condition_variable m_cond;
+
+        /// work_stealing：每个线程的队列，以及外部线程使用的注入队列
+        std::vector<std::unique_ptr<worker>> m_workers;
+        task_ring m_injection_queue;
+        std::mutex m_injection_lock;
+        /// 注入队列中任务的个数，不加锁时用来判断是否为空
+        std::atomic<size_t> m_injection_size = 0;
+
+        /// 睡眠的线程个数，以及每次唤醒时增加的计数
+        std::atomic<size_t> m_sleepers = 0;
+        std::uint64_t m_wake_epoch = 0;
+        std::mutex m_sleep_lock;
+        std::condition_variable m_sleep_cond;
+
+        /// 在park_helper中睡眠的线程个数，以及每次唤醒它们时增加的计数
+        std::atomic<size_t> m_parked_helpers = 0;
+        std::uint64_t m_helper_epoch = 0;
+        std::mutex m_helper_lock;
+        std::condition_variable m_helper_cond;
+
+        /// 放在最后，析构时最先回收线程
+        std::vector<std::jthread> m_jthreads;
+    };
+
+} // thread_pool_v1
+
+#endif //WORKER_GROUP_H